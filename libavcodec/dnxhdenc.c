@@ -112,8 +112,8 @@ void dnxhd_10bit_get_pixels_8x4_sym(int16_t *av_restrict block,
     memcpy(block + 4 * 8, pixels + 3 * line_size, 8 * sizeof(*block));
 }
 
-static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
-                                        int n, int qscale, int *overflow)
+static int dnxhd_10bit_quantize_444(MpegEncContext *ctx, int16_t *block,
+                                    int n, int qscale, int *overflow)
 {
     int i, j, level, last_non_zero, start_i;
     const int *qmat;
@@ -122,8 +122,6 @@ static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
     int max = 0;
     unsigned int threshold1, threshold2;
 
-    ctx->fdsp.fdct(block);
-
     block[0] = (block[0] + 2) >> 2;
     start_i = 1;
     last_non_zero = 0;
@@ -171,16 +169,21 @@ static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
     return last_non_zero;
 }
 
-static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
-                                    int n, int qscale, int *overflow)
+static int dnxhd_10bit_dct_quantize_444(MpegEncContext *ctx, int16_t *block,
+                                        int n, int qscale, int *overflow)
+{
+    ctx->fdsp.fdct(block);
+    return dnxhd_10bit_quantize_444(ctx, block, n, qscale, overflow);
+}
+
+static int dnxhd_10bit_quantize(MpegEncContext *ctx, int16_t *block,
+                                int n, int qscale, int *overflow)
 {
     const uint8_t *scantable= ctx->intra_scantable.scantable;
     const int *qmat = n<4 ? ctx->q_intra_matrix[qscale] : ctx->q_chroma_intra_matrix[qscale];
     int last_non_zero = 0;
     int i;
 
-    ctx->fdsp.fdct(block);
-
     // Divide by 4 with rounding, to compensate scaling of DCT coefficients
     block[0] = (block[0] + 2) >> 2;
 
@@ -202,6 +205,13 @@ static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
     return last_non_zero;
 }
 
+static int dnxhd_10bit_dct_quantize(MpegEncContext *ctx, int16_t *block,
+                                    int n, int qscale, int *overflow)
+{
+    ctx->fdsp.fdct(block);
+    return dnxhd_10bit_quantize(ctx, block, n, qscale, overflow);
+}
+
 static av_cold int dnxhd_init_vlc(DNXHDEncContext *ctx)
 {
     int i, j, level, run;
@@ -451,10 +461,12 @@ static av_cold int dnxhd_encode_init(AVCodecContext *avctx)
 
     if (ctx->is_444 || ctx->profile == FF_PROFILE_DNXHR_HQX) {
         ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize_444;
+        ctx->quantize           = dnxhd_10bit_quantize_444;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else if (ctx->bit_depth == 10) {
         ctx->m.dct_quantize     = dnxhd_10bit_dct_quantize;
+        ctx->quantize           = dnxhd_10bit_quantize;
         ctx->get_pixels_8x4_sym = dnxhd_10bit_get_pixels_8x4_sym;
         ctx->block_width_l2     = 4;
     } else {
@@ -846,12 +858,25 @@ int dnxhd_switch_matrix(DNXHDEncContext *ctx, int i)
     return x;
 }
 
+/**
+ * Fill the rate control table for one macroblock row and every qscale in
+ * [ctx->qscale, ctx->qscale_end).
+ *
+ * Each macroblock is fetched (and, if a transform-free quantizer is
+ * available, transformed) only once for all qscales. The quantized DC does
+ * not depend on qscale, and once every AC coefficient of a macroblock has
+ * been quantized to zero the result cannot change for larger qscales, so the
+ * remaining entries are copied instead of being recomputed.
+ */
 static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
                                   int jobnr, int threadnr)
 {
     DNXHDEncContext *ctx = avctx->priv_data;
     int mb_y = jobnr, mb_x;
-    int qscale = ctx->qscale;
+    int qscale_start = ctx->qscale;
+    int qscale_end   = ctx->qscale_end;
+    int nb_blocks    = 8 + 4 * ctx->is_444;
+    int calc_ssd     = avctx->mb_decision == FF_MB_DECISION_RD || !RC_VARIANCE;
     LOCAL_ALIGNED_16(int16_t, block, [64]);
     ctx = ctx->thread[threadnr];
 
@@ -861,44 +886,70 @@ static int dnxhd_calc_bits_thread(AVCodecContext *avctx, void *arg,
 
     for (mb_x = 0; mb_x < ctx->m.mb_width; mb_x++) {
         unsigned mb = mb_y * ctx->m.mb_width + mb_x;
-        int ssd     = 0;
-        int ac_bits = 0;
         int dc_bits = 0;
-        int i;
+        int qscale, i;
 
         dnxhd_get_blocks(ctx, mb_x, mb_y);
 
-        for (i = 0; i < 8 + 4 * ctx->is_444; i++) {
-            int16_t *src_block = ctx->blocks[i];
-            int overflow, nbits, diff, last_index;
-            int n = dnxhd_switch_matrix(ctx, i);
-
-            memcpy(block, src_block, 64 * sizeof(*block));
-            last_index = ctx->m.dct_quantize(&ctx->m, block,
-                                             ctx->is_444 ? 4 * (n > 0): 4 & (2*i),
-                                             qscale, &overflow);
-            ac_bits   += dnxhd_calc_ac_bits(ctx, block, last_index);
-
-            diff = block[0] - ctx->m.last_dc[n];
-            if (diff < 0)
-                nbits = av_log2_16bit(-2 * diff);
-            else
-                nbits = av_log2_16bit(2 * diff);
+        if (ctx->quantize) {
+            for (i = 0; i < nb_blocks; i++) {
+                memcpy(ctx->dct_blocks[i], ctx->blocks[i], 64 * sizeof(*block));
+                ctx->m.fdsp.fdct(ctx->dct_blocks[i]);
+            }
+        }
 
-            av_assert1(nbits < ctx->bit_depth + 4);
-            dc_bits += ctx->cid_table->dc_bits[nbits] + nbits;
+        for (qscale = qscale_start; qscale < qscale_end; qscale++) {
+            RCEntry *rc = &ctx->mb_rc[(qscale * ctx->m.mb_num) + mb];
+            int ssd     = 0;
+            int ac_bits = 0;
+            int ac_left = 0;
+
+            for (i = 0; i < nb_blocks; i++) {
+                int16_t *src_block = ctx->blocks[i];
+                int overflow, last_index;
+                int n  = dnxhd_switch_matrix(ctx, i);
+                int qn = ctx->is_444 ? 4 * (n > 0) : 4 & (2 * i);
+
+                if (ctx->quantize) {
+                    memcpy(block, ctx->dct_blocks[i], 64 * sizeof(*block));
+                    last_index = ctx->quantize(&ctx->m, block, qn, qscale,
+                                               &overflow);
+                } else {
+                    memcpy(block, src_block, 64 * sizeof(*block));
+                    last_index = ctx->m.dct_quantize(&ctx->m, block, qn, qscale,
+                                                     &overflow);
+                }
+                ac_bits += dnxhd_calc_ac_bits(ctx, block, last_index);
+                ac_left |= last_index;
+
+                if (qscale == qscale_start) {
+                    int nbits, diff = block[0] - ctx->m.last_dc[n];
+                    if (diff < 0)
+                        nbits = av_log2_16bit(-2 * diff);
+                    else
+                        nbits = av_log2_16bit(2 * diff);
 
-            ctx->m.last_dc[n] = block[0];
+                    av_assert1(nbits < ctx->bit_depth + 4);
+                    dc_bits += ctx->cid_table->dc_bits[nbits] + nbits;
 
-            if (avctx->mb_decision == FF_MB_DECISION_RD || !RC_VARIANCE) {
-                dnxhd_unquantize_c(ctx, block, i, qscale, last_index);
-                ctx->m.idsp.idct(block);
-                ssd += dnxhd_ssd_block(block, src_block);
+                    ctx->m.last_dc[n] = block[0];
+                }
+
+                if (calc_ssd) {
+                    dnxhd_unquantize_c(ctx, block, i, qscale, last_index);
+                    ctx->m.idsp.idct(block);
+                    ssd += dnxhd_ssd_block(block, src_block);
+                }
+            }
+            rc->ssd  = ssd;
+            rc->bits = ac_bits + dc_bits + 12 +
+                       (1 + ctx->is_444) * 8 * ctx->vlc_bits[0];
+
+            if (!ac_left) {
+                while (++qscale < qscale_end)
+                    ctx->mb_rc[(qscale * ctx->m.mb_num) + mb] = *rc;
             }
         }
-        ctx->mb_rc[(qscale * ctx->m.mb_num) + mb].ssd  = ssd;
-        ctx->mb_rc[(qscale * ctx->m.mb_num) + mb].bits = ac_bits + dc_bits + 12 +
-                                     (1 + ctx->is_444) * 8 * ctx->vlc_bits[0];
     }
     return 0;
 }
@@ -1035,11 +1086,14 @@ static int dnxhd_encode_rdo(AVCodecContext *avctx, DNXHDEncContext *ctx)
     int last_lower = INT_MAX, last_higher = 0;
     int x, y, q;
 
-    for (q = 1; q < avctx->qmax; q++) {
-        ctx->qscale = q;
-        avctx->execute2(avctx, dnxhd_calc_bits_thread,
-                        NULL, NULL, ctx->m.mb_height);
-    }
+    ctx->qscale     = 1;
+    ctx->qscale_end = avctx->qmax;
+    avctx->execute2(avctx, dnxhd_calc_bits_thread,
+                    NULL, NULL, ctx->m.mb_height);
+    /* the reported frame quality is the last qscale that was evaluated,
+     * as when the qscales were evaluated one pass at a time */
+    ctx->qscale = avctx->qmax - 1;
+
     up_step = down_step = 2 << LAMBDA_FRAC_BITS;
     lambda  = ctx->lambda;
 
@@ -1119,7 +1173,8 @@ static int dnxhd_find_qscale(DNXHDEncContext *ctx)
     qscale = ctx->qscale;
     for (;;) {
         bits = 0;
-        ctx->qscale = qscale;
+        ctx->qscale     = qscale;
+        ctx->qscale_end = qscale + 1;
         // XXX avoid recalculating bits
         ctx->m.avctx->execute2(ctx->m.avctx, dnxhd_calc_bits_thread,
                                NULL, NULL, ctx->m.mb_height);
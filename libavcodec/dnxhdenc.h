@@ -75,6 +75,7 @@ typedef struct DNXHDEncContext {
     int intra_quant_bias;
 
     DECLARE_ALIGNED(32, int16_t, blocks)[12][64];
+    DECLARE_ALIGNED(32, int16_t, dct_blocks)[12][64];
     DECLARE_ALIGNED(16, uint8_t, edge_buf_y)[512]; // has to hold 16x16 uint16 when depth=10
     DECLARE_ALIGNED(16, uint8_t, edge_buf_uv)[2][512]; // has to hold 16x16 uint16_t when depth=10
 
@@ -96,6 +97,7 @@ typedef struct DNXHDEncContext {
     /** Rate control */
     unsigned slice_bits;
     unsigned qscale;
+    unsigned qscale_end; ///< dnxhd_calc_bits_thread() evaluates [qscale, qscale_end)
     unsigned lambda;
 
     uint16_t *mb_bits;
@@ -107,6 +109,12 @@ typedef struct DNXHDEncContext {
 
     void (*get_pixels_8x4_sym)(int16_t *av_restrict /* align 16 */ block,
                                const uint8_t *pixels, ptrdiff_t line_size);
+    /**
+     * Quantize an already transformed block, NULL if only the combined
+     * MpegEncContext.dct_quantize is available.
+     */
+    int (*quantize)(MpegEncContext *s, int16_t *block, int n,
+                    int qscale, int *overflow);
 } DNXHDEncContext;
 
 void ff_dnxhdenc_init_x86(DNXHDEncContext *ctx);
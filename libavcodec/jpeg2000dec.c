@@ -87,6 +87,15 @@ typedef struct Jpeg2000Tile {
     int coord[2][2];                    // border coordinates {{x0, x1}, {y0, y1}}
 } Jpeg2000Tile;
 
+/* A code-block of a tile, decoded independently of all the others */
+typedef struct Jpeg2000CblkJob {
+    Jpeg2000Component   *comp;
+    Jpeg2000CodingStyle *codsty;
+    Jpeg2000Band        *band;
+    Jpeg2000Cblk        *cblk;
+    int                  bandpos;
+} Jpeg2000CblkJob;
+
 typedef struct Jpeg2000DecoderContext {
     AVClass         *class;
     AVCodecContext  *avctx;
@@ -121,6 +130,9 @@ typedef struct Jpeg2000DecoderContext {
     Jpeg2000Tile    *tile;
     Jpeg2000DSPContext dsp;
 
+    Jpeg2000CblkJob *cblk_jobs; // code-blocks of the tile being decoded
+    Jpeg2000Tile    *cur_tile;
+
     /*options parameters*/
     int             reduction_factor;
 } Jpeg2000DecoderContext;
@@ -1684,6 +1696,120 @@ static inline void mct_decode(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
     s->dsp.mct_decode[tile->codsty[0].transform](src[0], src[1], src[2], csize);
 }
 
+static void decode_cblk_dequantize(Jpeg2000DecoderContext *s, Jpeg2000T1Context *t1,
+                                   Jpeg2000Component *comp, Jpeg2000CodingStyle *codsty,
+                                   Jpeg2000Band *band, Jpeg2000Cblk *cblk, int bandpos)
+{
+    int x, y;
+
+    decode_cblk(s, codsty, t1, cblk,
+                cblk->coord[0][1] - cblk->coord[0][0],
+                cblk->coord[1][1] - cblk->coord[1][0],
+                bandpos);
+
+    x = cblk->coord[0][0] - band->coord[0][0];
+    y = cblk->coord[1][0] - band->coord[1][0];
+
+    if (codsty->transform == FF_DWT97)
+        dequantization_float(x, y, cblk, comp, t1, band);
+    else if (codsty->transform == FF_DWT97_INT)
+        dequantization_int_97(x, y, cblk, comp, t1, band);
+    else
+        dequantization_int(x, y, cblk, comp, t1, band);
+}
+
+/* Fill jobs, if not NULL, with the code-blocks of the tile and return their number. */
+static int tile_codeblocks_iterate(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                                   Jpeg2000CblkJob *jobs)
+{
+    int compno, reslevelno, bandno, nb_jobs = 0;
+
+    for (compno = 0; compno < s->ncomponents; compno++) {
+        Jpeg2000Component *comp     = tile->comp + compno;
+        Jpeg2000CodingStyle *codsty = tile->codsty + compno;
+
+        for (reslevelno = 0; reslevelno < codsty->nreslevels2decode; reslevelno++) {
+            Jpeg2000ResLevel *rlevel = comp->reslevel + reslevelno;
+            for (bandno = 0; bandno < rlevel->nbands; bandno++) {
+                int nb_precincts, precno;
+                Jpeg2000Band *band = rlevel->band + bandno;
+                int cblkno, bandpos = bandno + (reslevelno > 0);
+
+                if (band->coord[0][0] == band->coord[0][1] ||
+                    band->coord[1][0] == band->coord[1][1])
+                    continue;
+
+                nb_precincts = rlevel->num_precincts_x * rlevel->num_precincts_y;
+                for (precno = 0; precno < nb_precincts; precno++) {
+                    Jpeg2000Prec *prec = band->prec + precno;
+
+                    for (cblkno = 0;
+                         cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
+                         cblkno++) {
+                        if (jobs) {
+                            Jpeg2000CblkJob *job = jobs + nb_jobs;
+                            job->comp    = comp;
+                            job->codsty  = codsty;
+                            job->band    = band;
+                            job->cblk    = prec->cblk + cblkno;
+                            job->bandpos = bandpos;
+                        }
+                        nb_jobs++;
+                    }
+                }
+            }
+        }
+    }
+
+    return nb_jobs;
+}
+
+static int jpeg2000_decode_cblk_job(AVCodecContext *avctx, void *td,
+                                    int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    Jpeg2000CblkJob *job = s->cblk_jobs + jobnr;
+    Jpeg2000T1Context t1;
+
+    t1.stride = (1 << job->codsty->log2_cblk_width) + 2;
+    decode_cblk_dequantize(s, &t1, job->comp, job->codsty,
+                           job->band, job->cblk, job->bandpos);
+
+    return 0;
+}
+
+static int jpeg2000_dwt_job(AVCodecContext *avctx, void *td,
+                            int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s   = avctx->priv_data;
+    Jpeg2000Component *comp     = s->cur_tile->comp   + jobnr;
+    Jpeg2000CodingStyle *codsty = s->cur_tile->codsty + jobnr;
+
+    ff_dwt_decode(&comp->dwt, codsty->transform == FF_DWT97 ? (void*)comp->f_data : (void*)comp->i_data);
+
+    return 0;
+}
+
+/* Decode the code-blocks of a tile in parallel, then run the inverse
+ * DWT of its components in parallel. */
+static int tile_codeblocks_threaded(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
+{
+    int nb_jobs = tile_codeblocks_iterate(s, tile, NULL);
+
+    s->cblk_jobs = av_malloc_array(nb_jobs, sizeof(*s->cblk_jobs));
+    if (!s->cblk_jobs)
+        return AVERROR(ENOMEM);
+    tile_codeblocks_iterate(s, tile, s->cblk_jobs);
+
+    s->cur_tile = tile;
+    s->avctx->execute2(s->avctx, jpeg2000_decode_cblk_job, NULL, NULL, nb_jobs);
+    s->avctx->execute2(s->avctx, jpeg2000_dwt_job, NULL, NULL, s->ncomponents);
+
+    av_freep(&s->cblk_jobs);
+
+    return 0;
+}
+
 static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile)
 {
     Jpeg2000T1Context t1;
@@ -1720,24 +1846,9 @@ static inline void tile_codeblocks(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile
                     /* Loop on codeblocks */
                     for (cblkno = 0;
                          cblkno < prec->nb_codeblocks_width * prec->nb_codeblocks_height;
-                         cblkno++) {
-                        int x, y;
-                        Jpeg2000Cblk *cblk = prec->cblk + cblkno;
-                        decode_cblk(s, codsty, &t1, cblk,
-                                    cblk->coord[0][1] - cblk->coord[0][0],
-                                    cblk->coord[1][1] - cblk->coord[1][0],
-                                    bandpos);
-
-                        x = cblk->coord[0][0] - band->coord[0][0];
-                        y = cblk->coord[1][0] - band->coord[1][0];
-
-                        if (codsty->transform == FF_DWT97)
-                            dequantization_float(x, y, cblk, comp, &t1, band);
-                        else if (codsty->transform == FF_DWT97_INT)
-                            dequantization_int_97(x, y, cblk, comp, &t1, band);
-                        else
-                            dequantization_int(x, y, cblk, comp, &t1, band);
-                   } /* end cblk */
+                         cblkno++)
+                        decode_cblk_dequantize(s, &t1, comp, codsty, band,
+                                               prec->cblk + cblkno, bandpos);
                 } /*end prec */
             } /* end band */
         } /* end reslevel */
@@ -1809,16 +1920,11 @@ WRITE_FRAME(16, uint16_t)
 
 #undef WRITE_FRAME
 
-static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
-                                int jobnr, int threadnr)
+static void write_tile(Jpeg2000DecoderContext *s, Jpeg2000Tile *tile,
+                       AVFrame *picture)
 {
-    Jpeg2000DecoderContext *s = avctx->priv_data;
-    AVFrame *picture = td;
-    Jpeg2000Tile *tile = s->tile + jobnr;
     int x;
 
-    tile_codeblocks(s, tile);
-
     /* inverse MCT transformation */
     if (tile->codsty[0].mct)
         mct_decode(s, tile);
@@ -1844,6 +1950,17 @@ static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
 
         write_frame_16(s, tile, picture, precision);
     }
+}
+
+static int jpeg2000_decode_tile(AVCodecContext *avctx, void *td,
+                                int jobnr, int threadnr)
+{
+    Jpeg2000DecoderContext *s = avctx->priv_data;
+    AVFrame *picture = td;
+    Jpeg2000Tile *tile = s->tile + jobnr;
+
+    tile_codeblocks(s, tile);
+    write_tile(s, tile, picture);
 
     return 0;
 }
@@ -2222,7 +2339,17 @@ static int jpeg2000_decode_frame(AVCodecContext *avctx, void *data,
     if (ret = jpeg2000_read_bitstream_packets(s))
         goto end;
 
-    avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
+    if (avctx->active_thread_type == FF_THREAD_SLICE &&
+        s->numXtiles * s->numYtiles < avctx->thread_count) {
+        /* Too few tiles to keep all threads busy, split the tiles instead */
+        int tileno;
+        for (tileno = 0; tileno < s->numXtiles * s->numYtiles; tileno++) {
+            if ((ret = tile_codeblocks_threaded(s, s->tile + tileno)) < 0)
+                goto end;
+            write_tile(s, s->tile + tileno, picture);
+        }
+    } else
+        avctx->execute2(avctx, jpeg2000_decode_tile, picture, NULL, s->numXtiles * s->numYtiles);
 
     jpeg2000_dec_cleanup(s);
 
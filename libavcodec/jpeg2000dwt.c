@@ -48,6 +48,11 @@
 #define I_LFTG_X       53274ll
 #define I_PRESHIFT 8
 
+/* Number of adjacent columns filtered together by the vertical passes of
+ * the inverse transforms, so that the line buffer is filled from
+ * consecutive samples instead of a single strided column. */
+#define DWT_COLS 8
+
 static inline void extend53(int *p, int i0, int i1)
 {
     p[i0 - 1] = p[i0 + 1];
@@ -305,22 +310,34 @@ static void dwt_encode97_int(DWTContext *s, int *t)
         t[i] = (t[i] + ((1<<I_PRESHIFT)>>1)) >> I_PRESHIFT;
 }
 
-static void sr_1d53(unsigned *p, int i0, int i1)
+static av_always_inline void sr_1d53(unsigned *p, int i0, int i1, int cols)
 {
-    int i;
+    int i, c;
 
     if (i1 <= i0 + 1) {
         if (i0 == 1)
-            p[1] = (int)p[1] >> 1;
+            for (c = 0; c < cols; c++)
+                p[cols + c] = (int)p[cols + c] >> 1;
         return;
     }
 
-    extend53(p, i0, i1);
+    for (c = 0; c < cols; c++) {
+        p[(i0 - 1) * cols + c] = p[(i0 + 1) * cols + c];
+        p[ i1      * cols + c] = p[(i1 - 2) * cols + c];
+        p[(i0 - 2) * cols + c] = p[(i0 + 2) * cols + c];
+        p[(i1 + 1) * cols + c] = p[(i1 - 3) * cols + c];
+    }
 
-    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
-        p[2 * i] -= (int)(p[2 * i - 1] + p[2 * i + 1] + 2) >> 2;
-    for (i = (i0 >> 1); i < (i1 >> 1); i++)
-        p[2 * i + 1] += (int)(p[2 * i] + p[2 * i + 2]) >> 1;
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        unsigned *q = p + 2 * i * cols;
+        for (c = 0; c < cols; c++)
+            q[c] -= (int)(q[c - cols] + q[c + cols] + 2) >> 2;
+    }
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        unsigned *q = p + (2 * i + 1) * cols;
+        for (c = 0; c < cols; c++)
+            q[c] += (int)(q[c - cols] + q[c + cols]) >> 1;
+    }
 }
 
 static void dwt_decode53(DWTContext *s, int *t)
@@ -328,7 +345,7 @@ static void dwt_decode53(DWTContext *s, int *t)
     int lev;
     int w     = s->linelen[s->ndeclevels - 1][0];
     int32_t *line = s->i_linebuf;
-    line += 3;
+    line += 3 * DWT_COLS;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
         int lh = s->linelen[lev][0],
@@ -348,15 +365,29 @@ static void dwt_decode53(DWTContext *s, int *t)
             for (i = 1 - mh; i < lh; i += 2, j++)
                 l[i] = t[w * lp + j];
 
-            sr_1d53(line, mh, mh + lh);
+            sr_1d53(line, mh, mh + lh, 1);
 
             for (i = 0; i < lh; i++)
                 t[w * lp + i] = l[i];
         }
 
-        // VER_SD
+        // VER_SD, DWT_COLS adjacent columns at a time
+        l = line + mv * DWT_COLS;
+        for (lp = 0; lp + DWT_COLS <= lh; lp += DWT_COLS) {
+            int i, j = 0;
+            // copy with interleaving
+            for (i = mv; i < lv; i += 2, j++)
+                memcpy(l + i * DWT_COLS, t + w * j + lp, DWT_COLS * sizeof(*t));
+            for (i = 1 - mv; i < lv; i += 2, j++)
+                memcpy(l + i * DWT_COLS, t + w * j + lp, DWT_COLS * sizeof(*t));
+
+            sr_1d53(line, mv, mv + lv, DWT_COLS);
+
+            for (i = 0; i < lv; i++)
+                memcpy(t + w * i + lp, l + i * DWT_COLS, DWT_COLS * sizeof(*t));
+        }
         l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        for (; lp < lh; lp++) {
             int i, j = 0;
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
@@ -364,7 +395,7 @@ static void dwt_decode53(DWTContext *s, int *t)
             for (i = 1 - mv; i < lv; i += 2, j++)
                 l[i] = t[w * j + lp];
 
-            sr_1d53(line, mv, mv + lv);
+            sr_1d53(line, mv, mv + lv, 1);
 
             for (i = 0; i < lv; i++)
                 t[w * i + lp] = l[i];
@@ -372,31 +403,49 @@ static void dwt_decode53(DWTContext *s, int *t)
     }
 }
 
-static void sr_1d97_float(float *p, int i0, int i1)
+static av_always_inline void sr_1d97_float(float *p, int i0, int i1, int cols)
 {
-    int i;
+    int i, c;
 
     if (i1 <= i0 + 1) {
         if (i0 == 1)
-            p[1] *= F_LFTG_K/2;
+            for (c = 0; c < cols; c++)
+                p[cols + c] *= F_LFTG_K/2;
         else
-            p[0] *= F_LFTG_X;
+            for (c = 0; c < cols; c++)
+                p[c] *= F_LFTG_X;
         return;
     }
 
-    extend97_float(p, i0, i1);
+    for (c = 0; c < cols; c++)
+        for (i = 1; i <= 4; i++) {
+            p[(i0 - i)     * cols + c] = p[(i0 + i)     * cols + c];
+            p[(i1 + i - 1) * cols + c] = p[(i1 - i - 1) * cols + c];
+        }
 
-    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++)
-        p[2 * i]     -= F_LFTG_DELTA * (p[2 * i - 1] + p[2 * i + 1]);
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        float *q = p + 2 * i * cols;
+        for (c = 0; c < cols; c++)
+            q[c] -= F_LFTG_DELTA * (q[c - cols] + q[c + cols]);
+    }
     /* step 4 */
-    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++)
-        p[2 * i + 1] -= F_LFTG_GAMMA * (p[2 * i]     + p[2 * i + 2]);
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        float *q = p + (2 * i + 1) * cols;
+        for (c = 0; c < cols; c++)
+            q[c] -= F_LFTG_GAMMA * (q[c - cols] + q[c + cols]);
+    }
     /*step 5*/
-    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
-        p[2 * i]     += F_LFTG_BETA  * (p[2 * i - 1] + p[2 * i + 1]);
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        float *q = p + 2 * i * cols;
+        for (c = 0; c < cols; c++)
+            q[c] += F_LFTG_BETA  * (q[c - cols] + q[c + cols]);
+    }
     /* step 6 */
-    for (i = (i0 >> 1); i < (i1 >> 1); i++)
-        p[2 * i + 1] += F_LFTG_ALPHA * (p[2 * i]     + p[2 * i + 2]);
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        float *q = p + (2 * i + 1) * cols;
+        for (c = 0; c < cols; c++)
+            q[c] += F_LFTG_ALPHA * (q[c - cols] + q[c + cols]);
+    }
 }
 
 static void dwt_decode97_float(DWTContext *s, float *t)
@@ -406,7 +455,7 @@ static void dwt_decode97_float(DWTContext *s, float *t)
     float *line = s->f_linebuf;
     float *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    line += 5 * DWT_COLS;
 
     for (lev = 0; lev < s->ndeclevels; lev++) {
         int lh = s->linelen[lev][0],
@@ -425,15 +474,29 @@ static void dwt_decode97_float(DWTContext *s, float *t)
             for (i = 1 - mh; i < lh; i += 2, j++)
                 l[i] = data[w * lp + j];
 
-            sr_1d97_float(line, mh, mh + lh);
+            sr_1d97_float(line, mh, mh + lh, 1);
 
             for (i = 0; i < lh; i++)
                 data[w * lp + i] = l[i];
         }
 
-        // VER_SD
+        // VER_SD, DWT_COLS adjacent columns at a time
+        l = line + mv * DWT_COLS;
+        for (lp = 0; lp + DWT_COLS <= lh; lp += DWT_COLS) {
+            int i, j = 0;
+            // copy with interleaving
+            for (i = mv; i < lv; i += 2, j++)
+                memcpy(l + i * DWT_COLS, data + w * j + lp, DWT_COLS * sizeof(*data));
+            for (i = 1 - mv; i < lv; i += 2, j++)
+                memcpy(l + i * DWT_COLS, data + w * j + lp, DWT_COLS * sizeof(*data));
+
+            sr_1d97_float(line, mv, mv + lv, DWT_COLS);
+
+            for (i = 0; i < lv; i++)
+                memcpy(data + w * i + lp, l + i * DWT_COLS, DWT_COLS * sizeof(*data));
+        }
         l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        for (; lp < lh; lp++) {
             int i, j = 0;
             // copy with interleaving
             for (i = mv; i < lv; i += 2, j++)
@@ -441,7 +504,7 @@ static void dwt_decode97_float(DWTContext *s, float *t)
             for (i = 1 - mv; i < lv; i += 2, j++)
                 l[i] = data[w * j + lp];
 
-            sr_1d97_float(line, mv, mv + lv);
+            sr_1d97_float(line, mv, mv + lv, 1);
 
             for (i = 0; i < lv; i++)
                 data[w * i + lp] = l[i];
@@ -449,31 +512,49 @@ static void dwt_decode97_float(DWTContext *s, float *t)
     }
 }
 
-static void sr_1d97_int(int32_t *p, int i0, int i1)
+static av_always_inline void sr_1d97_int(int32_t *p, int i0, int i1, int cols)
 {
-    int i;
+    int i, c;
 
     if (i1 <= i0 + 1) {
         if (i0 == 1)
-            p[1] = (p[1] * I_LFTG_K + (1<<16)) >> 17;
+            for (c = 0; c < cols; c++)
+                p[cols + c] = (p[cols + c] * I_LFTG_K + (1<<16)) >> 17;
         else
-            p[0] = (p[0] * I_LFTG_X + (1<<15)) >> 16;
+            for (c = 0; c < cols; c++)
+                p[c] = (p[c] * I_LFTG_X + (1<<15)) >> 16;
         return;
     }
 
-    extend97_int(p, i0, i1);
+    for (c = 0; c < cols; c++)
+        for (i = 1; i <= 4; i++) {
+            p[(i0 - i)     * cols + c] = p[(i0 + i)     * cols + c];
+            p[(i1 + i - 1) * cols + c] = p[(i1 - i - 1) * cols + c];
+        }
 
-    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++)
-        p[2 * i]     -= (I_LFTG_DELTA * (p[2 * i - 1] + (int64_t)p[2 * i + 1]) + (1 << 15)) >> 16;
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 2; i++) {
+        int32_t *q = p + 2 * i * cols;
+        for (c = 0; c < cols; c++)
+            q[c] -= (I_LFTG_DELTA * (q[c - cols] + (int64_t)q[c + cols]) + (1 << 15)) >> 16;
+    }
     /* step 4 */
-    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++)
-        p[2 * i + 1] -= (I_LFTG_GAMMA * (p[2 * i]     + (int64_t)p[2 * i + 2]) + (1 << 15)) >> 16;
+    for (i = (i0 >> 1) - 1; i < (i1 >> 1) + 1; i++) {
+        int32_t *q = p + (2 * i + 1) * cols;
+        for (c = 0; c < cols; c++)
+            q[c] -= (I_LFTG_GAMMA * (q[c - cols] + (int64_t)q[c + cols]) + (1 << 15)) >> 16;
+    }
     /*step 5*/
-    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++)
-        p[2 * i]     += (I_LFTG_BETA  * (p[2 * i - 1] + (int64_t)p[2 * i + 1]) + (1 << 15)) >> 16;
+    for (i = (i0 >> 1); i < (i1 >> 1) + 1; i++) {
+        int32_t *q = p + 2 * i * cols;
+        for (c = 0; c < cols; c++)
+            q[c] += (I_LFTG_BETA  * (q[c - cols] + (int64_t)q[c + cols]) + (1 << 15)) >> 16;
+    }
     /* step 6 */
-    for (i = (i0 >> 1); i < (i1 >> 1); i++)
-        p[2 * i + 1] += (I_LFTG_ALPHA * (p[2 * i]     + (int64_t)p[2 * i + 2]) + (1 << 15)) >> 16;
+    for (i = (i0 >> 1); i < (i1 >> 1); i++) {
+        int32_t *q = p + (2 * i + 1) * cols;
+        for (c = 0; c < cols; c++)
+            q[c] += (I_LFTG_ALPHA * (q[c - cols] + (int64_t)q[c + cols]) + (1 << 15)) >> 16;
+    }
 }
 
 static void dwt_decode97_int(DWTContext *s, int32_t *t)
@@ -485,7 +566,7 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
     int32_t *line = s->i_linebuf;
     int32_t *data = t;
     /* position at index O of line range [0-5,w+5] cf. extend function */
-    line += 5;
+    line += 5 * DWT_COLS;
 
     for (i = 0; i < w * h; i++)
         data[i] *= 1LL << I_PRESHIFT;
@@ -507,15 +588,30 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
             for (i = 1 - mh; i < lh; i += 2, j++)
                 l[i] = data[w * lp + j];
 
-            sr_1d97_int(line, mh, mh + lh);
+            sr_1d97_int(line, mh, mh + lh, 1);
 
             for (i = 0; i < lh; i++)
                 data[w * lp + i] = l[i];
         }
 
-        // VER_SD
+        // VER_SD, DWT_COLS adjacent columns at a time
+        l = line + mv * DWT_COLS;
+        for (lp = 0; lp + DWT_COLS <= lh; lp += DWT_COLS) {
+            int i, j = 0, c;
+            // rescale with interleaving
+            for (i = mv; i < lv; i += 2, j++)
+                for (c = 0; c < DWT_COLS; c++)
+                    l[i * DWT_COLS + c] = ((data[w * j + lp + c] * I_LFTG_K) + (1 << 15)) >> 16;
+            for (i = 1 - mv; i < lv; i += 2, j++)
+                memcpy(l + i * DWT_COLS, data + w * j + lp, DWT_COLS * sizeof(*data));
+
+            sr_1d97_int(line, mv, mv + lv, DWT_COLS);
+
+            for (i = 0; i < lv; i++)
+                memcpy(data + w * i + lp, l + i * DWT_COLS, DWT_COLS * sizeof(*data));
+        }
         l = line + mv;
-        for (lp = 0; lp < lh; lp++) {
+        for (; lp < lh; lp++) {
             int i, j = 0;
             // rescale with interleaving
             for (i = mv; i < lv; i += 2, j++)
@@ -523,7 +619,7 @@ static void dwt_decode97_int(DWTContext *s, int32_t *t)
             for (i = 1 - mv; i < lv; i += 2, j++)
                 l[i] = data[w * j + lp];
 
-            sr_1d97_int(line, mv, mv + lv);
+            sr_1d97_int(line, mv, mv + lv, 1);
 
             for (i = 0; i < lv; i++)
                 data[w * i + lp] = l[i];
@@ -558,17 +654,17 @@ int ff_jpeg2000_dwt_init(DWTContext *s, int border[2][2],
         }
     switch (type) {
     case FF_DWT97:
-        s->f_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->f_linebuf));
+        s->f_linebuf = av_malloc_array((maxlen + 12) * DWT_COLS, sizeof(*s->f_linebuf));
         if (!s->f_linebuf)
             return AVERROR(ENOMEM);
         break;
      case FF_DWT97_INT:
-        s->i_linebuf = av_malloc_array((maxlen + 12), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen + 12) * DWT_COLS, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
     case FF_DWT53:
-        s->i_linebuf = av_malloc_array((maxlen +  6), sizeof(*s->i_linebuf));
+        s->i_linebuf = av_malloc_array((maxlen +  6) * DWT_COLS, sizeof(*s->i_linebuf));
         if (!s->i_linebuf)
             return AVERROR(ENOMEM);
         break;
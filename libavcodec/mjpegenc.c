@@ -141,6 +141,7 @@ static inline void ff_mjpeg_encode_code(MJpegContext *s, uint8_t table_id, int c
     MJpegHuffmanCode *c = &s->huff_buffer[s->huff_ncode++];
     c->table_id = table_id;
     c->code = code;
+    ff_mjpeg_encode_huffman_increment(&s->huff_ctx[table_id], code);
 }
 
 /**
@@ -268,9 +269,9 @@ static void encode_block(MpegEncContext *s, int16_t *block, int n)
             nbits= av_log2_16bit(val) + 1;
             code = (run << 4) | nbits;
 
-            put_bits(&s->pb, huff_size_ac[code], huff_code_ac[code]);
-
-            put_sbits(&s->pb, nbits, mant);
+            /* code and mantissa fit together in at most 16 + 10 bits */
+            put_bits(&s->pb, huff_size_ac[code] + nbits,
+                     (huff_code_ac[code] << nbits) | av_mod_uintp2(mant, nbits));
             run = 0;
         }
     }
@@ -36,6 +36,7 @@
 #include <stdint.h>
 
 #include "mjpeg.h"
+#include "mjpegenc_huffman.h"
 #include "mpegvideo.h"
 #include "put_bits.h"
 
@@ -87,6 +88,8 @@ typedef struct MJpegContext {
 
     size_t huff_ncode;               ///< Number of current entries in the buffer.
     MJpegHuffmanCode *huff_buffer;   ///< Buffer for Huffman code values.
+    /** Occurrences of the codes in the buffer, per table id */
+    MJpegEncHuffmanContext huff_ctx[4];
 } MJpegContext;
 
 /**
@@ -381,12 +381,10 @@ void ff_mjpeg_encode_picture_frame(MpegEncContext *s)
 
     s->header_bits = get_bits_diff(s);
     // Estimate the total size first
-    for (i = 0; i < m->huff_ncode; i++) {
-        table_id = m->huff_buffer[i].table_id;
-        code = m->huff_buffer[i].code;
-        nbits = code & 0xf;
-
-        total_bits += huff_size[table_id][code] + nbits;
+    for (table_id = 0; table_id < 4; table_id++) {
+        int *val_count = m->huff_ctx[table_id].val_count;
+        for (code = 0; code < (table_id < 2 ? 12 : 256); code++)
+            total_bits += val_count[code] * (size_t)(huff_size[table_id][code] + (code & 0xf));
     }
 
     bytes_needed = (total_bits + 7) / 8;
@@ -397,13 +395,15 @@ void ff_mjpeg_encode_picture_frame(MpegEncContext *s)
         code = m->huff_buffer[i].code;
         nbits = code & 0xf;
 
-        put_bits(&s->pb, huff_size[table_id][code], huff_code[table_id][code]);
-        if (nbits != 0) {
-            put_sbits(&s->pb, nbits, m->huff_buffer[i].mant);
-        }
+        /* code and mantissa fit together in at most 16 + 11 bits */
+        put_bits(&s->pb, huff_size[table_id][code] + nbits,
+                 (huff_code[table_id][code] << nbits) |
+                 av_mod_uintp2(m->huff_buffer[i].mant, nbits));
     }
 
     m->huff_ncode = 0;
+    for (i = 0; i < 4; i++)
+        ff_mjpeg_encode_huffman_init(&m->huff_ctx[i]);
     s->i_tex_bits = get_bits_diff(s);
 }
 
@@ -469,43 +469,24 @@ void ff_mjpeg_escape_FF(PutBitContext *pb, int start)
 /**
  * Builds all 4 optimal Huffman tables.
  *
- * Uses the data stored in the JPEG buffer to compute the tables.
+ * Uses the code occurrences counted while filling the JPEG buffer to compute
+ * the tables.
  * Stores the Huffman tables in the bits_* and val_* arrays in the MJpegContext.
  *
  * @param m MJpegContext containing the JPEG buffer.
  */
 static void ff_mjpeg_build_optimal_huffman(MJpegContext *m)
 {
-    int i, table_id, code;
-
-    MJpegEncHuffmanContext dc_luminance_ctx;
-    MJpegEncHuffmanContext dc_chrominance_ctx;
-    MJpegEncHuffmanContext ac_luminance_ctx;
-    MJpegEncHuffmanContext ac_chrominance_ctx;
-    MJpegEncHuffmanContext *ctx[4] = {&dc_luminance_ctx,
-                                      &dc_chrominance_ctx,
-                                      &ac_luminance_ctx,
-                                      &ac_chrominance_ctx};
-    for (i = 0; i < 4; i++) {
-        ff_mjpeg_encode_huffman_init(ctx[i]);
-    }
-    for (i = 0; i < m->huff_ncode; i++) {
-        table_id = m->huff_buffer[i].table_id;
-        code = m->huff_buffer[i].code;
-
-        ff_mjpeg_encode_huffman_increment(ctx[table_id], code);
-    }
-
-    ff_mjpeg_encode_huffman_close(&dc_luminance_ctx,
+    ff_mjpeg_encode_huffman_close(&m->huff_ctx[0],
                                   m->bits_dc_luminance,
                                   m->val_dc_luminance, 12);
-    ff_mjpeg_encode_huffman_close(&dc_chrominance_ctx,
+    ff_mjpeg_encode_huffman_close(&m->huff_ctx[1],
                                   m->bits_dc_chrominance,
                                   m->val_dc_chrominance, 12);
-    ff_mjpeg_encode_huffman_close(&ac_luminance_ctx,
+    ff_mjpeg_encode_huffman_close(&m->huff_ctx[2],
                                   m->bits_ac_luminance,
                                   m->val_ac_luminance, 256);
-    ff_mjpeg_encode_huffman_close(&ac_chrominance_ctx,
+    ff_mjpeg_encode_huffman_close(&m->huff_ctx[3],
                                   m->bits_ac_chrominance,
                                   m->val_ac_chrominance, 256);
 
@@ -220,6 +220,8 @@ struct TrellisNode {
 
 typedef struct ProresThreadData {
     DECLARE_ALIGNED(16, int16_t, blocks)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
+    DECLARE_ALIGNED(16, int16_t, coeffs)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
+    DECLARE_ALIGNED(16, uint16_t, levels)[64 * 4 * MAX_MBS_PER_SLICE];
     DECLARE_ALIGNED(16, uint16_t, emu_buf)[16 * 16];
     int16_t custom_q[64];
     struct TrellisNode *nodes;
@@ -228,6 +230,8 @@ typedef struct ProresThreadData {
 typedef struct ProresContext {
     AVClass *class;
     DECLARE_ALIGNED(16, int16_t, blocks)[MAX_PLANES][64 * 4 * MAX_MBS_PER_SLICE];
+    DECLARE_ALIGNED(16, int16_t, coeffs)[64 * 4 * MAX_MBS_PER_SLICE];
+    DECLARE_ALIGNED(16, uint16_t, levels)[64 * 4 * MAX_MBS_PER_SLICE];
     DECLARE_ALIGNED(16, uint16_t, emu_buf)[16*16];
     int16_t quants[MAX_STORED_Q][64];
     int16_t quants_chroma[MAX_STORED_Q][64];
@@ -366,13 +370,64 @@ static void get_alpha_data(ProresContext *ctx, const uint16_t *src,
     }
 }
 
+/**
+ * Reorder the DCT coefficients of a slice plane so that the coefficients
+ * sharing a scan position are stored next to each other, i.e. in the
+ * order they are coded in the bitstream.
+ */
+static void scan_slice_plane(int16_t *dst, const int16_t *blocks,
+                             int blocks_per_slice, const uint8_t *scan)
+{
+    int i, j;
+
+    for (i = 0; i < 64; i++, dst += blocks_per_slice) {
+        const int16_t *src = blocks + scan[i];
+        for (j = 0; j < blocks_per_slice; j++)
+            dst[j] = src[j * 64];
+    }
+}
+
+/**
+ * Quantise the AC coefficients of a scanned slice plane into absolute levels.
+ *
+ * The division is done by multiplying with a 32-bit reciprocal, which is
+ * exact for 16-bit dividends and divisors in [2, 65535] (quantiser matrix
+ * entries are at least 2), so the inner loop has no division and no branch.
+ *
+ * @return sum of the quantisation remainders
+ */
+static int quantize_slice_plane(uint16_t *levels, const int16_t *coeffs,
+                                int blocks_per_slice, const int16_t *qmat,
+                                const uint8_t *scan)
+{
+    int i, j;
+    unsigned error = 0;
+
+    for (i = 1; i < 64; i++) {
+        const unsigned q     = qmat[scan[i]];
+        const uint32_t recip = UINT32_MAX / q + 1;
+        const int16_t *src   = coeffs + i * blocks_per_slice;
+        uint16_t      *dst   = levels + i * blocks_per_slice;
+
+        for (j = 0; j < blocks_per_slice; j++) {
+            const uint32_t val   = FFABS(src[j]);
+            const uint32_t level = ((uint64_t)val * recip) >> 32;
+
+            dst[j] = level;
+            error += val - level * q;
+        }
+    }
+
+    return error;
+}
+
 /**
  * Write an unsigned rice/exp golomb codeword.
  */
 static inline void encode_vlc_codeword(PutBitContext *pb, unsigned codebook, int val)
 {
     unsigned int rice_order, exp_order, switch_bits, switch_val;
-    int exponent;
+    int exponent, len;
 
     /* number of prefix bits to switch between Rice and expGolomb */
     switch_bits = (codebook & 3) + 1;
@@ -384,37 +439,40 @@ static inline void encode_vlc_codeword(PutBitContext *pb, unsigned codebook, int
     if (val >= switch_val) {
         val -= switch_val - (1 << exp_order);
         exponent = av_log2(val);
+        len      = exponent * 2 - exp_order + switch_bits + 1;
 
-        put_bits(pb, exponent - exp_order + switch_bits, 0);
-        put_bits(pb, exponent + 1, val);
+        /* the zero prefix is implied by the value width */
+        if (len < 32) {
+            put_bits(pb, len, val);
+        } else {
+            put_bits(pb, exponent - exp_order + switch_bits, 0);
+            put_bits(pb, exponent + 1, val);
+        }
     } else {
         exponent = val >> rice_order;
 
-        if (exponent)
-            put_bits(pb, exponent, 0);
-        put_bits(pb, 1, 1);
-        if (rice_order)
-            put_sbits(pb, rice_order, val);
+        /* unary prefix, stop bit and rice suffix in one go */
+        put_bits(pb, exponent + 1 + rice_order,
+                 (1 << rice_order) | (val & ((1 << rice_order) - 1)));
     }
 }
 
 #define GET_SIGN(x)  ((x) >> 31)
 #define MAKE_CODE(x) ((((x)) * 2) ^ GET_SIGN(x))
 
-static void encode_dcs(PutBitContext *pb, int16_t *blocks,
+static void encode_dcs(PutBitContext *pb, const int16_t *dcs,
                        int blocks_per_slice, int scale)
 {
     int i;
     int codebook = 3, code, dc, prev_dc, delta, sign, new_sign;
 
-    prev_dc = (blocks[0] - 0x4000) / scale;
+    prev_dc = (dcs[0] - 0x4000) / scale;
     encode_vlc_codeword(pb, FIRST_DC_CB, MAKE_CODE(prev_dc));
     sign     = 0;
     codebook = 3;
-    blocks  += 64;
 
-    for (i = 1; i < blocks_per_slice; i++, blocks += 64) {
-        dc       = (blocks[0] - 0x4000) / scale;
+    for (i = 1; i < blocks_per_slice; i++) {
+        dc       = (dcs[i] - 0x4000) / scale;
         delta    = dc - prev_dc;
         new_sign = GET_SIGN(delta);
         delta    = (delta ^ sign) - sign;
@@ -427,36 +485,30 @@ static void encode_dcs(PutBitContext *pb, int16_t *blocks,
     }
 }
 
-static void encode_acs(PutBitContext *pb, int16_t *blocks,
-                       int blocks_per_slice,
-                       int plane_size_factor,
-                       const uint8_t *scan, const int16_t *qmat)
+static void encode_acs(PutBitContext *pb, const int16_t *coeffs,
+                       const uint16_t *levels, int blocks_per_slice)
 {
-    int idx, i;
+    int idx;
     int run, level, run_cb, lev_cb;
-    int max_coeffs, abs_level;
+    int max_coeffs;
 
     max_coeffs = blocks_per_slice << 6;
     run_cb     = ff_prores_run_to_cb_index[4];
     lev_cb     = ff_prores_lev_to_cb_index[2];
     run        = 0;
 
-    for (i = 1; i < 64; i++) {
-        for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level = blocks[idx] / qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
-                encode_vlc_codeword(pb, ff_prores_ac_codebook[run_cb], run);
-                encode_vlc_codeword(pb, ff_prores_ac_codebook[lev_cb],
-                                    abs_level - 1);
-                put_sbits(pb, 1, GET_SIGN(level));
-
-                run_cb = ff_prores_run_to_cb_index[FFMIN(run, 15)];
-                lev_cb = ff_prores_lev_to_cb_index[FFMIN(abs_level, 9)];
-                run    = 0;
-            } else {
-                run++;
-            }
+    for (idx = blocks_per_slice; idx < max_coeffs; idx++) {
+        level = levels[idx];
+        if (level) {
+            encode_vlc_codeword(pb, ff_prores_ac_codebook[run_cb], run);
+            encode_vlc_codeword(pb, ff_prores_ac_codebook[lev_cb], level - 1);
+            put_bits(pb, 1, coeffs[idx] < 0);
+
+            run_cb = ff_prores_run_to_cb_index[FFMIN(run, 15)];
+            lev_cb = ff_prores_lev_to_cb_index[FFMIN(level, 9)];
+            run    = 0;
+        } else {
+            run++;
         }
     }
 }
@@ -472,9 +524,11 @@ static int encode_slice_plane(ProresContext *ctx, PutBitContext *pb,
     saved_pos = put_bits_count(pb);
     blocks_per_slice = mbs_per_slice * blocks_per_mb;
 
-    encode_dcs(pb, blocks, blocks_per_slice, qmat[0]);
-    encode_acs(pb, blocks, blocks_per_slice, plane_size_factor,
-               ctx->scantable, qmat);
+    scan_slice_plane(ctx->coeffs, blocks, blocks_per_slice, ctx->scantable);
+    quantize_slice_plane(ctx->levels, ctx->coeffs, blocks_per_slice,
+                         qmat, ctx->scantable);
+    encode_dcs(pb, ctx->coeffs, blocks_per_slice, qmat[0]);
+    encode_acs(pb, ctx->coeffs, ctx->levels, blocks_per_slice);
     flush_put_bits(pb);
 
     return (put_bits_count(pb) - saved_pos) >> 3;
@@ -657,23 +711,22 @@ static inline int estimate_vlc(unsigned codebook, int val)
     }
 }
 
-static int estimate_dcs(int *error, int16_t *blocks, int blocks_per_slice,
+static int estimate_dcs(int *error, const int16_t *dcs, int blocks_per_slice,
                         int scale)
 {
     int i;
     int codebook = 3, code, dc, prev_dc, delta, sign, new_sign;
     int bits;
 
-    prev_dc  = (blocks[0] - 0x4000) / scale;
+    prev_dc  = (dcs[0] - 0x4000) / scale;
     bits     = estimate_vlc(FIRST_DC_CB, MAKE_CODE(prev_dc));
     sign     = 0;
     codebook = 3;
-    blocks  += 64;
-    *error  += FFABS(blocks[0] - 0x4000) % scale;
+    *error  += FFABS(dcs[1] - 0x4000) % scale;
 
-    for (i = 1; i < blocks_per_slice; i++, blocks += 64) {
-        dc       = (blocks[0] - 0x4000) / scale;
-        *error  += FFABS(blocks[0] - 0x4000) % scale;
+    for (i = 1; i < blocks_per_slice; i++) {
+        dc       = (dcs[i] - 0x4000) / scale;
+        *error  += FFABS(dcs[i] - 0x4000) % scale;
         delta    = dc - prev_dc;
         new_sign = GET_SIGN(delta);
         delta    = (delta ^ sign) - sign;
@@ -688,13 +741,11 @@ static int estimate_dcs(int *error, int16_t *blocks, int blocks_per_slice,
     return bits;
 }
 
-static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
-                        int plane_size_factor,
-                        const uint8_t *scan, const int16_t *qmat)
+static int estimate_acs(const uint16_t *levels, int blocks_per_slice)
 {
-    int idx, i;
+    int idx;
     int run, level, run_cb, lev_cb;
-    int max_coeffs, abs_level;
+    int max_coeffs;
     int bits = 0;
 
     max_coeffs = blocks_per_slice << 6;
@@ -702,22 +753,17 @@ static int estimate_acs(int *error, int16_t *blocks, int blocks_per_slice,
     lev_cb     = ff_prores_lev_to_cb_index[2];
     run        = 0;
 
-    for (i = 1; i < 64; i++) {
-        for (idx = scan[i]; idx < max_coeffs; idx += 64) {
-            level   = blocks[idx] / qmat[scan[i]];
-            *error += FFABS(blocks[idx]) % qmat[scan[i]];
-            if (level) {
-                abs_level = FFABS(level);
-                bits += estimate_vlc(ff_prores_ac_codebook[run_cb], run);
-                bits += estimate_vlc(ff_prores_ac_codebook[lev_cb],
-                                     abs_level - 1) + 1;
-
-                run_cb = ff_prores_run_to_cb_index[FFMIN(run, 15)];
-                lev_cb = ff_prores_lev_to_cb_index[FFMIN(abs_level, 9)];
-                run    = 0;
-            } else {
-                run++;
-            }
+    for (idx = blocks_per_slice; idx < max_coeffs; idx++) {
+        level = levels[idx];
+        if (level) {
+            bits += estimate_vlc(ff_prores_ac_codebook[run_cb], run);
+            bits += estimate_vlc(ff_prores_ac_codebook[lev_cb], level - 1) + 1;
+
+            run_cb = ff_prores_run_to_cb_index[FFMIN(run, 15)];
+            lev_cb = ff_prores_lev_to_cb_index[FFMIN(level, 9)];
+            run    = 0;
+        } else {
+            run++;
         }
     }
 
@@ -735,9 +781,10 @@ static int estimate_slice_plane(ProresContext *ctx, int *error, int plane,
 
     blocks_per_slice = mbs_per_slice * blocks_per_mb;
 
-    bits  = estimate_dcs(error, td->blocks[plane], blocks_per_slice, qmat[0]);
-    bits += estimate_acs(error, td->blocks[plane], blocks_per_slice,
-                         plane_size_factor, ctx->scantable, qmat);
+    bits    = estimate_dcs(error, td->coeffs[plane], blocks_per_slice, qmat[0]);
+    *error += quantize_slice_plane(td->levels, td->coeffs[plane],
+                                   blocks_per_slice, qmat, ctx->scantable);
+    bits   += estimate_acs(td->levels, blocks_per_slice);
 
     return FFALIGN(bits, 8);
 }
@@ -852,6 +899,8 @@ static int find_slice_quant(AVCodecContext *avctx,
                            pwidth, avctx->height / ctx->pictures_per_frame,
                            td->blocks[i], td->emu_buf,
                            mbs_per_slice, num_cblocks[i], is_chroma[i]);
+            scan_slice_plane(td->coeffs[i], td->blocks[i],
+                             mbs_per_slice * num_cblocks[i], ctx->scantable);
         } else {
             get_alpha_data(ctx, src, linesize[i], xp, yp,
                            pwidth, avctx->height / ctx->pictures_per_frame,
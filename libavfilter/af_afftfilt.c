@@ -34,12 +34,15 @@ typedef struct AFFTFiltContext {
     char *img_str;
     int fft_bits;
 
-    FFTContext *fft, *ifft;
+    FFTContext **fft, **ifft;
+    int nb_fft;
     FFTComplex **fft_data;
     int nb_exprs;
     int window_size;
     AVExpr **real;
     AVExpr **imag;
+    uint8_t *real_per_bin, *imag_per_bin;
+    float **real_lut, **imag_lut;
     AVAudioFifo *fifo;
     int64_t pts;
     int hop_size;
@@ -88,6 +91,44 @@ static const AVOption afftfilt_options[] = {
 
 AVFILTER_DEFINE_CLASS(afftfilt);
 
+/**
+ * Find out how often an expression has to be evaluated: a result which only
+ * depends on the bin number is stored in a per bin table, one which does not
+ * depend on it only needs one evaluation per channel and frame.
+ */
+static int setup_expr(AFFTFiltContext *s, AVExpr *e, int ch, int channels,
+                      int sample_rate, uint8_t *per_bin, float **lut)
+{
+    unsigned counter[VAR_VARS_NB] = { 0 };
+    double values[VAR_VARS_NB] = { 0 };
+    int ret, stateful, n;
+
+    ret = av_expr_count_vars(e, counter, VAR_VARS_NB);
+    if (ret < 0)
+        return ret;
+    stateful = av_expr_is_stateful(e);
+
+    *per_bin = stateful || counter[VAR_BIN];
+    if (stateful || counter[VAR_PTS] || !counter[VAR_BIN])
+        return 0;
+
+    *lut = av_malloc_array(s->window_size / 2, sizeof(**lut));
+    if (!*lut)
+        return AVERROR(ENOMEM);
+
+    values[VAR_SAMPLE_RATE] = sample_rate;
+    values[VAR_NBBINS]      = s->window_size / 2;
+    values[VAR_CHANNEL]     = ch;
+    values[VAR_CHANNELS]    = channels;
+
+    for (n = 0; n < s->window_size / 2; n++) {
+        values[VAR_BIN] = n;
+        (*lut)[n] = av_expr_eval(e, values, s);
+    }
+
+    return 0;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -98,11 +139,21 @@ static int config_input(AVFilterLink *inlink)
     char *args;
     const char *last_expr = "1";
 
-    s->fft  = av_fft_init(s->fft_bits, 0);
-    s->ifft = av_fft_init(s->fft_bits, 1);
+    s->nb_fft = FFMIN(inlink->channels, ff_filter_get_nb_threads(ctx));
+
+    s->fft  = av_calloc(s->nb_fft, sizeof(*s->fft));
+    s->ifft = av_calloc(s->nb_fft, sizeof(*s->ifft));
     if (!s->fft || !s->ifft)
         return AVERROR(ENOMEM);
 
+    /* the FFT contexts use a scratch buffer, so each job needs its own */
+    for (i = 0; i < s->nb_fft; i++) {
+        s->fft[i]  = av_fft_init(s->fft_bits, 0);
+        s->ifft[i] = av_fft_init(s->fft_bits, 1);
+        if (!s->fft[i] || !s->ifft[i])
+            return AVERROR(ENOMEM);
+    }
+
     s->window_size = 1 << s->fft_bits;
 
     s->fft_data = av_calloc(inlink->channels, sizeof(*s->fft_data));
@@ -123,6 +174,13 @@ static int config_input(AVFilterLink *inlink)
     if (!s->imag)
         return AVERROR(ENOMEM);
 
+    s->real_per_bin = av_calloc(inlink->channels, sizeof(*s->real_per_bin));
+    s->imag_per_bin = av_calloc(inlink->channels, sizeof(*s->imag_per_bin));
+    s->real_lut     = av_calloc(inlink->channels, sizeof(*s->real_lut));
+    s->imag_lut     = av_calloc(inlink->channels, sizeof(*s->imag_lut));
+    if (!s->real_per_bin || !s->imag_per_bin || !s->real_lut || !s->imag_lut)
+        return AVERROR(ENOMEM);
+
     args = av_strdup(s->real_str);
     if (!args)
         return AVERROR(ENOMEM);
@@ -140,6 +198,8 @@ static int config_input(AVFilterLink *inlink)
     }
 
     av_free(args);
+    if (ret < 0)
+        return ret;
 
     args = av_strdup(s->img_str ? s->img_str : s->real_str);
     if (!args)
@@ -157,6 +217,19 @@ static int config_input(AVFilterLink *inlink)
     }
 
     av_free(args);
+    if (ret < 0)
+        return ret;
+
+    for (ch = 0; ch < inlink->channels; ch++) {
+        ret = setup_expr(s, s->real[ch], ch, inlink->channels, inlink->sample_rate,
+                         &s->real_per_bin[ch], &s->real_lut[ch]);
+        if (ret < 0)
+            return ret;
+        ret = setup_expr(s, s->imag[ch], ch, inlink->channels, inlink->sample_rate,
+                         &s->imag_per_bin[ch], &s->imag_lut[ch]);
+        if (ret < 0)
+            return ret;
+    }
 
     s->fifo = av_audio_fifo_alloc(inlink->format, inlink->channels, s->window_size);
     if (!s->fifo)
@@ -185,17 +258,97 @@ static int config_input(AVFilterLink *inlink)
     return ret;
 }
 
+static int filter_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AFFTFiltContext *s = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in = arg;
+    const int window_size = s->window_size;
+    const float f = 1. / s->win_scale;
+    const int ch_start = (inlink->channels *  jobnr   ) / nb_jobs;
+    const int ch_end   = (inlink->channels * (jobnr+1)) / nb_jobs;
+    FFTContext *fft = s->fft[jobnr], *ifft = s->ifft[jobnr];
+    double values[VAR_VARS_NB];
+    int ch, n, i, j, x;
+
+    values[VAR_PTS]         = s->pts;
+    values[VAR_SAMPLE_RATE] = inlink->sample_rate;
+    values[VAR_BIN]         = 0;
+    values[VAR_NBBINS]      = window_size / 2;
+    values[VAR_CHANNELS]    = inlink->channels;
+
+    for (ch = ch_start; ch < ch_end; ch++) {
+        const float *src = (float *)in->extended_data[ch];
+        FFTComplex *fft_data = s->fft_data[ch];
+        float *buf = (float *)s->buffer->extended_data[ch];
+        const float *real_lut = s->real_lut[ch];
+        const float *imag_lut = s->imag_lut[ch];
+        float fr = 0, fi = 0;
+
+        for (n = 0; n < in->nb_samples; n++) {
+            fft_data[n].re = src[n] * s->window_func_lut[n];
+            fft_data[n].im = 0;
+        }
+
+        for (; n < window_size; n++) {
+            fft_data[n].re = 0;
+            fft_data[n].im = 0;
+        }
+
+        values[VAR_CHANNEL] = ch;
+
+        av_fft_permute(fft, fft_data);
+        av_fft_calc(fft, fft_data);
+
+        if (!s->real_per_bin[ch])
+            fr = av_expr_eval(s->real[ch], values, s);
+        if (!s->imag_per_bin[ch])
+            fi = av_expr_eval(s->imag[ch], values, s);
+
+        for (n = 0; n < window_size / 2; n++) {
+            values[VAR_BIN] = n;
+
+            if (real_lut)
+                fr = real_lut[n];
+            else if (s->real_per_bin[ch])
+                fr = av_expr_eval(s->real[ch], values, s);
+            if (imag_lut)
+                fi = imag_lut[n];
+            else if (s->imag_per_bin[ch])
+                fi = av_expr_eval(s->imag[ch], values, s);
+
+            fft_data[n].re *= fr;
+            fft_data[n].im *= fi;
+        }
+
+        for (n = window_size / 2 + 1, x = window_size / 2 - 1; n < window_size; n++, x--) {
+            fft_data[n].re =  fft_data[x].re;
+            fft_data[n].im = -fft_data[x].im;
+        }
+
+        av_fft_permute(ifft, fft_data);
+        av_fft_calc(ifft, fft_data);
+
+        for (i = 0, j = s->start; j < s->end && i < window_size; i++, j++) {
+            buf[j] += fft_data[i].re * f;
+        }
+
+        for (; i < window_size; i++, j++) {
+            buf[j] = fft_data[i].re * f;
+        }
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     AFFTFiltContext *s = ctx->priv;
     const int window_size = s->window_size;
-    const float f = 1. / s->win_scale;
-    double values[VAR_VARS_NB];
     AVFrame *out, *in = NULL;
-    int ch, n, ret, i, j, k;
-    int start = s->start, end = s->end;
+    int ch, n, ret;
 
     ret = av_audio_fifo_write(s->fifo, (void **)frame->extended_data, frame->nb_samples);
     av_frame_free(&frame);
@@ -213,82 +366,16 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
         if (ret < 0)
             break;
 
-        for (ch = 0; ch < inlink->channels; ch++) {
-            const float *src = (float *)in->extended_data[ch];
-            FFTComplex *fft_data = s->fft_data[ch];
-
-            for (n = 0; n < in->nb_samples; n++) {
-                fft_data[n].re = src[n] * s->window_func_lut[n];
-                fft_data[n].im = 0;
-            }
-
-            for (; n < window_size; n++) {
-                fft_data[n].re = 0;
-                fft_data[n].im = 0;
-            }
-        }
-
-        values[VAR_PTS]         = s->pts;
-        values[VAR_SAMPLE_RATE] = inlink->sample_rate;
-        values[VAR_NBBINS]      = window_size / 2;
-        values[VAR_CHANNELS]    = inlink->channels;
+        ctx->internal->execute(ctx, filter_channels, in, NULL, s->nb_fft);
 
-        for (ch = 0; ch < inlink->channels; ch++) {
-            FFTComplex *fft_data = s->fft_data[ch];
-            float *buf = (float *)s->buffer->extended_data[ch];
-            int x;
+        s->end    = s->start + window_size;
+        s->start += s->hop_size;
 
-            values[VAR_CHANNEL] = ch;
-
-            av_fft_permute(s->fft, fft_data);
-            av_fft_calc(s->fft, fft_data);
-
-            for (n = 0; n < window_size / 2; n++) {
-                float fr, fi;
-
-                values[VAR_BIN] = n;
-
-                fr = av_expr_eval(s->real[ch], values, s);
-                fi = av_expr_eval(s->imag[ch], values, s);
-
-                fft_data[n].re *= fr;
-                fft_data[n].im *= fi;
-            }
-
-            for (n = window_size / 2 + 1, x = window_size / 2 - 1; n < window_size; n++, x--) {
-                fft_data[n].re =  fft_data[x].re;
-                fft_data[n].im = -fft_data[x].im;
-            }
-
-            av_fft_permute(s->ifft, fft_data);
-            av_fft_calc(s->ifft, fft_data);
-
-            start = s->start;
-            end = s->end;
-            k = end;
-            for (i = 0, j = start; j < k && i < window_size; i++, j++) {
-                buf[j] += s->fft_data[ch][i].re * f;
-            }
-
-            for (; i < window_size; i++, j++) {
-                buf[j] = s->fft_data[ch][i].re * f;
-            }
-
-            start += s->hop_size;
-            end = j;
-        }
-
-        s->start = start;
-        s->end = end;
-
-        if (start >= window_size) {
+        if (s->start >= window_size) {
             float *dst, *buf;
 
-            start -= window_size;
-            end   -= window_size;
-
-            s->start = start;
-            s->end = end;
+            s->start -= window_size;
+            s->end   -= window_size;
 
             out = ff_get_audio_buffer(outlink, window_size);
             if (!out) {
@@ -356,8 +443,14 @@ static av_cold void uninit(AVFilterContext *ctx)
     AFFTFiltContext *s = ctx->priv;
     int i;
 
-    av_fft_end(s->fft);
-    av_fft_end(s->ifft);
+    for (i = 0; i < s->nb_fft; i++) {
+        if (s->fft)
+            av_fft_end(s->fft[i]);
+        if (s->ifft)
+            av_fft_end(s->ifft[i]);
+    }
+    av_freep(&s->fft);
+    av_freep(&s->ifft);
 
     for (i = 0; i < s->nb_exprs; i++) {
         if (s->fft_data)
@@ -368,10 +461,18 @@ static av_cold void uninit(AVFilterContext *ctx)
     for (i = 0; i < s->nb_exprs; i++) {
         av_expr_free(s->real[i]);
         av_expr_free(s->imag[i]);
+        if (s->real_lut)
+            av_freep(&s->real_lut[i]);
+        if (s->imag_lut)
+            av_freep(&s->imag_lut[i]);
     }
 
     av_freep(&s->real);
     av_freep(&s->imag);
+    av_freep(&s->real_per_bin);
+    av_freep(&s->imag_per_bin);
+    av_freep(&s->real_lut);
+    av_freep(&s->imag_lut);
     av_frame_free(&s->buffer);
     av_freep(&s->window_func_lut);
 
@@ -405,4 +506,5 @@ AVFilter ff_af_afftfilt = {
     .outputs         = outputs,
     .query_formats   = query_formats,
     .uninit          = uninit,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -47,6 +47,7 @@
 
 #define INPUT_ON       1    /**< input is active */
 #define INPUT_EOF      2    /**< input has reached EOF (may still be active) */
+#define INPUT_WANTED   4    /**< a frame was requested on the input and not received yet */
 
 #define DURATION_LONGEST  0
 #define DURATION_SHORTEST 1
@@ -169,6 +170,10 @@ typedef struct MixContext {
     int planar;
     AVAudioFifo **fifos;        /**< audio fifo for each input */
     uint8_t *input_state;       /**< current state of each input */
+    int *active;                /**< indexes of the active inputs, in input order */
+    int nb_draining;            /**< number of active inputs which reached EOF */
+    int blocking_input;         /**< last input found without enough samples */
+    int update_scales;          /**< whether the scaling factors need an update */
     float *input_scale;         /**< mixing scale factor for each input */
     float *weights;             /**< custom weights for every input */
     float weight_sum;           /**< sum of custom weights for every input */
@@ -208,28 +213,51 @@ AVFILTER_DEFINE_CLASS(amix);
 static void calculate_scales(MixContext *s, int nb_samples)
 {
     float weight_sum = 0.f;
-    int i;
-
-    for (i = 0; i < s->nb_inputs; i++)
-        if (s->input_state[i] & INPUT_ON)
-            weight_sum += s->weights[i];
-
-    for (i = 0; i < s->nb_inputs; i++) {
-        if (s->input_state[i] & INPUT_ON) {
-            if (s->scale_norm[i] > weight_sum / s->weights[i]) {
-                s->scale_norm[i] -= ((s->weight_sum / s->weights[i]) / s->nb_inputs) *
-                                    nb_samples / (s->dropout_transition * s->sample_rate);
-                s->scale_norm[i] = FFMAX(s->scale_norm[i], weight_sum / s->weights[i]);
-            }
+    int i, j;
+
+    /* the scales only change when an input drops out, until the end of the
+     * resulting transition */
+    if (!s->update_scales)
+        return;
+    s->update_scales = 0;
+
+    for (j = 0; j < s->active_inputs; j++)
+        weight_sum += s->weights[s->active[j]];
+
+    for (j = 0; j < s->active_inputs; j++) {
+        i = s->active[j];
+        if (s->scale_norm[i] > weight_sum / s->weights[i]) {
+            s->scale_norm[i] -= ((s->weight_sum / s->weights[i]) / s->nb_inputs) *
+                                nb_samples / (s->dropout_transition * s->sample_rate);
+            s->scale_norm[i] = FFMAX(s->scale_norm[i], weight_sum / s->weights[i]);
+            s->update_scales |= s->scale_norm[i] > weight_sum / s->weights[i];
         }
+        s->input_scale[i] = 1.0f / s->scale_norm[i];
     }
+}
 
-    for (i = 0; i < s->nb_inputs; i++) {
-        if (s->input_state[i] & INPUT_ON)
-            s->input_scale[i] = 1.0f / s->scale_norm[i];
-        else
-            s->input_scale[i] = 0.0f;
+/**
+ * Change the state of an input, keeping the set of active inputs up to date.
+ */
+static void set_input_state(MixContext *s, int i, uint8_t state)
+{
+    const uint8_t old = s->input_state[i];
+    int j;
+
+    s->nb_draining += ((state & (INPUT_ON | INPUT_EOF)) == (INPUT_ON | INPUT_EOF)) -
+                      ((old   & (INPUT_ON | INPUT_EOF)) == (INPUT_ON | INPUT_EOF));
+
+    if ((old & INPUT_ON) && !(state & INPUT_ON)) {
+        for (j = 0; s->active[j] != i; j++)
+            ;
+        memmove(&s->active[j], &s->active[j + 1],
+                (s->active_inputs - j - 1) * sizeof(*s->active));
+        s->active_inputs--;
+        s->input_scale[i] = 0.0f;
+        s->update_scales  = 1;
     }
+
+    s->input_state[i] = state;
 }
 
 static int config_output(AVFilterLink *outlink)
@@ -265,12 +293,19 @@ static int config_output(AVFilterLink *outlink)
     memset(s->input_state, INPUT_ON, s->nb_inputs);
     s->active_inputs = s->nb_inputs;
 
+    s->active = av_malloc_array(s->nb_inputs, sizeof(*s->active));
+    if (!s->active)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_inputs; i++)
+        s->active[i] = i;
+
     s->input_scale = av_mallocz_array(s->nb_inputs, sizeof(*s->input_scale));
     s->scale_norm  = av_mallocz_array(s->nb_inputs, sizeof(*s->scale_norm));
     if (!s->input_scale || !s->scale_norm)
         return AVERROR(ENOMEM);
     for (i = 0; i < s->nb_inputs; i++)
         s->scale_norm[i] = s->weight_sum / s->weights[i];
+    s->update_scales = 1;
     calculate_scales(s, 0);
 
     av_get_channel_layout_string(buf, sizeof(buf), -1, outlink->channel_layout);
@@ -290,31 +325,38 @@ static int output_frame(AVFilterLink *outlink)
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
     AVFrame *out_buf, *in_buf;
-    int nb_samples, ns, i;
+    int nb_samples, ns, i, j;
 
     if (s->input_state[0] & INPUT_ON) {
         /* first input live: use the corresponding frame size */
         nb_samples = frame_list_next_frame_size(s->frame_list);
-        for (i = 1; i < s->nb_inputs; i++) {
-            if (s->input_state[i] & INPUT_ON) {
-                ns = av_audio_fifo_size(s->fifos[i]);
-                if (ns < nb_samples) {
-                    if (!(s->input_state[i] & INPUT_EOF))
-                        /* unclosed input with not enough samples */
-                        return 0;
-                    /* closed input to drain */
-                    nb_samples = ns;
+
+        /* unless an input is draining, the input which was missing samples
+         * the last time is checked first, as it most likely still is */
+        if (s->blocking_input && !s->nb_draining &&
+            (s->input_state[s->blocking_input] & INPUT_ON) &&
+            av_audio_fifo_size(s->fifos[s->blocking_input]) < nb_samples)
+            return 0;
+
+        for (j = 1; j < s->active_inputs; j++) {
+            i  = s->active[j];
+            ns = av_audio_fifo_size(s->fifos[i]);
+            if (ns < nb_samples) {
+                if (!(s->input_state[i] & INPUT_EOF)) {
+                    /* unclosed input with not enough samples */
+                    s->blocking_input = i;
+                    return 0;
                 }
+                /* closed input to drain */
+                nb_samples = ns;
             }
         }
     } else {
         /* first input closed: use the available samples */
         nb_samples = INT_MAX;
-        for (i = 1; i < s->nb_inputs; i++) {
-            if (s->input_state[i] & INPUT_ON) {
-                ns = av_audio_fifo_size(s->fifos[i]);
-                nb_samples = FFMIN(nb_samples, ns);
-            }
+        for (j = 0; j < s->active_inputs; j++) {
+            ns = av_audio_fifo_size(s->fifos[s->active[j]]);
+            nb_samples = FFMIN(nb_samples, ns);
         }
         if (nb_samples == INT_MAX) {
             ff_outlink_set_status(outlink, AVERROR_EOF, s->next_pts);
@@ -340,30 +382,29 @@ static int output_frame(AVFilterLink *outlink)
         return AVERROR(ENOMEM);
     }
 
-    for (i = 0; i < s->nb_inputs; i++) {
-        if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
-
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
-                               nb_samples);
-
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
-
-            if (out_buf->format == AV_SAMPLE_FMT_FLT ||
-                out_buf->format == AV_SAMPLE_FMT_FLTP) {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                                (float *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            } else {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p],
-                                                (double *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
+    for (j = 0; j < s->active_inputs; j++) {
+        int planes, plane_size, p;
+
+        i = s->active[j];
+        av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
+                           nb_samples);
+
+        planes     = s->planar ? s->nb_channels : 1;
+        plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
+        plane_size = FFALIGN(plane_size, 16);
+
+        if (out_buf->format == AV_SAMPLE_FMT_FLT ||
+            out_buf->format == AV_SAMPLE_FMT_FLTP) {
+            for (p = 0; p < planes; p++) {
+                s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
+                                            (float *) in_buf->extended_data[p],
+                                            s->input_scale[i], plane_size);
+            }
+        } else {
+            for (p = 0; p < planes; p++) {
+                s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p],
+                                            (double *) in_buf->extended_data[p],
+                                            s->input_scale[i], plane_size);
             }
         }
     }
@@ -382,34 +423,33 @@ static int output_frame(AVFilterLink *outlink)
 static int request_samples(AVFilterContext *ctx, int min_samples)
 {
     MixContext *s = ctx->priv;
-    int i;
+    int i, j;
 
     av_assert0(s->nb_inputs > 1);
 
-    for (i = 1; i < s->nb_inputs; i++) {
-        if (!(s->input_state[i] & INPUT_ON) ||
-             (s->input_state[i] & INPUT_EOF))
+    for (j = 0; j < s->active_inputs; j++) {
+        i = s->active[j];
+        if (!i || (s->input_state[i] & (INPUT_EOF | INPUT_WANTED)))
             continue;
         if (av_audio_fifo_size(s->fifos[i]) >= min_samples)
             continue;
+        /* requesting again before the frame arrives would only wake up the
+         * source filter for nothing */
+        s->input_state[i] |= INPUT_WANTED;
         ff_inlink_request_frame(ctx->inputs[i]);
     }
     return output_frame(ctx->outputs[0]);
 }
 
 /**
- * Calculates the number of active inputs and determines EOF based on the
- * duration option.
+ * Determines EOF based on the number of active inputs and the duration
+ * option.
  *
  * @return 0 if mixing should continue, or AVERROR_EOF if mixing should stop.
  */
 static int calc_active_inputs(MixContext *s)
 {
-    int i;
-    int active_inputs = 0;
-    for (i = 0; i < s->nb_inputs; i++)
-        active_inputs += !!(s->input_state[i] & INPUT_ON);
-    s->active_inputs = active_inputs;
+    const int active_inputs = s->active_inputs;
 
     if (!active_inputs ||
         (s->duration_mode == DURATION_FIRST && !(s->input_state[0] & INPUT_ON)) ||
@@ -431,6 +471,7 @@ static int activate(AVFilterContext *ctx)
         AVFilterLink *inlink = ctx->inputs[i];
 
         if ((ret = ff_inlink_consume_frame(ctx->inputs[i], &buf)) > 0) {
+            s->input_state[i] &= ~INPUT_WANTED;
             if (i == 0) {
                 int64_t pts = av_rescale_q(buf->pts, inlink->time_base,
                                            outlink->time_base);
@@ -463,15 +504,15 @@ static int activate(AVFilterContext *ctx)
         if (ff_inlink_acknowledge_status(ctx->inputs[i], &status, &pts)) {
             if (status == AVERROR_EOF) {
                 if (i == 0) {
-                    s->input_state[i] = 0;
+                    set_input_state(s, i, 0);
                     if (s->nb_inputs == 1) {
                         ff_outlink_set_status(outlink, status, pts);
                         return 0;
                     }
                 } else {
-                    s->input_state[i] |= INPUT_EOF;
+                    set_input_state(s, i, s->input_state[i] | INPUT_EOF);
                     if (av_audio_fifo_size(s->fifos[i]) == 0) {
-                        s->input_state[i] = 0;
+                        set_input_state(s, i, 0);
                     }
                 }
             }
@@ -564,6 +605,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     frame_list_clear(s->frame_list);
     av_freep(&s->frame_list);
     av_freep(&s->input_state);
+    av_freep(&s->active);
     av_freep(&s->input_scale);
     av_freep(&s->scale_norm);
     av_freep(&s->weights);
@@ -116,6 +116,10 @@ typedef struct ATempoContext {
     // fragment window size, power-of-two integer:
     int window;
 
+    // requested fragment window duration, 0 to pick one
+    // based on the sample rate:
+    int64_t window_duration;
+
     // Hann window coefficients, for feathering
     // (blending) the overlapping fragment region:
     float *hann;
@@ -152,6 +156,9 @@ typedef struct ATempoContext {
 #define YAE_ATEMPO_MIN 0.5
 #define YAE_ATEMPO_MAX 100.0
 
+// longest allowed fragment window duration, in microseconds:
+#define YAE_WINDOW_MAX 100000
+
 #define OFFSET(x) offsetof(ATempoContext, x)
 
 static const AVOption atempo_options[] = {
@@ -160,6 +167,11 @@ static const AVOption atempo_options[] = {
       YAE_ATEMPO_MIN,
       YAE_ATEMPO_MAX,
       AV_OPT_FLAG_AUDIO_PARAM | AV_OPT_FLAG_FILTERING_PARAM },
+    { "window", "set fragment window duration, 0 for automatic",
+      OFFSET(window_duration), AV_OPT_TYPE_DURATION, { .i64 = 0 },
+      0,
+      YAE_WINDOW_MAX,
+      AV_OPT_FLAG_AUDIO_PARAM | AV_OPT_FLAG_FILTERING_PARAM },
     { NULL }
 };
 
@@ -268,8 +280,13 @@ static int yae_reset(ATempoContext *atempo,
     atempo->channels = channels;
     atempo->stride   = sample_size * channels;
 
-    // pick a segment window size:
-    atempo->window = sample_rate / 24;
+    // pick a segment window size, shorter windows reduce the latency
+    // at the cost of worse alignment of low frequencies:
+    if (atempo->window_duration)
+        atempo->window = av_rescale(atempo->window_duration, sample_rate, AV_TIME_BASE);
+    else
+        atempo->window = sample_rate / 24;
+    atempo->window = av_clip(atempo->window, 16, 1 << 15);
 
     // adjust window size to be a power-of-two integer:
     nlevels = av_log2(atempo->window);
@@ -739,28 +756,27 @@ static int yae_adjust_position(ATempoContext *atempo)
         const scalar_type *aaa = (const scalar_type *)a;                \
         const scalar_type *bbb = (const scalar_type *)b;                \
                                                                         \
-        scalar_type *out     = (scalar_type *)dst;                      \
-        scalar_type *out_end = (scalar_type *)dst_end;                  \
+        scalar_type *out = (scalar_type *)dst;                          \
         int64_t i;                                                      \
+        int j;                                                          \
+                                                                        \
+        for (i = 0; i < nzero * atempo->channels; i++)                  \
+            out[i] = aaa[i];                                            \
                                                                         \
-        for (i = 0; i < overlap && out < out_end;                       \
-             i++, atempo->position[1]++, wa++, wb++) {                  \
-            float w0 = *wa;                                             \
-            float w1 = *wb;                                             \
-            int j;                                                      \
+        for (i = nzero; i < nblend; i++) {                              \
+            const float w0 = wa[i];                                     \
+            const float w1 = wb[i];                                     \
+            const scalar_type *aa = aaa + i * atempo->channels;         \
+            const scalar_type *bb = bbb + i * atempo->channels;         \
+            scalar_type *o = out + i * atempo->channels;                \
                                                                         \
-            for (j = 0; j < atempo->channels;                           \
-                 j++, aaa++, bbb++, out++) {                            \
-                float t0 = (float)*aaa;                                 \
-                float t1 = (float)*bbb;                                 \
+            for (j = 0; j < atempo->channels; j++) {                    \
+                float t0 = (float)aa[j];                                \
+                float t1 = (float)bb[j];                                \
                                                                         \
-                *out =                                                  \
-                    frag->position[0] + i < 0 ?                         \
-                    *aaa :                                              \
-                    (scalar_type)(t0 * w0 + t1 * w1);                   \
+                o[j] = (scalar_type)(t0 * w0 + t1 * w1);                \
             }                                                           \
         }                                                               \
-        dst = (uint8_t *)out;                                           \
     } while (0)
 
 /**
@@ -798,6 +814,12 @@ static int yae_overlap_add(ATempoContext *atempo,
 
     uint8_t *dst = *dst_ref;
 
+    // number of samples that fit in the dst buffer:
+    const int64_t nblend = FFMIN(overlap, (dst_end - dst) / atempo->stride);
+
+    // samples preceding the beginning of the input are passed through:
+    const int64_t nzero = av_clip64(-frag->position[0], 0, nblend);
+
     av_assert0(start_here <= stop_here &&
                frag->position[1] <= start_here &&
                overlap <= frag->nsamples);
@@ -814,6 +836,9 @@ static int yae_overlap_add(ATempoContext *atempo,
         yae_blend(double);
     }
 
+    dst += nblend * atempo->stride;
+    atempo->position[1] += nblend;
+
     // pass-back the updated destination buffer pointer:
     *dst_ref = dst;
 
@@ -67,9 +67,10 @@ typedef struct FIREqualizerContext {
 
     RDFTContext   *analysis_rdft;
     RDFTContext   *analysis_irdft;
-    RDFTContext   *rdft;
-    RDFTContext   *irdft;
-    FFTContext    *fft_ctx;
+    RDFTContext   **rdft;
+    RDFTContext   **irdft;
+    FFTContext    **fft_ctx;
+    int           nb_rdft;
     RDFTContext   *cepstrum_rdft;
     RDFTContext   *cepstrum_irdft;
     int           analysis_rdft_len;
@@ -148,15 +149,26 @@ AVFILTER_DEFINE_CLASS(firequalizer);
 
 static void common_uninit(FIREqualizerContext *s)
 {
+    int i;
+
+    for (i = 0; i < s->nb_rdft; i++) {
+        if (s->rdft)
+            av_rdft_end(s->rdft[i]);
+        if (s->irdft)
+            av_rdft_end(s->irdft[i]);
+        if (s->fft_ctx)
+            av_fft_end(s->fft_ctx[i]);
+    }
+    av_freep(&s->rdft);
+    av_freep(&s->irdft);
+    av_freep(&s->fft_ctx);
+    s->nb_rdft = 0;
+
     av_rdft_end(s->analysis_rdft);
     av_rdft_end(s->analysis_irdft);
-    av_rdft_end(s->rdft);
-    av_rdft_end(s->irdft);
-    av_fft_end(s->fft_ctx);
     av_rdft_end(s->cepstrum_rdft);
     av_rdft_end(s->cepstrum_irdft);
-    s->analysis_rdft = s->analysis_irdft = s->rdft = s->irdft = NULL;
-    s->fft_ctx = NULL;
+    s->analysis_rdft = s->analysis_irdft = NULL;
     s->cepstrum_rdft = NULL;
     s->cepstrum_irdft = NULL;
 
@@ -208,7 +220,8 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_samplerates(ctx, formats);
 }
 
-static void fast_convolute(FIREqualizerContext *av_restrict s, const float *av_restrict kernel_buf, float *av_restrict conv_buf,
+static void fast_convolute(FIREqualizerContext *av_restrict s, RDFTContext *rdft, RDFTContext *irdft,
+                           const float *av_restrict kernel_buf, float *av_restrict conv_buf,
                            OverlapIndex *av_restrict idx, float *av_restrict data, int nsamples)
 {
     if (nsamples <= s->nsamples_max) {
@@ -220,7 +233,7 @@ static void fast_convolute(FIREqualizerContext *av_restrict s, const float *av_r
         memset(buf, 0, center * sizeof(*data));
         memcpy(buf + center, data, nsamples * sizeof(*data));
         memset(buf + center + nsamples, 0, (s->rdft_len - nsamples - center) * sizeof(*data));
-        av_rdft_calc(s->rdft, buf);
+        av_rdft_calc(rdft, buf);
 
         buf[0] *= kernel_buf[0];
         buf[1] *= kernel_buf[s->rdft_len/2];
@@ -229,7 +242,7 @@ static void fast_convolute(FIREqualizerContext *av_restrict s, const float *av_r
             buf[2*k+1] *= kernel_buf[k];
         }
 
-        av_rdft_calc(s->irdft, buf);
+        av_rdft_calc(irdft, buf);
         for (k = 0; k < s->rdft_len - idx->overlap_idx; k++)
             buf[k] += obuf[k];
         memcpy(data, buf, nsamples * sizeof(*data));
@@ -237,18 +250,18 @@ static void fast_convolute(FIREqualizerContext *av_restrict s, const float *av_r
         idx->overlap_idx = nsamples;
     } else {
         while (nsamples > s->nsamples_max * 2) {
-            fast_convolute(s, kernel_buf, conv_buf, idx, data, s->nsamples_max);
+            fast_convolute(s, rdft, irdft, kernel_buf, conv_buf, idx, data, s->nsamples_max);
             data += s->nsamples_max;
             nsamples -= s->nsamples_max;
         }
-        fast_convolute(s, kernel_buf, conv_buf, idx, data, nsamples/2);
-        fast_convolute(s, kernel_buf, conv_buf, idx, data + nsamples/2, nsamples - nsamples/2);
+        fast_convolute(s, rdft, irdft, kernel_buf, conv_buf, idx, data, nsamples/2);
+        fast_convolute(s, rdft, irdft, kernel_buf, conv_buf, idx, data + nsamples/2, nsamples - nsamples/2);
     }
 }
 
-static void fast_convolute_nonlinear(FIREqualizerContext *av_restrict s, const float *av_restrict kernel_buf,
-                                     float *av_restrict conv_buf, OverlapIndex *av_restrict idx,
-                                     float *av_restrict data, int nsamples)
+static void fast_convolute_nonlinear(FIREqualizerContext *av_restrict s, RDFTContext *rdft, RDFTContext *irdft,
+                                     const float *av_restrict kernel_buf, float *av_restrict conv_buf,
+                                     OverlapIndex *av_restrict idx, float *av_restrict data, int nsamples)
 {
     if (nsamples <= s->nsamples_max) {
         float *buf = conv_buf + idx->buf_idx * s->rdft_len;
@@ -257,7 +270,7 @@ static void fast_convolute_nonlinear(FIREqualizerContext *av_restrict s, const f
 
         memcpy(buf, data, nsamples * sizeof(*data));
         memset(buf + nsamples, 0, (s->rdft_len - nsamples) * sizeof(*data));
-        av_rdft_calc(s->rdft, buf);
+        av_rdft_calc(rdft, buf);
 
         buf[0] *= kernel_buf[0];
         buf[1] *= kernel_buf[1];
@@ -269,7 +282,7 @@ static void fast_convolute_nonlinear(FIREqualizerContext *av_restrict s, const f
             buf[k+1] = im;
         }
 
-        av_rdft_calc(s->irdft, buf);
+        av_rdft_calc(irdft, buf);
         for (k = 0; k < s->rdft_len - idx->overlap_idx; k++)
             buf[k] += obuf[k];
         memcpy(data, buf, nsamples * sizeof(*data));
@@ -277,16 +290,17 @@ static void fast_convolute_nonlinear(FIREqualizerContext *av_restrict s, const f
         idx->overlap_idx = nsamples;
     } else {
         while (nsamples > s->nsamples_max * 2) {
-            fast_convolute_nonlinear(s, kernel_buf, conv_buf, idx, data, s->nsamples_max);
+            fast_convolute_nonlinear(s, rdft, irdft, kernel_buf, conv_buf, idx, data, s->nsamples_max);
             data += s->nsamples_max;
             nsamples -= s->nsamples_max;
         }
-        fast_convolute_nonlinear(s, kernel_buf, conv_buf, idx, data, nsamples/2);
-        fast_convolute_nonlinear(s, kernel_buf, conv_buf, idx, data + nsamples/2, nsamples - nsamples/2);
+        fast_convolute_nonlinear(s, rdft, irdft, kernel_buf, conv_buf, idx, data, nsamples/2);
+        fast_convolute_nonlinear(s, rdft, irdft, kernel_buf, conv_buf, idx, data + nsamples/2, nsamples - nsamples/2);
     }
 }
 
-static void fast_convolute2(FIREqualizerContext *av_restrict s, const float *av_restrict kernel_buf, FFTComplex *av_restrict conv_buf,
+static void fast_convolute2(FIREqualizerContext *av_restrict s, FFTContext *fft_ctx,
+                            const float *av_restrict kernel_buf, FFTComplex *av_restrict conv_buf,
                             OverlapIndex *av_restrict idx, float *av_restrict data0, float *av_restrict data1, int nsamples)
 {
     if (nsamples <= s->nsamples_max) {
@@ -302,8 +316,8 @@ static void fast_convolute2(FIREqualizerContext *av_restrict s, const float *av_
             buf[center+k].im = data1[k];
         }
         memset(buf + center + nsamples, 0, (s->rdft_len - nsamples - center) * sizeof(*buf));
-        av_fft_permute(s->fft_ctx, buf);
-        av_fft_calc(s->fft_ctx, buf);
+        av_fft_permute(fft_ctx, buf);
+        av_fft_calc(fft_ctx, buf);
 
         /* swap re <-> im, do backward fft using forward fft_ctx */
         /* normalize with 0.5f */
@@ -323,8 +337,8 @@ static void fast_convolute2(FIREqualizerContext *av_restrict s, const float *av_
         buf[k].re = 0.5f * kernel_buf[k] * buf[k].im;
         buf[k].im = 0.5f * kernel_buf[k] * tmp;
 
-        av_fft_permute(s->fft_ctx, buf);
-        av_fft_calc(s->fft_ctx, buf);
+        av_fft_permute(fft_ctx, buf);
+        av_fft_calc(fft_ctx, buf);
 
         for (k = 0; k < s->rdft_len - idx->overlap_idx; k++) {
             buf[k].re += obuf[k].re;
@@ -340,13 +354,13 @@ static void fast_convolute2(FIREqualizerContext *av_restrict s, const float *av_
         idx->overlap_idx = nsamples;
     } else {
         while (nsamples > s->nsamples_max * 2) {
-            fast_convolute2(s, kernel_buf, conv_buf, idx, data0, data1, s->nsamples_max);
+            fast_convolute2(s, fft_ctx, kernel_buf, conv_buf, idx, data0, data1, s->nsamples_max);
             data0 += s->nsamples_max;
             data1 += s->nsamples_max;
             nsamples -= s->nsamples_max;
         }
-        fast_convolute2(s, kernel_buf, conv_buf, idx, data0, data1, nsamples/2);
-        fast_convolute2(s, kernel_buf, conv_buf, idx, data0 + nsamples/2, data1 + nsamples/2, nsamples - nsamples/2);
+        fast_convolute2(s, fft_ctx, kernel_buf, conv_buf, idx, data0, data1, nsamples/2);
+        fast_convolute2(s, fft_ctx, kernel_buf, conv_buf, idx, data0 + nsamples/2, data1 + nsamples/2, nsamples - nsamples/2);
     }
 }
 
@@ -717,7 +731,7 @@ static int generate_kernel(AVFilterContext *ctx, const char *gain, const char *g
         memcpy(rdft_buf + s->rdft_len/2, s->analysis_buf + s->analysis_rdft_len - s->rdft_len/2, s->rdft_len/2 * sizeof(*s->analysis_buf));
         if (s->min_phase)
             generate_min_phase_kernel(s, rdft_buf);
-        av_rdft_calc(s->rdft, rdft_buf);
+        av_rdft_calc(s->rdft[0], rdft_buf);
 
         for (k = 0; k < s->rdft_len; k++) {
             if (isnan(rdft_buf[k]) || isinf(rdft_buf[k])) {
@@ -757,7 +771,7 @@ static int config_input(AVFilterLink *inlink)
 {
     AVFilterContext *ctx = inlink->dst;
     FIREqualizerContext *s = ctx->priv;
-    int rdft_bits;
+    int rdft_bits, i;
 
     common_uninit(s);
 
@@ -779,11 +793,26 @@ static int config_input(AVFilterLink *inlink)
         return AVERROR(EINVAL);
     }
 
-    if (!(s->rdft = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft = av_rdft_init(rdft_bits, IDFT_C2R)))
+    /* the transforms use a scratch buffer, so each job needs its own */
+    s->nb_rdft = FFMIN(inlink->channels, ff_filter_get_nb_threads(ctx));
+    s->rdft  = av_calloc(s->nb_rdft, sizeof(*s->rdft));
+    s->irdft = av_calloc(s->nb_rdft, sizeof(*s->irdft));
+    if (!s->rdft || !s->irdft)
         return AVERROR(ENOMEM);
 
-    if (s->fft2 && !s->multi && inlink->channels > 1 && !(s->fft_ctx = av_fft_init(rdft_bits, 0)))
-        return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_rdft; i++) {
+        if (!(s->rdft[i] = av_rdft_init(rdft_bits, DFT_R2C)) || !(s->irdft[i] = av_rdft_init(rdft_bits, IDFT_C2R)))
+            return AVERROR(ENOMEM);
+    }
+
+    if (s->fft2 && !s->multi && inlink->channels > 1) {
+        if (!(s->fft_ctx = av_calloc(s->nb_rdft, sizeof(*s->fft_ctx))))
+            return AVERROR(ENOMEM);
+        for (i = 0; i < s->nb_rdft; i++) {
+            if (!(s->fft_ctx[i] = av_fft_init(rdft_bits, 0)))
+                return AVERROR(ENOMEM);
+        }
+    }
 
     if (s->min_phase) {
         int cepstrum_bits = rdft_bits + 2;
@@ -840,32 +869,48 @@ static int config_input(AVFilterLink *inlink)
     return generate_kernel(ctx, SELECT_GAIN(s), SELECT_GAIN_ENTRY(s));
 }
 
-static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+static int convolute_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    AVFilterContext *ctx = inlink->dst;
     FIREqualizerContext *s = ctx->priv;
-    int ch;
-
-    if (!s->min_phase) {
-        for (ch = 0; ch + 1 < inlink->channels && s->fft_ctx; ch += 2) {
-            fast_convolute2(s, s->kernel_buf, (FFTComplex *)(s->conv_buf + 2 * ch * s->rdft_len),
+    AVFrame *frame = arg;
+    const int channels = ctx->inputs[0]->channels;
+    /* in fft2 mode channel pairs share one complex fft */
+    const int nb_pairs = !s->min_phase && s->fft_ctx ? channels / 2 : 0;
+    const int nb_units = channels - nb_pairs;
+    const int start = (nb_units *  jobnr   ) / nb_jobs;
+    const int end   = (nb_units * (jobnr+1)) / nb_jobs;
+    int u, ch;
+
+    for (u = start; u < end; u++) {
+        if (u < nb_pairs) {
+            ch = 2 * u;
+            fast_convolute2(s, s->fft_ctx[jobnr], s->kernel_buf, (FFTComplex *)(s->conv_buf + 2 * ch * s->rdft_len),
                             s->conv_idx + ch, (float *) frame->extended_data[ch],
                             (float *) frame->extended_data[ch+1], frame->nb_samples);
-        }
-
-        for ( ; ch < inlink->channels; ch++) {
-            fast_convolute(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
-                        s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
-                        (float *) frame->extended_data[ch], frame->nb_samples);
-        }
-    } else {
-        for (ch = 0; ch < inlink->channels; ch++) {
-            fast_convolute_nonlinear(s, s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
+        } else if (!s->min_phase) {
+            ch = u + nb_pairs;
+            fast_convolute(s, s->rdft[jobnr], s->irdft[jobnr], s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
+                           s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
+                           (float *) frame->extended_data[ch], frame->nb_samples);
+        } else {
+            ch = u + nb_pairs;
+            fast_convolute_nonlinear(s, s->rdft[jobnr], s->irdft[jobnr], s->kernel_buf + (s->multi ? ch * s->rdft_len : 0),
                                      s->conv_buf + 2 * ch * s->rdft_len, s->conv_idx + ch,
                                      (float *) frame->extended_data[ch], frame->nb_samples);
         }
     }
 
+    return 0;
+}
+
+static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
+{
+    AVFilterContext *ctx = inlink->dst;
+    FIREqualizerContext *s = ctx->priv;
+    const int nb_units = inlink->channels - (!s->min_phase && s->fft_ctx ? inlink->channels / 2 : 0);
+
+    ctx->internal->execute(ctx, convolute_channels, frame, NULL, FFMIN(nb_units, s->nb_rdft));
+
     s->next_pts = AV_NOPTS_VALUE;
     if (frame->pts != AV_NOPTS_VALUE) {
         s->next_pts = frame->pts + av_rescale_q(frame->nb_samples, av_make_q(1, inlink->sample_rate), inlink->time_base);
@@ -977,4 +1022,5 @@ AVFilter ff_af_firequalizer = {
     .inputs             = firequalizer_inputs,
     .outputs            = firequalizer_outputs,
     .priv_class         = &firequalizer_class,
+    .flags              = AVFILTER_FLAG_SLICE_THREADS,
 };
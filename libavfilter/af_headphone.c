@@ -70,8 +70,11 @@ typedef struct HeadphoneContext {
 
     int *delay[2];
     float *data_ir[2];
-    float *temp_src[2];
+    float **temp_src;
     FFTComplex *temp_fft[2];
+    FFTComplex *temp_afft[2];
+    int nb_slices;
+    int *n_clippings;
 
     FFTContext *fft[2], *ifft[2];
     FFTComplex *data_hrtf[2];
@@ -157,44 +160,44 @@ typedef struct ThreadData {
     float **ringbuffer;
     float **temp_src;
     FFTComplex **temp_fft;
+    FFTComplex **temp_afft;
 } ThreadData;
 
+/* the input is already in the ring buffer, every job does a range of
+ * output samples of one ear */
 static int headphone_convolute(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
     HeadphoneContext *s = ctx->priv;
     ThreadData *td = arg;
     AVFrame *in = td->in, *out = td->out;
-    int offset = jobnr;
-    int *write = &td->write[jobnr];
-    const int *const delay = td->delay[jobnr];
-    const float *const ir = td->ir[jobnr];
+    const int offset = jobnr & 1;
+    const int slice = jobnr >> 1, nb_slices = nb_jobs >> 1;
+    const int start = (in->nb_samples *  slice   ) / nb_slices;
+    const int end   = (in->nb_samples * (slice+1)) / nb_slices;
+    const int *const delay = td->delay[offset];
+    const float *const ir = td->ir[offset];
     int *n_clippings = &td->n_clippings[jobnr];
-    float *ringbuffer = td->ringbuffer[jobnr];
+    float *ringbuffer = td->ringbuffer[0];
     float *temp_src = td->temp_src[jobnr];
     const int ir_len = s->ir_len;
-    const float *src = (const float *)in->data[0];
     float *dst = (float *)out->data[0];
     const int in_channels = in->channels;
     const int buffer_length = s->buffer_length;
     const uint32_t modulo = (uint32_t)buffer_length - 1;
     float *buffer[16];
-    int wr = *write;
+    int wr = (*td->write + start) & modulo;
     int read;
     int i, l;
 
-    dst += offset;
+    dst += offset + 2 * start;
     for (l = 0; l < in_channels; l++) {
         buffer[l] = ringbuffer + l * buffer_length;
     }
 
-    for (i = 0; i < in->nb_samples; i++) {
+    for (i = start; i < end; i++) {
         const float *temp_ir = ir;
 
         *dst = 0;
-        for (l = 0; l < in_channels; l++) {
-            *(buffer[l] + wr) = src[l];
-        }
-
         for (l = 0; l < in_channels; l++) {
             const float *const bptr = buffer[l];
 
@@ -209,7 +212,7 @@ static int headphone_convolute(AVFilterContext *ctx, void *arg, int jobnr, int n
             if (read + ir_len < buffer_length) {
                 memcpy(temp_src, bptr + read, ir_len * sizeof(*temp_src));
             } else {
-                int len = FFMIN(ir_len - (read % ir_len), buffer_length - read);
+                int len = buffer_length - read;
 
                 memcpy(temp_src, bptr + read, len * sizeof(*temp_src));
                 memcpy(temp_src + len, bptr, (ir_len - len) * sizeof(*temp_src));
@@ -223,12 +226,9 @@ static int headphone_convolute(AVFilterContext *ctx, void *arg, int jobnr, int n
             *n_clippings += 1;
 
         dst += 2;
-        src += in_channels;
         wr   = (wr + 1) & modulo;
     }
 
-    *write = wr;
-
     return 0;
 }
 
@@ -249,6 +249,7 @@ static int headphone_fast_convolute(AVFilterContext *ctx, void *arg, int jobnr,
     const int buffer_length = s->buffer_length;
     const uint32_t modulo = (uint32_t)buffer_length - 1;
     FFTComplex *fft_in = s->temp_fft[jobnr];
+    FFTComplex *fft_acc = s->temp_afft[jobnr];
     FFTContext *ifft = s->ifft[jobnr];
     FFTContext *fft = s->fft[jobnr];
     const int n_fft = s->n_fft;
@@ -271,6 +272,8 @@ static int headphone_fast_convolute(AVFilterContext *ctx, void *arg, int jobnr,
         dst[2 * j] = 0;
     }
 
+    memset(fft_acc, 0, sizeof(FFTComplex) * n_fft);
+
     for (i = 0; i < in_channels; i++) {
         if (i == s->lfe_channel) {
             for (j = 0; j < in->nb_samples; j++) {
@@ -295,22 +298,24 @@ static int headphone_fast_convolute(AVFilterContext *ctx, void *arg, int jobnr,
             const float re = fft_in[j].re;
             const float im = fft_in[j].im;
 
-            fft_in[j].re = re * hcomplex->re - im * hcomplex->im;
-            fft_in[j].im = re * hcomplex->im + im * hcomplex->re;
+            fft_acc[j].re += re * hcomplex->re - im * hcomplex->im;
+            fft_acc[j].im += re * hcomplex->im + im * hcomplex->re;
         }
+    }
 
-        av_fft_permute(ifft, fft_in);
-        av_fft_calc(ifft, fft_in);
+    /* the convolutions of all channels are summed in the frequency domain,
+     * which leaves a single inverse transform */
+    av_fft_permute(ifft, fft_acc);
+    av_fft_calc(ifft, fft_acc);
 
-        for (j = 0; j < in->nb_samples; j++) {
-            dst[2 * j] += fft_in[j].re * fft_scale;
-        }
+    for (j = 0; j < in->nb_samples; j++) {
+        dst[2 * j] += fft_acc[j].re * fft_scale;
+    }
 
-        for (j = 0; j < ir_len - 1; j++) {
-            int write_pos = (wr + j) & modulo;
+    for (j = 0; j < ir_len - 1; j++) {
+        int write_pos = (wr + j) & modulo;
 
-            *(ringbuffer + write_pos) += fft_in[in->nb_samples + j].re * fft_scale;
-        }
+        *(ringbuffer + write_pos) += fft_acc[in->nb_samples + j].re * fft_scale;
     }
 
     for (i = 0; i < out->nb_samples; i++) {
@@ -347,7 +352,9 @@ static int check_ir(AVFilterLink *inlink, int input_number)
 static int headphone_frame(HeadphoneContext *s, AVFrame *in, AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
-    int n_clippings[2] = { 0 };
+    const int nb_jobs = s->type == TIME_DOMAIN ? 2 * s->nb_slices : 2;
+    int *n_clippings = s->n_clippings;
+    int i, l, nb_clippings = 0;
     ThreadData td;
     AVFrame *out;
 
@@ -362,17 +369,35 @@ static int headphone_frame(HeadphoneContext *s, AVFrame *in, AVFilterLink *outli
     td.delay = s->delay; td.ir = s->data_ir; td.n_clippings = n_clippings;
     td.ringbuffer = s->ringbuffer; td.temp_src = s->temp_src;
     td.temp_fft = s->temp_fft;
+    td.temp_afft = s->temp_afft;
+
+    memset(n_clippings, 0, nb_jobs * sizeof(*n_clippings));
 
     if (s->type == TIME_DOMAIN) {
-        ctx->internal->execute(ctx, headphone_convolute, &td, NULL, 2);
+        const uint32_t modulo = (uint32_t)s->buffer_length - 1;
+        const float *src = (const float *)in->data[0];
+        int wr = s->write[0];
+
+        for (i = 0; i < in->nb_samples; i++) {
+            for (l = 0; l < in->channels; l++)
+                s->ringbuffer[0][l * s->buffer_length + wr] = src[l];
+            src += in->channels;
+            wr   = (wr + 1) & modulo;
+        }
+
+        ctx->internal->execute(ctx, headphone_convolute, &td, NULL, nb_jobs);
+        s->write[0] = wr;
     } else {
-        ctx->internal->execute(ctx, headphone_fast_convolute, &td, NULL, 2);
+        ctx->internal->execute(ctx, headphone_fast_convolute, &td, NULL, nb_jobs);
     }
     emms_c();
 
-    if (n_clippings[0] + n_clippings[1] > 0) {
+    for (i = 0; i < nb_jobs; i++)
+        nb_clippings += n_clippings[i];
+
+    if (nb_clippings > 0) {
         av_log(ctx, AV_LOG_WARNING, "%d of %d samples clipped. Please reduce gain.\n",
-               n_clippings[0] + n_clippings[1], out->nb_samples * 2);
+               nb_clippings, out->nb_samples * 2);
     }
 
     av_frame_free(&in);
@@ -398,6 +423,18 @@ static int convert_coeffs(AVFilterContext *ctx, AVFilterLink *inlink)
 
     s->buffer_length = 1 << (32 - ff_clz(s->ir_len));
     s->n_fft = n_fft = 1 << (32 - ff_clz(s->ir_len + s->size));
+    s->nb_slices = (ff_filter_get_nb_threads(ctx) + 1) / 2;
+
+    /* the time domain ring buffer must hold a whole frame on top of the
+     * history needed by the first sample */
+    if (s->type == TIME_DOMAIN)
+        s->buffer_length = 1 << (32 - ff_clz(s->ir_len + s->size - 2));
+
+    s->n_clippings = av_calloc(2 * s->nb_slices, sizeof(*s->n_clippings));
+    if (!s->n_clippings) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
 
     if (s->type == FREQUENCY_DOMAIN) {
         fft_in_l = av_calloc(n_fft, sizeof(*fft_in_l));
@@ -429,32 +466,44 @@ static int convert_coeffs(AVFilterContext *ctx, AVFilterLink *inlink)
     s->delay[1] = av_calloc(s->nb_irs, sizeof(float));
 
     if (s->type == TIME_DOMAIN) {
+        /* both ears read the same input history */
         s->ringbuffer[0] = av_calloc(s->buffer_length, sizeof(float) * nb_input_channels);
-        s->ringbuffer[1] = av_calloc(s->buffer_length, sizeof(float) * nb_input_channels);
     } else {
         s->ringbuffer[0] = av_calloc(s->buffer_length, sizeof(float));
         s->ringbuffer[1] = av_calloc(s->buffer_length, sizeof(float));
         s->temp_fft[0] = av_calloc(s->n_fft, sizeof(FFTComplex));
         s->temp_fft[1] = av_calloc(s->n_fft, sizeof(FFTComplex));
-        if (!s->temp_fft[0] || !s->temp_fft[1]) {
+        s->temp_afft[0] = av_calloc(s->n_fft, sizeof(FFTComplex));
+        s->temp_afft[1] = av_calloc(s->n_fft, sizeof(FFTComplex));
+        if (!s->temp_fft[0] || !s->temp_fft[1] ||
+            !s->temp_afft[0] || !s->temp_afft[1] || !s->ringbuffer[1]) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
     }
 
-    if (!s->data_ir[0] || !s->data_ir[1] ||
-        !s->ringbuffer[0] || !s->ringbuffer[1]) {
+    if (!s->data_ir[0] || !s->data_ir[1] || !s->ringbuffer[0]) {
         ret = AVERROR(ENOMEM);
         goto fail;
     }
 
     if (s->type == TIME_DOMAIN) {
-        s->temp_src[0] = av_calloc(FFALIGN(ir_len, 16), sizeof(float));
-        s->temp_src[1] = av_calloc(FFALIGN(ir_len, 16), sizeof(float));
+        s->temp_src = av_calloc(2 * s->nb_slices, sizeof(*s->temp_src));
+        if (!s->temp_src) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (i = 0; i < 2 * s->nb_slices; i++) {
+            s->temp_src[i] = av_calloc(FFALIGN(ir_len, 16), sizeof(float));
+            if (!s->temp_src[i]) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
 
         data_ir_l = av_calloc(nb_irs * FFALIGN(ir_len, 16), sizeof(*data_ir_l));
         data_ir_r = av_calloc(nb_irs * FFALIGN(ir_len, 16), sizeof(*data_ir_r));
-        if (!data_ir_r || !data_ir_l || !s->temp_src[0] || !s->temp_src[1]) {
+        if (!data_ir_r || !data_ir_l) {
             ret = AVERROR(ENOMEM);
             goto fail;
         }
@@ -809,10 +858,16 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->data_ir[1]);
     av_freep(&s->ringbuffer[0]);
     av_freep(&s->ringbuffer[1]);
-    av_freep(&s->temp_src[0]);
-    av_freep(&s->temp_src[1]);
+    if (s->temp_src) {
+        for (i = 0; i < 2 * s->nb_slices; i++)
+            av_freep(&s->temp_src[i]);
+    }
+    av_freep(&s->temp_src);
+    av_freep(&s->n_clippings);
     av_freep(&s->temp_fft[0]);
     av_freep(&s->temp_fft[1]);
+    av_freep(&s->temp_afft[0]);
+    av_freep(&s->temp_afft[1]);
     av_freep(&s->data_hrtf[0]);
     av_freep(&s->data_hrtf[1]);
     av_freep(&s->fdsp);
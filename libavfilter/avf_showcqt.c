@@ -755,14 +755,14 @@ static void yuv_from_cqt(ColorFloat *c, const FFTComplex *v, float gamma, int le
 }
 
 static void draw_bar_rgb(AVFrame *out, const float *h, const float *rcp_h,
-                         const ColorFloat *c, int bar_h, float bar_t)
+                         const ColorFloat *c, int bar_h, float bar_t, int start, int end)
 {
     int x, y, w = out->width;
     float mul, ht, rcp_bar_h = 1.0f / bar_h, rcp_bar_t = 1.0f / bar_t;
     uint8_t *v = out->data[0], *lp;
     int ls = out->linesize[0];
 
-    for (y = 0; y < bar_h; y++) {
+    for (y = start; y < end; y++) {
         ht = (bar_h - y) * rcp_bar_h;
         lp = v + y * ls;
         for (x = 0; x < w; x++) {
@@ -808,7 +808,7 @@ do { \
 } while (0)
 
 static void draw_bar_yuv(AVFrame *out, const float *h, const float *rcp_h,
-                         const ColorFloat *c, int bar_h, float bar_t)
+                         const ColorFloat *c, int bar_h, float bar_t, int start, int end)
 {
     int x, y, yh, w = out->width;
     float mul, ht, rcp_bar_h = 1.0f / bar_h, rcp_bar_t = 1.0f / bar_t;
@@ -817,7 +817,7 @@ static void draw_bar_yuv(AVFrame *out, const float *h, const float *rcp_h,
     int lsy = out->linesize[0], lsu = out->linesize[1], lsv = out->linesize[2];
     int fmt = out->format;
 
-    for (y = 0; y < bar_h; y += 2) {
+    for (y = start; y < end; y += 2) {
         yh = (fmt == AV_PIX_FMT_YUV420P) ? y / 2 : y;
         ht = (bar_h - y) * rcp_bar_h;
         lpy = vy + y * lsy;
@@ -858,13 +858,14 @@ static void draw_bar_yuv(AVFrame *out, const float *h, const float *rcp_h,
     }
 }
 
-static void draw_axis_rgb(AVFrame *out, AVFrame *axis, const ColorFloat *c, int off)
+static void draw_axis_rgb(AVFrame *out, AVFrame *axis, const ColorFloat *c, int off,
+                          int start, int end)
 {
-    int x, y, w = axis->width, h = axis->height;
+    int x, y, w = axis->width;
     float a, rcp_255 = 1.0f / 255.0f;
     uint8_t *lp, *lpa;
 
-    for (y = 0; y < h; y++) {
+    for (y = start; y < end; y++) {
         lp = out->data[0] + (off + y) * out->linesize[0];
         lpa = axis->data[0] + y * axis->linesize[0];
         for (x = 0; x < w; x++) {
@@ -960,9 +961,10 @@ do { \
     lpau += 2; lpav += 2; lpaa++; lpu++; lpv++; \
 } while (0)
 
-static void draw_axis_yuv(AVFrame *out, AVFrame *axis, const ColorFloat *c, int off)
+static void draw_axis_yuv(AVFrame *out, AVFrame *axis, const ColorFloat *c, int off,
+                          int start, int end)
 {
-    int fmt = out->format, x, y, yh, w = axis->width, h = axis->height;
+    int fmt = out->format, x, y, yh, w = axis->width;
     int offh = (fmt == AV_PIX_FMT_YUV420P) ? off / 2 : off;
     uint8_t *vy = out->data[0], *vu = out->data[1], *vv = out->data[2];
     uint8_t *vay = axis->data[0], *vau = axis->data[1], *vav = axis->data[2], *vaa = axis->data[3];
@@ -970,7 +972,7 @@ static void draw_axis_yuv(AVFrame *out, AVFrame *axis, const ColorFloat *c, int
     int lsay = axis->linesize[0], lsau = axis->linesize[1], lsav = axis->linesize[2], lsaa = axis->linesize[3];
     uint8_t *lpy, *lpu, *lpv, *lpay, *lpau, *lpav, *lpaa;
 
-    for (y = 0; y < h; y += 2) {
+    for (y = start; y < end; y += 2) {
         yh = (fmt == AV_PIX_FMT_YUV420P) ? y / 2 : y;
         lpy = vy + (off + y) * lsy;
         lpu = vu + (offh + yh) * lsu;
@@ -1025,7 +1027,7 @@ static void draw_axis_yuv(AVFrame *out, AVFrame *axis, const ColorFloat *c, int
     }
 }
 
-static void draw_sono(AVFrame *out, AVFrame *sono, int off, int idx)
+static void draw_sono(AVFrame *out, AVFrame *sono, int off, int idx, int start, int end)
 {
     int fmt = out->format, h = sono->height;
     int nb_planes = (fmt == AV_PIX_FMT_RGB24) ? 1 : 3;
@@ -1034,14 +1036,14 @@ static void draw_sono(AVFrame *out, AVFrame *sono, int off, int idx)
     int ls, i, y, yh;
 
     ls = FFMIN(out->linesize[0], sono->linesize[0]);
-    for (y = 0; y < h; y++) {
+    for (y = start; y < end; y++) {
         memcpy(out->data[0] + (off + y) * out->linesize[0],
                sono->data[0] + (idx + y) % h * sono->linesize[0], ls);
     }
 
     for (i = 1; i < nb_planes; i++) {
         ls = FFMIN(out->linesize[i], sono->linesize[i]);
-        for (y = 0; y < h; y += inc) {
+        for (y = start; y < end; y += inc) {
             yh = (fmt == AV_PIX_FMT_YUV420P) ? y / 2 : y;
             memcpy(out->data[i] + (offh + yh) * out->linesize[i],
                    sono->data[i] + (idx + y) % h * sono->linesize[i], ls);
@@ -1049,26 +1051,27 @@ static void draw_sono(AVFrame *out, AVFrame *sono, int off, int idx)
     }
 }
 
-static void update_sono_rgb(AVFrame *sono, const ColorFloat *c, int idx)
+static void update_sono_rgb(AVFrame *sono, const ColorFloat *c, int idx, int start, int end)
 {
-    int x, w = sono->width;
-    uint8_t *lp = sono->data[0] + idx * sono->linesize[0];
+    int x;
+    uint8_t *lp = sono->data[0] + idx * sono->linesize[0] + 3 * start;
 
-    for (x = 0; x < w; x++) {
+    for (x = start; x < end; x++) {
         *lp++ = lrintf(c[x].rgb.r);
         *lp++ = lrintf(c[x].rgb.g);
         *lp++ = lrintf(c[x].rgb.b);
     }
 }
 
-static void update_sono_yuv(AVFrame *sono, const ColorFloat *c, int idx)
+static void update_sono_yuv(AVFrame *sono, const ColorFloat *c, int idx, int start, int end)
 {
-    int x, fmt = sono->format, w = sono->width;
-    uint8_t *lpy = sono->data[0] + idx * sono->linesize[0];
-    uint8_t *lpu = sono->data[1] + idx * sono->linesize[1];
-    uint8_t *lpv = sono->data[2] + idx * sono->linesize[2];
+    int x, fmt = sono->format;
+    int cstart = (fmt == AV_PIX_FMT_YUV444P) ? start : start / 2;
+    uint8_t *lpy = sono->data[0] + idx * sono->linesize[0] + start;
+    uint8_t *lpu = sono->data[1] + idx * sono->linesize[1] + cstart;
+    uint8_t *lpv = sono->data[2] + idx * sono->linesize[2] + cstart;
 
-    for (x = 0; x < w; x += 2) {
+    for (x = start; x < end; x += 2) {
         *lpy++ = lrintf(c[x].yuv.y + 16.0f);
         *lpu++ = lrintf(c[x].yuv.u + 128.0f);
         *lpv++ = lrintf(c[x].yuv.v + 128.0f);
@@ -1119,17 +1122,80 @@ static void process_cqt(ShowCQTContext *s)
             s->cqt_result[x].im = rcp_fcount * result.im;
         }
     }
+}
+
+/* all the partitioned lengths are even, keep the slice boundaries even too,
+ * the yuv drawing functions work on pairs of rows and columns and the x86
+ * cqt_calc on pairs of bins */
+static av_always_inline int slice_pos(int len, int jobnr, int nb_jobs)
+{
+    return len / 2 * jobnr / nb_jobs * 2;
+}
+
+static int cqt_calc_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+    int start = slice_pos(s->cqt_len, jobnr, nb_jobs);
+    int end   = slice_pos(s->cqt_len, jobnr + 1, nb_jobs);
+
+    s->cqt_calc(s->cqt_result + start, s->fft_result, s->coeffs + start, end - start, s->fft_len);
+    return 0;
+}
+
+static int color_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+    int start = slice_pos(s->width, jobnr, nb_jobs);
+    int end   = slice_pos(s->width, jobnr + 1, nb_jobs);
 
     if (s->format == AV_PIX_FMT_RGB24)
-        rgb_from_cqt(s->c_buf, s->cqt_result, s->sono_g, s->width, s->cscheme_v);
+        rgb_from_cqt(s->c_buf + start, s->cqt_result + start, s->sono_g, end - start, s->cscheme_v);
     else
-        yuv_from_cqt(s->c_buf, s->cqt_result, s->sono_g, s->width, s->cmatrix, s->cscheme_v);
+        yuv_from_cqt(s->c_buf + start, s->cqt_result + start, s->sono_g, end - start, s->cmatrix, s->cscheme_v);
+    return 0;
+}
+
+static int update_sono_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+
+    s->update_sono(s->sono_frame, s->c_buf, s->sono_idx,
+                   slice_pos(s->width, jobnr, nb_jobs), slice_pos(s->width, jobnr + 1, nb_jobs));
+    return 0;
+}
+
+static int draw_bar_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+
+    s->draw_bar(arg, s->h_buf, s->rcp_h_buf, s->c_buf, s->bar_h, s->bar_t,
+                slice_pos(s->bar_h, jobnr, nb_jobs), slice_pos(s->bar_h, jobnr + 1, nb_jobs));
+    return 0;
+}
+
+static int draw_axis_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+
+    s->draw_axis(arg, s->axis_frame, s->c_buf, s->bar_h,
+                 slice_pos(s->axis_h, jobnr, nb_jobs), slice_pos(s->axis_h, jobnr + 1, nb_jobs));
+    return 0;
+}
+
+static int draw_sono_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ShowCQTContext *s = ctx->priv;
+
+    s->draw_sono(arg, s->sono_frame, s->bar_h + s->axis_h, s->sono_idx,
+                 slice_pos(s->sono_h, jobnr, nb_jobs), slice_pos(s->sono_h, jobnr + 1, nb_jobs));
+    return 0;
 }
 
 static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
 {
     AVFilterLink *outlink = ctx->outputs[0];
     ShowCQTContext *s = ctx->priv;
+    int nb_threads = ff_filter_get_nb_threads(ctx);
     int64_t last_time, cur_time;
 
 #define UPDATE_TIME(t) \
@@ -1153,14 +1219,15 @@ static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
     s->fft_result[s->fft_len] = s->fft_result[0];
     UPDATE_TIME(s->fft_time);
 
-    s->cqt_calc(s->cqt_result, s->fft_result, s->coeffs, s->cqt_len, s->fft_len);
+    ctx->internal->execute(ctx, cqt_calc_slice, NULL, NULL, FFMIN(s->cqt_len / 2, nb_threads));
     UPDATE_TIME(s->cqt_time);
 
     process_cqt(s);
+    ctx->internal->execute(ctx, color_slice, NULL, NULL, FFMIN(s->width / 2, nb_threads));
     UPDATE_TIME(s->process_cqt_time);
 
     if (s->sono_h) {
-        s->update_sono(s->sono_frame, s->c_buf, s->sono_idx);
+        ctx->internal->execute(ctx, update_sono_slice, NULL, NULL, FFMIN(s->width / 2, nb_threads));
         UPDATE_TIME(s->update_sono_time);
     }
 
@@ -1174,17 +1241,17 @@ static int plot_cqt(AVFilterContext *ctx, AVFrame **frameout)
         UPDATE_TIME(s->alloc_time);
 
         if (s->bar_h) {
-            s->draw_bar(out, s->h_buf, s->rcp_h_buf, s->c_buf, s->bar_h, s->bar_t);
+            ctx->internal->execute(ctx, draw_bar_slice, out, NULL, FFMIN(s->bar_h / 2, nb_threads));
             UPDATE_TIME(s->bar_time);
         }
 
         if (s->axis_h) {
-            s->draw_axis(out, s->axis_frame, s->c_buf, s->bar_h);
+            ctx->internal->execute(ctx, draw_axis_slice, out, NULL, FFMIN(s->axis_h / 2, nb_threads));
             UPDATE_TIME(s->axis_time);
         }
 
         if (s->sono_h) {
-            s->draw_sono(out, s->sono_frame, s->bar_h + s->axis_h, s->sono_idx);
+            ctx->internal->execute(ctx, draw_sono_slice, out, NULL, FFMIN(s->sono_h / 2, nb_threads));
             UPDATE_TIME(s->sono_time);
         }
         out->pts = s->next_pts;
@@ -1599,4 +1666,5 @@ AVFilter ff_avf_showcqt = {
     .inputs        = showcqt_inputs,
     .outputs       = showcqt_outputs,
     .priv_class    = &showcqt_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
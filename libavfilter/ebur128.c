@@ -317,6 +317,7 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
                                   size_t src_index, size_t frames,                 \
                                   int stride) {                                    \
     double* audio_data = st->d->audio_data + st->d->audio_data_index;              \
+    const double *a = st->d->a, *b = st->d->b;                                     \
     size_t i, c;                                                                   \
                                                                                    \
     if ((st->mode & FF_EBUR128_MODE_SAMPLE_PEAK) == FF_EBUR128_MODE_SAMPLE_PEAK) { \
@@ -335,30 +336,29 @@ static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,
         }                                                                          \
     }                                                                              \
     for (c = 0; c < st->channels; ++c) {                                           \
+        double v1, v2, v3, v4;                                                     \
         int ci = st->d->channel_map[c] - 1;                                        \
         if (ci < 0) continue;                                                      \
         else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
+        /* keep the filter state in registers while filtering */                  \
+        v1 = st->d->v[ci][1];                                                      \
+        v2 = st->d->v[ci][2];                                                      \
+        v3 = st->d->v[ci][3];                                                      \
+        v4 = st->d->v[ci][4];                                                      \
         for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
+            const double v0 = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
+                         - a[1] * v1 - a[2] * v2 - a[3] * v3 - a[4] * v4;          \
             audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
+                           b[0] * v0 + b[1] * v1 + b[2] * v2 + b[3] * v3 + b[4] * v4; \
+            v4 = v3;                                                               \
+            v3 = v2;                                                               \
+            v2 = v1;                                                               \
+            v1 = v0;                                                               \
         }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
+        st->d->v[ci][4] = fabs(v4) < DBL_MIN ? 0.0 : v4;                           \
+        st->d->v[ci][3] = fabs(v3) < DBL_MIN ? 0.0 : v3;                           \
+        st->d->v[ci][2] = fabs(v2) < DBL_MIN ? 0.0 : v2;                           \
+        st->d->v[ci][1] = fabs(v1) < DBL_MIN ? 0.0 : v1;                           \
     }                                                                              \
 }
 EBUR128_FILTER(short, -((double)SHRT_MIN))
@@ -78,7 +78,7 @@ struct hist_entry {
 };
 
 struct integrator {
-    double *cache[MAX_CHANNELS];    ///< window of filtered samples (N ms)
+    double *cache[MAX_CHANNELS];    ///< window of filtered samples (N ms), only allocated for the 3s integrator
     int cache_pos;                  ///< focus on the last added bin in the cache array
     double sum[MAX_CHANNELS];       ///< sum of the last N ms filtered samples (cache content)
     int filled;                     ///< 1 if the cache is completely filled, 0 otherwise
@@ -102,7 +102,9 @@ typedef struct EBUR128Context {
     SwrContext *swr_ctx;            ///< over-sampling context for true peak metering
     double *swr_buf;                ///< resampled audio data for true peak metering
     int swr_linesize;
+    int swr_nb_samples;             ///< size of swr_buf, in samples per channel
 #endif
+    int tp_factor;                  ///< true peak oversampling factor
 
     /* video  */
     int do_video;                   ///< 1 if video output enabled, 0 otherwise
@@ -124,10 +126,10 @@ typedef struct EBUR128Context {
     int sample_count;               ///< sample count used for refresh frequency, reset at refresh
 
     /* Filter caches.
-     * The mult by 3 in the following is for X[i], X[i-1] and X[i-2] */
-    double x[MAX_CHANNELS * 3];     ///< 3 input samples cache for each channel
-    double y[MAX_CHANNELS * 3];     ///< 3 pre-filter samples cache for each channel
-    double z[MAX_CHANNELS * 3];     ///< 3 RLB-filter samples cache for each channel
+     * The mult by 2 in the following is for X[i-1] and X[i-2] */
+    double x[MAX_CHANNELS * 2];     ///< 2 input samples cache for each channel
+    double y[MAX_CHANNELS * 2];     ///< 2 pre-filter samples cache for each channel
+    double z[MAX_CHANNELS * 2];     ///< 2 RLB-filter samples cache for each channel
 
 #define I400_BINS  (48000 * 4 / 10)
 #define I3000_BINS (48000 * 3)
@@ -194,6 +196,7 @@ static const AVOption ebur128_options[] = {
         { "LUFS",       "display absolute values (LUFS)",          0, AV_OPT_TYPE_CONST, {.i64 = SCALE_TYPE_ABSOLUTE}, INT_MIN, INT_MAX, V|F, "scaletype" },
         { "relative",   "display values relative to target (LU)",  0, AV_OPT_TYPE_CONST, {.i64 = SCALE_TYPE_RELATIVE}, INT_MIN, INT_MAX, V|F, "scaletype" },
         { "LU",         "display values relative to target (LU)",  0, AV_OPT_TYPE_CONST, {.i64 = SCALE_TYPE_RELATIVE}, INT_MIN, INT_MAX, V|F, "scaletype" },
+    { "tpfactor", "set the true-peak oversampling factor", OFFSET(tp_factor), AV_OPT_TYPE_INT, {.i64 = 4}, 2, 4, A|F },
     { NULL },
 };
 
@@ -432,10 +435,10 @@ static int config_audio_output(AVFilterLink *outlink)
         if (!ebur128->ch_weighting[i])
             continue;
 
-        /* bins buffer for the two integration window (400ms and 3s) */
-        ebur128->i400.cache[i]  = av_calloc(I400_BINS,  sizeof(*ebur128->i400.cache[0]));
+        /* bins buffer for the 3s integration window, which also holds the
+         * 400ms one */
         ebur128->i3000.cache[i] = av_calloc(I3000_BINS, sizeof(*ebur128->i3000.cache[0]));
-        if (!ebur128->i400.cache[i] || !ebur128->i3000.cache[i])
+        if (!ebur128->i3000.cache[i])
             return AVERROR(ENOMEM);
     }
 
@@ -443,7 +446,8 @@ static int config_audio_output(AVFilterLink *outlink)
     if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
         int ret;
 
-        ebur128->swr_buf    = av_malloc_array(nb_channels, 19200 * sizeof(double));
+        ebur128->swr_nb_samples = outlink->sample_rate / 10 * ebur128->tp_factor;
+        ebur128->swr_buf    = av_malloc_array(nb_channels, ebur128->swr_nb_samples * sizeof(double));
         ebur128->true_peaks = av_calloc(nb_channels, sizeof(*ebur128->true_peaks));
         ebur128->true_peaks_per_frame = av_calloc(nb_channels, sizeof(*ebur128->true_peaks_per_frame));
         ebur128->swr_ctx    = swr_alloc();
@@ -456,7 +460,7 @@ static int config_audio_output(AVFilterLink *outlink)
         av_opt_set_sample_fmt(ebur128->swr_ctx, "in_sample_fmt", outlink->format, 0);
 
         av_opt_set_int(ebur128->swr_ctx, "out_channel_layout",    outlink->channel_layout, 0);
-        av_opt_set_int(ebur128->swr_ctx, "out_sample_rate",       192000, 0);
+        av_opt_set_int(ebur128->swr_ctx, "out_sample_rate",       outlink->sample_rate * ebur128->tp_factor, 0);
         av_opt_set_sample_fmt(ebur128->swr_ctx, "out_sample_fmt", outlink->format, 0);
 
         ret = swr_init(ebur128->swr_ctx);
@@ -585,6 +589,86 @@ static int gate_update(struct integrator *integ, double power,
     return gate_hist_pos;
 }
 
+typedef struct ThreadData {
+    const double *samples;
+    int nb_samples;
+} ThreadData;
+
+static int filter_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    EBUR128Context *ebur128 = ctx->priv;
+    ThreadData *td = arg;
+    const int nb_channels = ebur128->nb_channels;
+    const int nb_samples  = td->nb_samples;
+    const int start = (nb_channels *  jobnr   ) / nb_jobs;
+    const int end   = (nb_channels * (jobnr+1)) / nb_jobs;
+    int ch, i;
+
+    for (ch = start; ch < end; ch++) {
+        const double *src = td->samples + ch;
+        double *cache = ebur128->i3000.cache[ch];
+        int bin_id_3000 = ebur128->i3000.cache_pos;
+        /* the 400ms window is the end of the 3s one, so the bin leaving it
+         * is read back from the 3s cache */
+        int bin_id_400  = bin_id_3000 >= I400_BINS ? bin_id_3000 - I400_BINS
+                                                   : bin_id_3000 - I400_BINS + I3000_BINS;
+        double sum_400, sum_3000;
+        double x1, x2, y1, y2, z1, z2;
+
+        if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS) {
+            double peak = ebur128->sample_peaks[ch];
+
+            for (i = 0; i < nb_samples; i++)
+                peak = FFMAX(peak, fabs(src[i * nb_channels]));
+            ebur128->sample_peaks[ch] = peak;
+        }
+
+        if (!ebur128->ch_weighting[ch])
+            continue;
+
+        /* keep the filter states and the sums in registers while filtering */
+        x1 = ebur128->x[ch * 2]; x2 = ebur128->x[ch * 2 + 1];
+        y1 = ebur128->y[ch * 2]; y2 = ebur128->y[ch * 2 + 1];
+        z1 = ebur128->z[ch * 2]; z2 = ebur128->z[ch * 2 + 1];
+        sum_400  = ebur128->i400.sum [ch];
+        sum_3000 = ebur128->i3000.sum[ch];
+
+        for (i = 0; i < nb_samples; i++) {
+            const double x0 = src[i * nb_channels];
+            double y0, z0, bin;
+
+            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
+            y0 = x0*PRE_B0 + x1*PRE_B1 + x2*PRE_B2 - y1*PRE_A1 - y2*PRE_A2; // apply pre-filter
+            z0 = y0*RLB_B0 + y1*RLB_B1 + y2*RLB_B2 - z1*RLB_A1 - z2*RLB_A2; // apply RLB-filter
+            x2 = x1; x1 = x0;
+            y2 = y1; y1 = y0;
+            z2 = z1; z1 = z0;
+
+            bin = z0 * z0;
+
+            /* add the new value, and limit the sum to the cache size (400ms or 3s)
+             * by removing the oldest one */
+            sum_400  = sum_400  + bin - cache[bin_id_400];
+            sum_3000 = sum_3000 + bin - cache[bin_id_3000];
+
+            /* override old cache entry with the new value */
+            cache[bin_id_3000] = bin;
+            if (++bin_id_400  == I3000_BINS)
+                bin_id_400  = 0;
+            if (++bin_id_3000 == I3000_BINS)
+                bin_id_3000 = 0;
+        }
+
+        ebur128->x[ch * 2] = x1; ebur128->x[ch * 2 + 1] = x2;
+        ebur128->y[ch * 2] = y1; ebur128->y[ch * 2 + 1] = y2;
+        ebur128->z[ch * 2] = z1; ebur128->z[ch * 2 + 1] = z2;
+        ebur128->i400.sum [ch] = sum_400;
+        ebur128->i3000.sum[ch] = sum_3000;
+    }
+
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 {
     int i, ch, idx_insample;
@@ -598,86 +682,55 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 #if CONFIG_SWRESAMPLE
     if (ebur128->peak_mode & PEAK_MODE_TRUE_PEAKS) {
         const double *swr_samples = ebur128->swr_buf;
-        int ret = swr_convert(ebur128->swr_ctx, (uint8_t**)&ebur128->swr_buf, 19200,
+        int ret = swr_convert(ebur128->swr_ctx, (uint8_t**)&ebur128->swr_buf, ebur128->swr_nb_samples,
                               (const uint8_t **)insamples->data, nb_samples);
         if (ret < 0)
             return ret;
-        for (ch = 0; ch < nb_channels; ch++)
-            ebur128->true_peaks_per_frame[ch] = 0.0;
-        for (idx_insample = 0; idx_insample < ret; idx_insample++) {
-            for (ch = 0; ch < nb_channels; ch++) {
-                ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], fabs(*swr_samples));
-                ebur128->true_peaks_per_frame[ch] = FFMAX(ebur128->true_peaks_per_frame[ch],
-                                                          fabs(*swr_samples));
-                swr_samples++;
-            }
+        for (ch = 0; ch < nb_channels; ch++) {
+            double peak = 0.0;
+
+            for (idx_insample = 0; idx_insample < ret; idx_insample++)
+                peak = FFMAX(peak, fabs(swr_samples[idx_insample * nb_channels + ch]));
+            ebur128->true_peaks_per_frame[ch] = peak;
+            ebur128->true_peaks[ch] = FFMAX(ebur128->true_peaks[ch], peak);
         }
     }
 #endif
 
-    for (idx_insample = 0; idx_insample < nb_samples; idx_insample++) {
-        const int bin_id_400  = ebur128->i400.cache_pos;
-        const int bin_id_3000 = ebur128->i3000.cache_pos;
+    idx_insample = 0;
+    while (idx_insample < nb_samples) {
+        ThreadData td;
+
+        /* filter up to the next 100ms boundary, where the loudness has to be
+         * computed from the sums of the filtered samples */
+        td.samples    = samples + idx_insample * nb_channels;
+        td.nb_samples = FFMIN(nb_samples - idx_insample, 4800 - ebur128->sample_count);
+        ctx->internal->execute(ctx, filter_channels, &td, NULL,
+                               FFMIN(nb_channels, ff_filter_get_nb_threads(ctx)));
 
 #define MOVE_TO_NEXT_CACHED_ENTRY(time) do {                \
-    ebur128->i##time.cache_pos++;                           \
-    if (ebur128->i##time.cache_pos == I##time##_BINS) {     \
-        ebur128->i##time.filled    = 1;                     \
-        ebur128->i##time.cache_pos = 0;                     \
+    ebur128->i##time.cache_pos += td.nb_samples;            \
+    if (ebur128->i##time.cache_pos >= I##time##_BINS) {     \
+        ebur128->i##time.filled     = 1;                    \
+        ebur128->i##time.cache_pos -= I##time##_BINS;       \
     }                                                       \
 } while (0)
 
         MOVE_TO_NEXT_CACHED_ENTRY(400);
         MOVE_TO_NEXT_CACHED_ENTRY(3000);
 
-        for (ch = 0; ch < nb_channels; ch++) {
-            double bin;
-
-            if (ebur128->peak_mode & PEAK_MODE_SAMPLES_PEAKS)
-                ebur128->sample_peaks[ch] = FFMAX(ebur128->sample_peaks[ch], fabs(*samples));
-
-            ebur128->x[ch * 3] = *samples++; // set X[i]
-
-            if (!ebur128->ch_weighting[ch])
-                continue;
-
-            /* Y[i] = X[i]*b0 + X[i-1]*b1 + X[i-2]*b2 - Y[i-1]*a1 - Y[i-2]*a2 */
-#define FILTER(Y, X, name) do {                                                 \
-            double *dst = ebur128->Y + ch*3;                                    \
-            double *src = ebur128->X + ch*3;                                    \
-            dst[2] = dst[1];                                                    \
-            dst[1] = dst[0];                                                    \
-            dst[0] = src[0]*name##_B0 + src[1]*name##_B1 + src[2]*name##_B2     \
-                                      - dst[1]*name##_A1 - dst[2]*name##_A2;    \
-} while (0)
-
-            // TODO: merge both filters in one?
-            FILTER(y, x, PRE);  // apply pre-filter
-            ebur128->x[ch * 3 + 2] = ebur128->x[ch * 3 + 1];
-            ebur128->x[ch * 3 + 1] = ebur128->x[ch * 3    ];
-            FILTER(z, y, RLB);  // apply RLB-filter
-
-            bin = ebur128->z[ch * 3] * ebur128->z[ch * 3];
-
-            /* add the new value, and limit the sum to the cache size (400ms or 3s)
-             * by removing the oldest one */
-            ebur128->i400.sum [ch] = ebur128->i400.sum [ch] + bin - ebur128->i400.cache [ch][bin_id_400];
-            ebur128->i3000.sum[ch] = ebur128->i3000.sum[ch] + bin - ebur128->i3000.cache[ch][bin_id_3000];
-
-            /* override old cache entry with the new value */
-            ebur128->i400.cache [ch][bin_id_400 ] = bin;
-            ebur128->i3000.cache[ch][bin_id_3000] = bin;
-        }
+        idx_insample          += td.nb_samples;
+        ebur128->sample_count += td.nb_samples;
 
         /* For integrated loudness, gating blocks are 400ms long with 75%
          * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
          * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == 4800) {
+        if (ebur128->sample_count == 4800) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
             const int64_t pts = insamples->pts +
-                av_rescale_q(idx_insample, (AVRational){ 1, inlink->sample_rate },
+                av_rescale_q(idx_insample - 1, (AVRational){ 1, inlink->sample_rate },
                              outlink->time_base);
 
             ebur128->sample_count = 0;
@@ -982,10 +1035,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&ebur128->true_peaks_per_frame);
     av_freep(&ebur128->i400.histogram);
     av_freep(&ebur128->i3000.histogram);
-    for (i = 0; i < ebur128->nb_channels; i++) {
-        av_freep(&ebur128->i400.cache[i]);
+    for (i = 0; i < ebur128->nb_channels; i++)
         av_freep(&ebur128->i3000.cache[i]);
-    }
     for (i = 0; i < ctx->nb_outputs; i++)
         av_freep(&ctx->output_pads[i].name);
     av_frame_free(&ebur128->outpicref);
@@ -1015,5 +1066,5 @@ AVFilter ff_af_ebur128 = {
     .inputs        = ebur128_inputs,
     .outputs       = NULL,
     .priv_class    = &ebur128_class,
-    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -148,7 +148,12 @@ typedef struct DrawTextContext {
     AVBPrint expanded_fontcolor;    ///< used to contain the expanded fontcolor spec
     int ft_load_flags;              ///< flags used for loading fonts, see FT_LOAD_*
     FT_Vector *positions;           ///< positions for each element in the text
-    size_t nb_positions;            ///< number of elements of positions array
+    struct Glyph **glyph_run;       ///< glyph for each element in the text
+    size_t nb_positions;            ///< number of elements of positions and glyph_run arrays
+    char *layout_text;              ///< expanded text positions were computed for
+    unsigned int layout_fontsize;   ///< font size positions were computed for
+    int text_w, text_h;             ///< size of the laid out text
+    int text_ascent, text_descent;  ///< max glyph ascent and descent of the laid out text
     char *textfile;                 ///< file with text to be drawn
     int x;                          ///< x position to start drawing text
     int y;                          ///< y position to start drawing text
@@ -805,6 +810,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     s->x_pexpr = s->y_pexpr = s->a_pexpr = s->fontsize_pexpr = NULL;
 
     av_freep(&s->positions);
+    av_freep(&s->glyph_run);
+    av_freep(&s->layout_text);
     s->nb_positions = 0;
 
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
@@ -1174,7 +1181,18 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
+typedef struct ThreadData {
+    AVFrame *frame;
+    int width, height;
+    int y_start, y_end;             ///< lines covered by the box and glyphs
+    int box_w, box_h;
+    FFDrawColor fontcolor;
+    FFDrawColor shadowcolor;
+    FFDrawColor bordercolor;
+    FFDrawColor boxcolor;
+} ThreadData;
+
+static int draw_glyphs(DrawTextContext *s, uint8_t *dst[4], int dst_linesize[4],
                        int width, int height,
                        FFDrawColor *color,
                        int x, int y, int borderw)
@@ -1187,16 +1205,13 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
 
     for (i = 0, p = text; *p; i++) {
         FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
         GET_UTF8(code, *p++, continue;);
 
         /* skip new line chars, just go to new line */
         if (code == '\n' || code == '\r' || code == '\t')
             continue;
 
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        glyph = s->glyph_run[i];
 
         bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
 
@@ -1208,7 +1223,7 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
         y1 = s->positions[i].y+s->y+y - borderw;
 
         ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
+                      dst, dst_linesize, width, height,
                       bitmap.buffer, bitmap.pitch,
                       bitmap.width, bitmap.rows,
                       bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
@@ -1218,6 +1233,190 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
     return 0;
 }
 
+/**
+ * Blend the box and the glyphs on a band of lines aligned to the chroma
+ * subsampling. Every pixel is blended in the same order as when the whole
+ * frame is processed at once.
+ */
+static int draw_text_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    const int vsub = s->dc.vsub_max;
+    const int units = AV_CEIL_RSHIFT(td->y_end - td->y_start, vsub);
+    const int slice_start = td->y_start + ((units *  jobnr     ) / nb_jobs << vsub);
+    const int slice_end   = FFMIN(td->y_end, td->y_start + ((units * (jobnr + 1)) / nb_jobs << vsub));
+    const int slice_h = slice_end - slice_start;
+    uint8_t *dst[4];
+    unsigned plane;
+    int ret;
+
+    if (slice_h <= 0)
+        return 0;
+
+    for (plane = 0; plane < s->dc.nb_planes; plane++)
+        dst[plane] = frame->data[plane] + (slice_start >> s->dc.vsub[plane]) * frame->linesize[plane];
+
+    /* draw box */
+    if (s->draw_box)
+        ff_blend_rectangle(&s->dc, &td->boxcolor,
+                           dst, frame->linesize, td->width, slice_h,
+                           s->x - s->boxborderw, s->y - s->boxborderw - slice_start,
+                           td->box_w + s->boxborderw * 2, td->box_h + s->boxborderw * 2);
+
+    if (s->shadowx || s->shadowy) {
+        if ((ret = draw_glyphs(s, dst, frame->linesize, td->width, slice_h,
+                               &td->shadowcolor, s->shadowx, s->shadowy - slice_start, 0)) < 0)
+            return ret;
+    }
+
+    if (s->borderw) {
+        if ((ret = draw_glyphs(s, dst, frame->linesize, td->width, slice_h,
+                               &td->bordercolor, 0, -slice_start, s->borderw)) < 0)
+            return ret;
+    }
+    if ((ret = draw_glyphs(s, dst, frame->linesize, td->width, slice_h,
+                           &td->fontcolor, 0, -slice_start, 0)) < 0)
+        return ret;
+
+    return 0;
+}
+
+/**
+ * Compute and save the position of each glyph of the expanded text, loading
+ * the glyphs which are not cached yet.
+ */
+static int update_layout(AVFilterContext *ctx)
+{
+    DrawTextContext *s = ctx->priv;
+    char *text = s->expanded_text.str;
+    uint32_t code = 0, prev_code = 0;
+    int x = 0, y = 0, i = 0, ret;
+    int max_text_line_w = 0;
+    uint8_t *p;
+    int y_min = 32000, y_max = -32000;
+    int x_min = 32000, x_max = -32000;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
+    Glyph dummy = { 0 };
+
+    /* load and cache glyphs */
+    for (i = 0, p = text; *p; i++) {
+        GET_UTF8(code, *p++, continue;);
+
+        /* get glyph */
+        dummy.code = code;
+        dummy.fontsize = s->fontsize;
+        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        if (!glyph) {
+            ret = load_glyph(ctx, &glyph, code);
+            if (ret < 0)
+                return ret;
+        }
+        s->glyph_run[i] = glyph;
+
+        y_min = FFMIN(glyph->bbox.yMin, y_min);
+        y_max = FFMAX(glyph->bbox.yMax, y_max);
+        x_min = FFMIN(glyph->bbox.xMin, x_min);
+        x_max = FFMAX(glyph->bbox.xMax, x_max);
+    }
+    s->max_glyph_h = y_max - y_min;
+    s->max_glyph_w = x_max - x_min;
+
+    /* compute and save position for each glyph */
+    glyph = NULL;
+    for (i = 0, p = text; *p; i++) {
+        GET_UTF8(code, *p++, continue;);
+
+        /* skip the \n in the sequence \r\n */
+        if (prev_code == '\r' && code == '\n')
+            continue;
+
+        prev_code = code;
+        if (is_newline(code)) {
+
+            max_text_line_w = FFMAX(max_text_line_w, x);
+            y += s->max_glyph_h + s->line_spacing;
+            x = 0;
+            continue;
+        }
+
+        /* get glyph */
+        prev_glyph = glyph;
+        glyph = s->glyph_run[i];
+
+        /* kerning */
+        if (s->use_kerning && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
+
+        /* save position */
+        s->positions[i].x = x + glyph->bitmap_left;
+        s->positions[i].y = y - glyph->bitmap_top + y_max;
+        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
+        else              x += glyph->advance;
+    }
+
+    max_text_line_w = FFMAX(x, max_text_line_w);
+
+    s->text_w       = max_text_line_w;
+    s->text_h       = y + s->max_glyph_h;
+    s->text_ascent  = y_max;
+    s->text_descent = y_min;
+
+    av_free(s->layout_text);
+    if (!(s->layout_text = av_strdup(text)))
+        return AVERROR(ENOMEM);
+    s->layout_fontsize = s->fontsize;
+
+    return 0;
+}
+
+/**
+ * Compute the range of lines touched by the box and the glyphs of all layers.
+ */
+static void text_extent(DrawTextContext *s, ThreadData *td)
+{
+    char *text = s->expanded_text.str;
+    uint32_t code = 0;
+    int i, y_start = INT_MAX, y_end = INT_MIN;
+    uint8_t *p;
+
+    if (s->draw_box) {
+        y_start = s->y - s->boxborderw;
+        y_end   = y_start + td->box_h + s->boxborderw * 2;
+    }
+
+    for (i = 0, p = text; *p; i++) {
+        const Glyph *glyph;
+        int y1;
+        GET_UTF8(code, *p++, continue;);
+
+        if (code == '\n' || code == '\r' || code == '\t')
+            continue;
+
+        glyph = s->glyph_run[i];
+        y1 = s->positions[i].y + s->y;
+        y_start = FFMIN(y_start, y1);
+        y_end   = FFMAX(y_end,   y1 + (int)glyph->bitmap.rows);
+        if (s->shadowx || s->shadowy) {
+            y_start = FFMIN(y_start, y1 + s->shadowy);
+            y_end   = FFMAX(y_end,   y1 + s->shadowy + (int)glyph->bitmap.rows);
+        }
+        if (s->borderw) {
+            y_start = FFMIN(y_start, y1 - s->borderw);
+            y_end   = FFMAX(y_end,   y1 - s->borderw + (int)glyph->border_bitmap.rows);
+        }
+    }
+
+    /* align to the chroma subsampling, so that no chroma line is split */
+    y_start = FFMAX(y_start, 0) >> s->dc.vsub_max << s->dc.vsub_max;
+    td->y_start = y_start;
+    td->y_end   = FFMIN(y_end, td->height);
+}
 
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
@@ -1247,27 +1446,14 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     DrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
 
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
-    int max_text_line_w = 0, len;
-    int box_w, box_h;
+    int ret, len;
     char *text;
-    uint8_t *p;
-    int y_min = 32000, y_max = -32000;
-    int x_min = 32000, x_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
+    ThreadData td;
 
     time_t now = time(0);
     struct tm ltime;
     AVBPrint *bp = &s->expanded_text;
 
-    FFDrawColor fontcolor;
-    FFDrawColor shadowcolor;
-    FFDrawColor bordercolor;
-    FFDrawColor boxcolor;
-
     av_bprint_clear(bp);
 
     if(s->basetime != AV_NOPTS_VALUE)
@@ -1299,7 +1485,9 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     text = s->expanded_text.str;
     if ((len = s->expanded_text.len) > s->nb_positions) {
         if (!(s->positions =
-              av_realloc(s->positions, len*sizeof(*s->positions))))
+              av_realloc(s->positions, len*sizeof(*s->positions))) ||
+            !(s->glyph_run =
+              av_realloc(s->glyph_run, len*sizeof(*s->glyph_run))))
             return AVERROR(ENOMEM);
         s->nb_positions = len;
     }
@@ -1318,81 +1506,24 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         ff_draw_color(&s->dc, &s->fontcolor, s->fontcolor.rgba);
     }
 
-    x = 0;
-    y = 0;
-
     if ((ret = update_fontsize(ctx)) < 0)
         return ret;
 
-    /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
-
-        /* get glyph */
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph) {
-            ret = load_glyph(ctx, &glyph, code);
-            if (ret < 0)
-                return ret;
-        }
-
-        y_min = FFMIN(glyph->bbox.yMin, y_min);
-        y_max = FFMAX(glyph->bbox.yMax, y_max);
-        x_min = FFMIN(glyph->bbox.xMin, x_min);
-        x_max = FFMAX(glyph->bbox.xMax, x_max);
-    }
-    s->max_glyph_h = y_max - y_min;
-    s->max_glyph_w = x_max - x_min;
-
-    /* compute and save position for each glyph */
-    glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p++, continue;);
-
-        /* skip the \n in the sequence \r\n */
-        if (prev_code == '\r' && code == '\n')
-            continue;
-
-        prev_code = code;
-        if (is_newline(code)) {
-
-            max_text_line_w = FFMAX(max_text_line_w, x);
-            y += s->max_glyph_h + s->line_spacing;
-            x = 0;
-            continue;
-        }
-
-        /* get glyph */
-        prev_glyph = glyph;
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        /* kerning */
-        if (s->use_kerning && prev_glyph && glyph->code) {
-            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
-                           ft_kerning_default, &delta);
-            x += delta.x >> 6;
-        }
-
-        /* save position */
-        s->positions[i].x = x + glyph->bitmap_left;
-        s->positions[i].y = y - glyph->bitmap_top + y_max;
-        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
-        else              x += glyph->advance;
+    /* the layout only depends on the text and the font size, so it is
+     * reused as long as none of them changes */
+    if (!s->layout_text || s->layout_fontsize != s->fontsize ||
+        strcmp(s->layout_text, text)) {
+        if ((ret = update_layout(ctx)) < 0)
+            return ret;
     }
 
-    max_text_line_w = FFMAX(x, max_text_line_w);
-
-    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
-    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
+    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = s->text_w;
+    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = s->text_h;
 
     s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
     s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
-    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
-    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
+    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = s->text_ascent;
+    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = s->text_descent;
 
     s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
@@ -1402,13 +1533,13 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
 
     update_alpha(s);
-    update_color_with_alpha(s, &fontcolor  , s->fontcolor  );
-    update_color_with_alpha(s, &shadowcolor, s->shadowcolor);
-    update_color_with_alpha(s, &bordercolor, s->bordercolor);
-    update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
+    update_color_with_alpha(s, &td.fontcolor  , s->fontcolor  );
+    update_color_with_alpha(s, &td.shadowcolor, s->shadowcolor);
+    update_color_with_alpha(s, &td.bordercolor, s->bordercolor);
+    update_color_with_alpha(s, &td.boxcolor   , s->boxcolor   );
 
-    box_w = max_text_line_w;
-    box_h = y + s->max_glyph_h;
+    td.box_w = s->text_w;
+    td.box_h = s->text_h;
 
     if (s->fix_bounds) {
 
@@ -1430,35 +1561,22 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         if (s->x - offsetleft < 0) s->x = offsetleft;
         if (s->y - offsettop < 0)  s->y = offsettop;
 
-        if (s->x + box_w + offsetright > width)
-            s->x = FFMAX(width - box_w - offsetright, 0);
-        if (s->y + box_h + offsetbottom > height)
-            s->y = FFMAX(height - box_h - offsetbottom, 0);
+        if (s->x + td.box_w + offsetright > width)
+            s->x = FFMAX(width - td.box_w - offsetright, 0);
+        if (s->y + td.box_h + offsetbottom > height)
+            s->y = FFMAX(height - td.box_h - offsetbottom, 0);
     }
 
-    /* draw box */
-    if (s->draw_box)
-        ff_blend_rectangle(&s->dc, &boxcolor,
-                           frame->data, frame->linesize, width, height,
-                           s->x - s->boxborderw, s->y - s->boxborderw,
-                           box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
-
-    if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
-    }
-
-    if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
-    }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    td.frame  = frame;
+    td.width  = width;
+    td.height = height;
+    text_extent(s, &td);
+    if (td.y_end <= td.y_start)
+        return 0;
 
-    return 0;
+    return ctx->internal->execute(ctx, draw_text_slice, &td, NULL,
+                                  FFMIN(AV_CEIL_RSHIFT(td.y_end - td.y_start, s->dc.vsub_max),
+                                        ff_filter_get_nb_threads(ctx)));
 }
 
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
@@ -1529,5 +1647,5 @@ AVFilter ff_vf_drawtext = {
     .inputs        = avfilter_vf_drawtext_inputs,
     .outputs       = avfilter_vf_drawtext_outputs,
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -120,8 +120,152 @@ static void denoise_spatial(HQDN3DContext *s,
     }
 }
 
+typedef struct ThreadData {
+    uint8_t *src, *dst;
+    uint16_t *line_ant, *frame_ant;
+    int w, h, sstride, dstride;
+    int16_t *spatial, *temporal;
+} ThreadData;
+
+/* The spatial filter is recursive along both axes, so the threaded path
+ * splits it in two passes: the horizontal recursion on row slices, which
+ * stores its result in s->hbuf, then the vertical and temporal recursions
+ * on column bands, where each column only depends on itself. */
+static int band_start(int w, int band, int nb_bands)
+{
+    return band >= nb_bands ? w : (w * band / nb_bands) & ~15;
+}
+
+av_always_inline
+static int denoise_temporal_slice(AVFilterContext *ctx, void *arg,
+                                  int jobnr, int nb_jobs, int depth)
+{
+    ThreadData *td = arg;
+    const int slice_start = (td->h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->h * (jobnr + 1)) / nb_jobs;
+
+    denoise_temporal(td->src + slice_start * td->sstride,
+                     td->dst + slice_start * td->dstride,
+                     td->frame_ant + slice_start * td->w,
+                     td->w, slice_end - slice_start, td->sstride, td->dstride,
+                     td->temporal, depth);
+    return 0;
+}
+
+av_always_inline
+static int denoise_horizontal_slice(AVFilterContext *ctx, void *arg,
+                                    int jobnr, int nb_jobs, int depth)
+{
+    HQDN3DContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int16_t *spatial = td->spatial + (256 << LUT_BITS);
+    const int slice_start = (td->h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->h * (jobnr + 1)) / nb_jobs;
+    uint32_t pixel_ant0, pixel_ant1;
+    long x, y = slice_start;
+
+    /* First line has no top neighbor, its first pixel is filtered too. */
+    if (!y) {
+        const uint8_t *src = td->src;
+        uint16_t *hbuf = s->hbuf;
+
+        pixel_ant0 = LOAD(0);
+        for (x = 0; x < td->w; x++)
+            hbuf[x] = pixel_ant0 = lowpass(pixel_ant0, LOAD(x), spatial, depth);
+        y++;
+    }
+
+    /* Two lines at a time to interleave their dependency chains. */
+    for (; y < slice_end - 1; y += 2) {
+        const uint8_t *src0 = td->src + y * td->sstride, *src;
+        const uint8_t *src1 = src0 + td->sstride;
+        uint16_t *hbuf0 = s->hbuf + y * td->w;
+        uint16_t *hbuf1 = hbuf0 + td->w;
+
+        src = src0; pixel_ant0 = LOAD(0);
+        src = src1; pixel_ant1 = LOAD(0);
+        hbuf0[0] = pixel_ant0;
+        hbuf1[0] = pixel_ant1;
+        for (x = 1; x < td->w; x++) {
+            src = src0; hbuf0[x] = pixel_ant0 = lowpass(pixel_ant0, LOAD(x), spatial, depth);
+            src = src1; hbuf1[x] = pixel_ant1 = lowpass(pixel_ant1, LOAD(x), spatial, depth);
+        }
+    }
+    if (y < slice_end) {
+        const uint8_t *src = td->src + y * td->sstride;
+        uint16_t *hbuf = s->hbuf + y * td->w;
+
+        hbuf[0] = pixel_ant0 = LOAD(0);
+        for (x = 1; x < td->w; x++)
+            hbuf[x] = pixel_ant0 = lowpass(pixel_ant0, LOAD(x), spatial, depth);
+    }
+    return 0;
+}
+
+av_always_inline
+static int denoise_vertical_slice(AVFilterContext *ctx, void *arg,
+                                  int jobnr, int nb_jobs, int depth)
+{
+    HQDN3DContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int16_t *spatial  = td->spatial  + (256 << LUT_BITS);
+    int16_t *temporal = td->temporal + (256 << LUT_BITS);
+    uint16_t *line_ant = td->line_ant;
+    const int x0 = band_start(td->w, jobnr,     nb_jobs);
+    const int x1 = band_start(td->w, jobnr + 1, nb_jobs);
+    uint32_t tmp;
+    long x, y;
+
+    for (y = 0; y < td->h; y++) {
+        const uint16_t *hbuf = s->hbuf + y * td->w;
+        uint16_t *frame_ant = td->frame_ant + y * td->w;
+        uint8_t *dst = td->dst + y * td->dstride;
+
+        if (!y) {
+            for (x = x0; x < x1; x++) {
+                line_ant[x] = tmp = hbuf[x];
+                frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+                STORE(x, tmp);
+            }
+            continue;
+        }
+        for (x = x0; x < x1; x++) {
+            line_ant[x] = tmp = lowpass(line_ant[x], hbuf[x], spatial, depth);
+            frame_ant[x] = tmp = lowpass(frame_ant[x], tmp, temporal, depth);
+            STORE(x, tmp);
+        }
+    }
+    return 0;
+}
+
+#define DEFINE_SLICE_FUNCS(depth)                                               \
+static int denoise_temporal_slice_##depth(AVFilterContext *ctx, void *arg,      \
+                                          int jobnr, int nb_jobs)               \
+{                                                                               \
+    return denoise_temporal_slice(ctx, arg, jobnr, nb_jobs, depth);             \
+}                                                                               \
+static int denoise_horizontal_slice_##depth(AVFilterContext *ctx, void *arg,    \
+                                            int jobnr, int nb_jobs)             \
+{                                                                               \
+    return denoise_horizontal_slice(ctx, arg, jobnr, nb_jobs, depth);           \
+}                                                                               \
+static int denoise_vertical_slice_##depth(AVFilterContext *ctx, void *arg,      \
+                                          int jobnr, int nb_jobs)               \
+{                                                                               \
+    return denoise_vertical_slice(ctx, arg, jobnr, nb_jobs, depth);             \
+}
+
+DEFINE_SLICE_FUNCS(8)
+DEFINE_SLICE_FUNCS(9)
+DEFINE_SLICE_FUNCS(10)
+DEFINE_SLICE_FUNCS(16)
+
+#define SLICE_FUNC(name) (depth ==  8 ? name##_8  : \
+                          depth ==  9 ? name##_9  : \
+                          depth == 10 ? name##_10 : name##_16)
+
 av_always_inline
-static int denoise_depth(HQDN3DContext *s,
+static int denoise_depth(AVFilterContext *ctx,
                          uint8_t *src, uint8_t *dst,
                          uint16_t *line_ant, uint16_t **frame_ant_ptr,
                          int w, int h, int sstride, int dstride,
@@ -129,6 +273,8 @@ static int denoise_depth(HQDN3DContext *s,
 {
     // FIXME: For 16-bit depth, frame_ant could be a pointer to the previous
     // filtered frame rather than a separate buffer.
+    HQDN3DContext *s = ctx->priv;
+    ThreadData td;
     long x, y;
     uint16_t *frame_ant = *frame_ant_ptr;
     if (!frame_ant) {
@@ -143,12 +289,29 @@ static int denoise_depth(HQDN3DContext *s,
         frame_ant = *frame_ant_ptr;
     }
 
-    if (spatial[0])
+    td.src       = src;
+    td.dst       = dst;
+    td.line_ant  = line_ant;
+    td.frame_ant = frame_ant;
+    td.w         = w;
+    td.h         = h;
+    td.sstride   = sstride;
+    td.dstride   = dstride;
+    td.spatial   = spatial;
+    td.temporal  = temporal;
+
+    if (spatial[0] && s->nb_bands > 1) {
+        ctx->internal->execute(ctx, SLICE_FUNC(denoise_horizontal_slice), &td, NULL,
+                               FFMIN(h, s->nb_bands));
+        ctx->internal->execute(ctx, SLICE_FUNC(denoise_vertical_slice), &td, NULL,
+                               s->nb_bands);
+    } else if (spatial[0]) {
         denoise_spatial(s, src, dst, line_ant, frame_ant,
                         w, h, sstride, dstride, spatial, temporal, depth);
-    else
-        denoise_temporal(src, dst, frame_ant,
-                         w, h, sstride, dstride, temporal, depth);
+    } else {
+        ctx->internal->execute(ctx, SLICE_FUNC(denoise_temporal_slice), &td, NULL,
+                               FFMIN(h, ff_filter_get_nb_threads(ctx)));
+    }
     emms_c();
     return 0;
 }
@@ -224,6 +387,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->coefs[2]);
     av_freep(&s->coefs[3]);
     av_freep(&s->line);
+    av_freep(&s->hbuf);
     av_freep(&s->frame_prev[0]);
     av_freep(&s->frame_prev[1]);
     av_freep(&s->frame_prev[2]);
@@ -261,7 +425,8 @@ static int query_formats(AVFilterContext *ctx)
 
 static int config_input(AVFilterLink *inlink)
 {
-    HQDN3DContext *s = inlink->dst->priv;
+    AVFilterContext *ctx = inlink->dst;
+    HQDN3DContext *s = ctx->priv;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     int i;
 
@@ -275,6 +440,13 @@ static int config_input(AVFilterLink *inlink)
     if (!s->line)
         return AVERROR(ENOMEM);
 
+    s->nb_bands = av_clip(inlink->w / 32, 1, ff_filter_get_nb_threads(ctx));
+    if (s->nb_bands > 1) {
+        s->hbuf = av_malloc_array(inlink->w, inlink->h * sizeof(*s->hbuf));
+        if (!s->hbuf)
+            return AVERROR(ENOMEM);
+    }
+
     for (i = 0; i < 4; i++) {
         s->coefs[i] = precalc_coefs(s->strength[i], s->depth);
         if (!s->coefs[i])
@@ -309,7 +481,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     for (c = 0; c < 3; c++) {
-        denoise(s, in->data[c], out->data[c],
+        denoise(ctx, in->data[c], out->data[c],
                 s->line, &s->frame_prev[c],
                 AV_CEIL_RSHIFT(in->width,  (!!c * s->hsub)),
                 AV_CEIL_RSHIFT(in->height, (!!c * s->vsub)),
@@ -370,5 +542,5 @@ AVFilter ff_vf_hqdn3d = {
     .query_formats = query_formats,
     .inputs        = avfilter_vf_hqdn3d_inputs,
     .outputs       = avfilter_vf_hqdn3d_outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
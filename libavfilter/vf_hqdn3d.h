@@ -33,6 +33,8 @@ typedef struct HQDN3DContext {
     int16_t *coefs[4];
     uint16_t *line;
     uint16_t *frame_prev[3];
+    uint16_t *hbuf;
+    int nb_bands;
     double strength[4];
     int hsub, vsub;
     int depth;
@@ -163,9 +163,23 @@ typedef struct Frame {
     Block *blocks;
 } Frame;
 
+typedef struct MIMEContext {
+    AVMotionEstContext me_ctx;      ///< must be first, the cost functions get a pointer to it
+    av_pixelutils_sad_fn sad[6];    ///< SAD of 1x1 to 32x32 blocks
+} MIMEContext;
+
+typedef struct ThreadData {
+    Block *blocks;
+    int dir;
+    int wave;
+    int mb_y_start;
+    AVFrame *avf_out;
+    int alpha;
+} ThreadData;
+
 typedef struct MIContext {
     const AVClass *class;
-    AVMotionEstContext me_ctx;
+    MIMEContext me;
     AVRational frame_rate;
     enum MIMode mi_mode;
     int mc_mode;
@@ -255,6 +269,16 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, fmts_list);
 }
 
+static av_always_inline av_pixelutils_sad_fn get_sad_fn(AVMotionEstContext *me_ctx, int size)
+{
+    return ((MIMEContext *)me_ctx)->sad[av_log2(size)];
+}
+
+static int sad_1x1(const uint8_t *src1, ptrdiff_t stride1, const uint8_t *src2, ptrdiff_t stride2)
+{
+    return FFABS(src1[0] - src2[0]);
+}
+
 static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int y_mv)
 {
     uint8_t *data_cur = me_ctx->data_cur;
@@ -262,8 +286,8 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     int linesize = me_ctx->linesize;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    uint64_t sbad;
 
     x = av_clip(x, me_ctx->x_min, me_ctx->x_max);
     y = av_clip(y, me_ctx->y_min, me_ctx->y_max);
@@ -273,9 +297,8 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     data_cur += (y + mv_y) * linesize;
     data_next += (y - mv_y) * linesize;
 
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    sbad = get_sad_fn(me_ctx, me_ctx->mb_size)(data_cur + x + mv_x, linesize,
+                                               data_next + x - mv_x, linesize);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -291,17 +314,17 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    int ob = me_ctx->mb_size / 2;
+    uint64_t sbad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     mv_x = av_clip(x_mv - x, -FFMIN(x - x_min, x_max - x), FFMIN(x - x_min, x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - y_min, y_max - y), FFMIN(y - y_min, y_max - y));
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    sbad = get_sad_fn(me_ctx, ob + me_ctx->mb_size * 3 / 2)(data_cur  + x + mv_x - ob + (y + mv_y - ob) * linesize, linesize,
+                                                   data_next + x - mv_x - ob + (y - mv_y - ob) * linesize, linesize);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -317,17 +340,16 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
     int mv_x = x_mv - x;
     int mv_y = y_mv - y;
-    int i, j;
-    uint64_t sad = 0;
+    int ob = me_ctx->mb_size / 2;
+    uint64_t sad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     x_mv = av_clip(x_mv, x_min, x_max);
     y_mv = av_clip(y_mv, y_min, y_max);
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    sad = get_sad_fn(me_ctx, ob + me_ctx->mb_size * 3 / 2)(data_ref + x_mv - ob + (y_mv - ob) * linesize, linesize,
+                                                  data_cur + x    - ob + (y    - ob) * linesize, linesize);
 
     return sad + (FFABS(mv_x - me_ctx->pred_x) + FFABS(mv_y - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -335,7 +357,7 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
 static int config_input(AVFilterLink *inlink)
 {
     MIContext *mi_ctx = inlink->dst->priv;
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
+    AVMotionEstContext *me_ctx = &mi_ctx->me.me_ctx;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     const int height = inlink->h;
     const int width  = inlink->w;
@@ -388,6 +410,13 @@ static int config_input(AVFilterLink *inlink)
             return AVERROR(EINVAL);
     }
 
+    mi_ctx->me.sad[0] = sad_1x1;
+    for (i = 1; i < FF_ARRAY_ELEMS(mi_ctx->me.sad); i++) {
+        mi_ctx->me.sad[i] = av_pixelutils_get_sad_fn(i, i, 0, mi_ctx);
+        if (!mi_ctx->me.sad[i])
+            return AVERROR(EINVAL);
+    }
+
     ff_me_init_context(me_ctx, mi_ctx->mb_size, mi_ctx->search_param, width, height, 0, (mi_ctx->b_width - 1) << mi_ctx->log2_mb_size, 0, (mi_ctx->b_height - 1) << mi_ctx->log2_mb_size);
 
     if (mi_ctx->me_mode == ME_MODE_BIDIR)
@@ -422,9 +451,9 @@ static int config_output(AVFilterLink *outlink)
         preds.nb++;\
     } while(0)
 
-static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int dir)
+static void search_mv(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *blocks,
+                      int mb_x, int mb_y, int dir)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     AVMotionEstPredictor *preds = me_ctx->preds;
     Block *block = &blocks[mb_x + mb_y * mi_ctx->b_width];
 
@@ -564,8 +593,49 @@ static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int
     block->mvs[dir][1] = mv[1] - y_mb;
 }
 
-static void bilateral_me(MIContext *mi_ctx)
+static int search_mv_wave(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    int mb_y = td->mb_y_start + jobnr;
+    int mb_x = td->wave - 2 * mb_y;
+    MIMEContext me = mi_ctx->me;
+
+    search_mv(mi_ctx, &me.me_ctx, td->blocks, mb_x, mb_y, td->dir);
+
+    /* the predictors left by the last block are used by later cost computations */
+    if (mb_x == mi_ctx->b_width - 1 && mb_y == mi_ctx->b_height - 1)
+        mi_ctx->me = me;
+
+    emms_c();
+    return 0;
+}
+
+/**
+ * Search the motion vectors of all blocks, in waves of blocks that are
+ * independent from each other. Block (x, y) only depends on its left, top
+ * and top-right neighbours, which all belong to earlier waves when waves
+ * are numbered x + 2 * y, so the result is the same as in raster order.
+ */
+static void search_mvs(AVFilterContext *ctx, Block *blocks, int dir)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData td;
+
+    td.blocks = blocks;
+    td.dir = dir;
+
+    for (td.wave = 0; td.wave < mi_ctx->b_width + 2 * (mi_ctx->b_height - 1); td.wave++) {
+        int mb_y_end = FFMIN(mi_ctx->b_height - 1, td.wave / 2);
+
+        td.mb_y_start = FFMAX(0, (td.wave - mi_ctx->b_width + 2) / 2);
+        ctx->internal->execute(ctx, search_mv_wave, &td, NULL, mb_y_end - td.mb_y_start + 1);
+    }
+}
+
+static void bilateral_me(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
     Block *block;
     int mb_x, mb_y;
 
@@ -580,14 +650,12 @@ static void bilateral_me(MIContext *mi_ctx)
             block->mvs[0][1] = 0;
         }
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-            search_mv(mi_ctx, mi_ctx->int_blocks, mb_x, mb_y, 0);
+    search_mvs(ctx, mi_ctx->int_blocks, 0);
 }
 
 static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
+    AVMotionEstContext *me_ctx = &mi_ctx->me.me_ctx;
     uint64_t cost_sb, cost_old;
     int mb_size = me_ctx->mb_size;
     int search_param = me_ctx->search_param;
@@ -622,7 +690,7 @@ static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int
             me_ctx->pred_x = block->mvs[0][0];
             me_ctx->pred_y = block->mvs[0][1];
 
-            cost_sb = ff_me_search_ds(&mi_ctx->me_ctx, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1], mv);
+            cost_sb = ff_me_search_ds(&mi_ctx->me.me_ctx, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1], mv);
             mv_x = mv[0] - x_mb;
             mv_y = mv[1] - y_mb;
 
@@ -761,13 +829,11 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
 
             if (mi_ctx->frames[1].avf) {
                 for (dir = 0; dir < 2; dir++) {
-                    mi_ctx->me_ctx.linesize = mi_ctx->frames[2].avf->linesize[0];
-                    mi_ctx->me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
-                    mi_ctx->me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
+                    mi_ctx->me.me_ctx.linesize = mi_ctx->frames[2].avf->linesize[0];
+                    mi_ctx->me.me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
+                    mi_ctx->me.me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
 
-                    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-                            search_mv(mi_ctx, mi_ctx->frames[2].blocks, mb_x, mb_y, dir);
+                    search_mvs(ctx, mi_ctx->frames[2].blocks, dir);
                 }
             }
 
@@ -778,11 +844,11 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
             if (!mi_ctx->frames[0].avf)
                 return 0;
 
-            mi_ctx->me_ctx.linesize = mi_ctx->frames[0].avf->linesize[0];
-            mi_ctx->me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
-            mi_ctx->me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
+            mi_ctx->me.me_ctx.linesize = mi_ctx->frames[0].avf->linesize[0];
+            mi_ctx->me.me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
+            mi_ctx->me.me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
 
-            bilateral_me(mi_ctx);
+            bilateral_me(ctx);
 
             if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
 
@@ -792,8 +858,9 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
                         int y_mb = mb_y << mi_ctx->log2_mb_size;
                         block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
 
-                        block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
+                        block->sbad = get_sbad(&mi_ctx->me.me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
                     }
+                emms_c();
             }
 
             if (mi_ctx->vsbmc) {
@@ -825,7 +892,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
 
 static int detect_scene_change(MIContext *mi_ctx)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
+    AVMotionEstContext *me_ctx = &mi_ctx->me.me_ctx;
     int x, y;
     int linesize = me_ctx->linesize;
     uint8_t *p1 = mi_ctx->frames[1].avf->data[0];
@@ -867,17 +934,13 @@ static int detect_scene_change(MIContext *mi_ctx)
         pixel_refs->nb++;\
     } while(0)
 
-static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
+static void bidirectional_obmc(MIContext *mi_ctx, int alpha, int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
     int height = mi_ctx->frames[0].avf->height;
     int mb_y, mb_x, dir;
 
-    for (y = 0; y < height; y++)
-        for (x = 0; x < width; x++)
-            mi_ctx->pixel_refs[x + y * width].nb = 0;
-
     for (dir = 0; dir < 2; dir++)
         for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
             for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
@@ -900,6 +963,9 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                     mv_y = -mv_y;
                 }
 
+                startc_y = FFMAX(startc_y, slice_start);
+                endc_y = FFMIN(endc_y, slice_end);
+
                 for (y = startc_y; y < endc_y; y++) {
                     int y_min = -y;
                     int y_max = height - y - 1;
@@ -917,16 +983,15 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
             }
 }
 
-static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
+static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out, int slice_start, int slice_end)
 {
     int x, y, plane;
 
     for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
         int width = avf_out->width;
-        int height = avf_out->height;
         int chroma = plane == 1 || plane == 2;
 
-        for (y = 0; y < height; y++)
+        for (y = slice_start; y < slice_end; y++)
             for (x = 0; x < width; x++) {
                 int x_mv, y_mv;
                 int weight_sum = 0;
@@ -975,7 +1040,8 @@ static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
     }
 }
 
-static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha)
+static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha,
+                         int slice_start, int slice_end)
 {
     int sb_x, sb_y;
     int width = mi_ctx->frames[0].avf->width;
@@ -986,7 +1052,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
             Block *sb = &block->subs[sb_x + sb_y * 2];
 
             if (sb->sb)
-                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
+                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha,
+                             slice_start, slice_end);
             else {
                 int x, y;
                 int mv_x = sb->mvs[0][0] * 2;
@@ -997,6 +1064,9 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
                 int end_x = start_x + (1 << (n - 1));
                 int end_y = start_y + (1 << (n - 1));
 
+                start_y = FFMAX(start_y, slice_start);
+                end_y = FFMIN(end_y, slice_end);
+
                 for (y = start_y; y < end_y; y++)  {
                     int y_min = -y;
                     int y_max = height - y - 1;
@@ -1014,7 +1084,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
         }
 }
 
-static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha)
+static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha,
+                           int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
@@ -1029,6 +1100,19 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     int start_x, start_y;
     int startc_x, startc_y, endc_x, endc_y;
 
+    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+
+    startc_x = av_clip(start_x, 0, width - 1);
+    startc_y = av_clip(start_y, 0, height - 1);
+    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
+    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+
+    startc_y = FFMAX(startc_y, slice_start);
+    endc_y = FFMIN(endc_y, slice_end);
+    if (startc_y >= endc_y)
+        return;
+
     if (mi_ctx->mc_mode == MC_MODE_AOBMC)
         for (nb_y = FFMAX(0, mb_y - 1); nb_y < FFMIN(mb_y + 2, mi_ctx->b_height); nb_y++)
             for (nb_x = FFMAX(0, mb_x - 1); nb_x < FFMIN(mb_x + 2, mi_ctx->b_width); nb_x++) {
@@ -1036,17 +1120,9 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
                 int y_nb = nb_y << mi_ctx->log2_mb_size;
 
                 if (nb_x - mb_x || nb_y - mb_y)
-                    sbads[nb_x - mb_x + 1 + (nb_y - mb_y + 1) * 3] = get_sbad(&mi_ctx->me_ctx, x_nb, y_nb, x_nb + block->mvs[0][0], y_nb + block->mvs[0][1]);
+                    sbads[nb_x - mb_x + 1 + (nb_y - mb_y + 1) * 3] = get_sbad(&mi_ctx->me.me_ctx, x_nb, y_nb, x_nb + block->mvs[0][0], y_nb + block->mvs[0][1]);
             }
 
-    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-
-    startc_x = av_clip(start_x, 0, width - 1);
-    startc_y = av_clip(start_y, 0, height - 1);
-    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
-
     for (y = startc_y; y < endc_y; y++) {
         int y_min = -y;
         int y_max = height - y - 1;
@@ -1078,13 +1154,91 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     }
 }
 
+static int blend_frames_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *avf_out = td->avf_out;
+    int alpha = td->alpha;
+    int x, y, plane;
+
+    for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
+        int width = avf_out->width;
+        int height = avf_out->height;
+        int slice_start, slice_end;
+
+        if (plane == 1 || plane == 2) {
+            width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
+            height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+        }
+
+        slice_start = (height *  jobnr     ) / nb_jobs;
+        slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+        for (y = slice_start; y < slice_end; y++) {
+            for (x = 0; x < width; x++) {
+                avf_out->data[plane][x + y * avf_out->linesize[plane]] =
+                    (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
+                     (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Motion compensate a slice of rows. The slices are aligned to the chroma
+ * subsampling, as set_frame_data() writes each chroma sample from all the
+ * luma positions covering it.
+ */
+static int mci_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    int alpha = td->alpha;
+    int width = mi_ctx->frames[0].avf->width;
+    int height = mi_ctx->frames[0].avf->height;
+    int units = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+    int slice_start = FFMIN(height, (units *  jobnr     ) / nb_jobs << mi_ctx->log2_chroma_h);
+    int slice_end   = FFMIN(height, (units * (jobnr + 1)) / nb_jobs << mi_ctx->log2_chroma_h);
+    int x, y;
+
+    for (y = slice_start; y < slice_end; y++)
+        for (x = 0; x < width; x++)
+            mi_ctx->pixel_refs[x + y * width].nb = 0;
+
+    if (mi_ctx->me_mode == ME_MODE_BIDIR) {
+        bidirectional_obmc(mi_ctx, alpha, slice_start, slice_end);
+    } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
+        int mb_x, mb_y;
+        Block *block;
+
+        for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
+            for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+                block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+                if (block->sb)
+                    var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha,
+                                 slice_start, slice_end);
+
+                bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha, slice_start, slice_end);
+            }
+    }
+
+    set_frame_data(mi_ctx, alpha, td->avf_out, slice_start, slice_end);
+
+    emms_c();
+    return 0;
+}
+
 static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     MIContext *mi_ctx = ctx->priv;
-    int x, y;
-    int plane, alpha;
+    ThreadData td;
+    int alpha, units;
     int64_t pts;
 
     pts = av_rescale(avf_out->pts, (int64_t) ALPHA_MAX * outlink->time_base.num * inlink->time_base.den,
@@ -1110,51 +1264,17 @@ static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
 
             break;
         case MI_MODE_BLEND:
-            for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
-                int width = avf_out->width;
-                int height = avf_out->height;
-
-                if (plane == 1 || plane == 2) {
-                    width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
-                    height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
-                }
-
-                for (y = 0; y < height; y++) {
-                    for (x = 0; x < width; x++) {
-                        avf_out->data[plane][x + y * avf_out->linesize[plane]] =
-                            (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
-                             (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
-                    }
-                }
-            }
+            td.avf_out = avf_out;
+            td.alpha = alpha;
+            ctx->internal->execute(ctx, blend_frames_slice, &td, NULL,
+                                   FFMIN(AV_CEIL_RSHIFT(avf_out->height, mi_ctx->log2_chroma_h), ff_filter_get_nb_threads(ctx)));
 
             break;
         case MI_MODE_MCI:
-            if (mi_ctx->me_mode == ME_MODE_BIDIR) {
-                bidirectional_obmc(mi_ctx, alpha);
-                set_frame_data(mi_ctx, alpha, avf_out);
-
-            } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
-                int mb_x, mb_y;
-                Block *block;
-
-                for (y = 0; y < mi_ctx->frames[0].avf->height; y++)
-                    for (x = 0; x < mi_ctx->frames[0].avf->width; x++)
-                        mi_ctx->pixel_refs[x + y * mi_ctx->frames[0].avf->width].nb = 0;
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        if (block->sb)
-                            var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
-
-                        bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha);
-
-                    }
-
-                set_frame_data(mi_ctx, alpha, avf_out);
-            }
+            td.avf_out = avf_out;
+            td.alpha = alpha;
+            units = AV_CEIL_RSHIFT(mi_ctx->frames[0].avf->height, mi_ctx->log2_chroma_h);
+            ctx->internal->execute(ctx, mci_slice, &td, NULL, FFMIN(units, ff_filter_get_nb_threads(ctx)));
 
             break;
     }
@@ -1269,4 +1389,5 @@ AVFilter ff_vf_minterpolate = {
     .query_formats = query_formats,
     .inputs        = minterpolate_inputs,
     .outputs       = minterpolate_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
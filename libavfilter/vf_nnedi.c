@@ -43,8 +43,8 @@ typedef struct FrameData {
     int field[3];
 
     int32_t *lcount[3];
-    float *input;
-    float *temp;
+    float *input;   ///< nb_threads buffers of 512 floats
+    float *temp;    ///< nb_threads buffers of temp_size bytes
 } FrameData;
 
 typedef struct NNEDIContext {
@@ -60,8 +60,10 @@ typedef struct NNEDIContext {
 
     AVFloatDSPContext *fdsp;
     int nb_planes;
+    int nb_threads;
     int linesize[4];
     int planeheight[4];
+    int temp_size;
 
     float *weights0;
     float *weights1[2];
@@ -84,8 +86,8 @@ typedef struct NNEDIContext {
     int max_value;
 
     void (*copy_pad)(const AVFrame *, FrameData *, struct NNEDIContext *, int);
-    void (*evalfunc_0)(struct NNEDIContext *, FrameData *);
-    void (*evalfunc_1)(struct NNEDIContext *, FrameData *);
+    void (*evalfunc_0)(struct NNEDIContext *, FrameData *, int plane, int slice_start, int slice_end, int jobnr);
+    void (*evalfunc_1)(struct NNEDIContext *, FrameData *, int plane, int slice_start, int slice_end, int jobnr);
 
     // Functions used in evalfunc_0
     void (*readpixels)(const uint8_t *, const int, float *);
@@ -161,6 +163,11 @@ static int config_input(AVFilterLink *inlink)
     s->planeheight[1] = s->planeheight[2] = AV_CEIL_RSHIFT(inlink->h, desc->log2_chroma_h);
     s->planeheight[0] = s->planeheight[3] = inlink->h;
 
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+    // evalfunc_0 requires at least padded_width[0] bytes.
+    // evalfunc_1 requires at least 512 floats.
+    s->temp_size = FFALIGN(FFMAX(s->linesize[0] + 64, 512 * sizeof(float)), 32);
+
     return 0;
 }
 
@@ -278,6 +285,30 @@ static void dot_prod(NNEDIContext *s, const float *data, const float *weights, f
     }
 }
 
+/**
+ * Same as dot_prod(), for weights where each group of 8 consecutive neurons
+ * has its coefficients interleaved: the 8 sums are accumulated side by side,
+ * each one in the same order as avpriv_scalarproduct_float_c(). This keeps
+ * the output of the c version while reading the input once per 8 neurons
+ * instead of once per neuron.
+ */
+static void dot_prod8(NNEDIContext *s, const float *data, const float *weights, float *vals, const int n, const int len, const float *scale)
+{
+    int i, j, k;
+
+    for (i = 0; i < n; i += 8) {
+        const float *w = &weights[i * len];
+        float sum[8] = { 0.0f };
+
+        for (j = 0; j < len; j++)
+            for (k = 0; k < 8; k++)
+                sum[k] += data[j] * w[j * 8 + k];
+
+        for (k = 0; k < 8; k++)
+            vals[i + k] = sum[k] * scale[0] + weights[n * len + i + k];
+    }
+}
+
 static void dot_prods(NNEDIContext *s, const float *dataf, const float *weightsf, float *vals, const int n, const int len, const float *scale)
 {
     const int16_t *data = (int16_t *)dataf;
@@ -285,12 +316,22 @@ static void dot_prods(NNEDIContext *s, const float *dataf, const float *weightsf
     const float *wf = (float *)&weights[n * len];
     int i, j;
 
-    for (i = 0; i < n; i++) {
-        int sum = 0, off = ((i >> 2) << 3) + (i & 3);
-        for (j = 0; j < len; j++)
-            sum += data[j] * weights[i * len + j];
+    for (i = 0; i < n; i += 4) {
+        const int16_t *w = &weights[i * len];
+        int sum[4] = { 0 }, k;
 
-        vals[i] = sum * wf[off] * scale[0] + wf[off + 4];
+        // Four neurons at a time, so each input is loaded only once.
+        for (j = 0; j < len; j++) {
+            sum[0] += data[j] * w[          j];
+            sum[1] += data[j] * w[    len + j];
+            sum[2] += data[j] * w[2 * len + j];
+            sum[3] += data[j] * w[3 * len + j];
+        }
+
+        for (k = 0; k < 4; k++) {
+            const int off = ((i >> 2) << 3) + k;
+            vals[i + k] = sum[k] * wf[off] * scale[0] + wf[off + 4];
+        }
     }
 }
 
@@ -386,14 +427,15 @@ static void compute_network0new(NNEDIContext *s, const float *datai, const float
     int16_t *ws = (int16_t *)weights;
     float *wf = (float *)&ws[4 * 64];
     float vals[8];
-    int mask, i, j;
+    int mask, i, j, k;
 
     for (i = 0; i < 4; i++) {
         int sum = 0;
         float t;
 
-        for (j = 0; j < 64; j++)
-            sum += data[j] * ws[(i << 3) + ((j >> 3) << 5) + (j & 7)];
+        for (j = 0; j < 64; j += 8)
+            for (k = 0; k < 8; k++)
+                sum += data[j + k] * ws[(i << 3) + (j << 2) + k];
         t = sum * wf[i] + wf[4 + i];
         vals[i] = t / (1.0f + FFABS(t));
     }
@@ -415,71 +457,61 @@ static void compute_network0new(NNEDIContext *s, const float *datai, const float
     ((int *)d)[0] = mask;
 }
 
-static void evalfunc_0(NNEDIContext *s, FrameData *frame_data)
+static void evalfunc_0(NNEDIContext *s, FrameData *frame_data, int plane,
+                       int slice_start, int slice_end, int jobnr)
 {
-    float *input = frame_data->input;
+    float *input = frame_data->input + jobnr * 512;
     const float *weights0 = s->weights0;
-    float *temp = frame_data->temp;
+    float *temp = (float *)((uint8_t *)frame_data->temp + jobnr * s->temp_size);
     uint8_t *tempu = (uint8_t *)temp;
-    int plane, x, y;
+    const int field = frame_data->field[plane];
+    const uint8_t *srcp = (const uint8_t *)frame_data->paddedp[plane];
+    const int src_stride = frame_data->padded_stride[plane] / sizeof(uint8_t);
 
-    // And now the actual work.
-    for (plane = 0; plane < s->nb_planes; plane++) {
-        const uint8_t *srcp = (const uint8_t *)frame_data->paddedp[plane];
-        const int src_stride = frame_data->padded_stride[plane] / sizeof(uint8_t);
+    const int width = frame_data->padded_width[plane];
 
-        const int width = frame_data->padded_width[plane];
-        const int height = frame_data->padded_height[plane];
+    uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
+    const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
+    const uint8_t *src3p;
+    int ystart, x, y;
+    int32_t *lcount = frame_data->lcount[plane];
 
-        uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
-        const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
-        const uint8_t *src3p;
-        int ystart, ystop;
-        int32_t *lcount;
-
-        if (!(s->process_plane & (1 << plane)))
-            continue;
-
-        for (y = 1 - frame_data->field[plane]; y < height - 12; y += 2) {
-            memcpy(dstp + y * dst_stride,
-                   srcp + 32 + (6 + y) * src_stride,
-                   (width - 64) * sizeof(uint8_t));
+    // And now the actual work.
+    for (y = slice_start + ((slice_start ^ (1 - field)) & 1); y < slice_end; y += 2) {
+        memcpy(dstp + y * dst_stride,
+               srcp + 32 + (6 + y) * src_stride,
+               (width - 64) * sizeof(uint8_t));
+    }
 
-        }
+    ystart = slice_start + ((slice_start ^ field) & 1);
+    src3p = srcp + (ystart + 3) * src_stride;
+    dstp += ystart * dst_stride - 32;
 
-        ystart = 6 + frame_data->field[plane];
-        ystop = height - 6;
-        srcp += ystart * src_stride;
-        dstp += (ystart - 6) * dst_stride - 32;
-        src3p = srcp - src_stride * 3;
-        lcount = frame_data->lcount[plane] - 6;
-
-        if (s->pscrn == 1) { // original
-            for (y = ystart; y < ystop; y += 2) {
-                for (x = 32; x < width - 32; x++) {
-                    s->readpixels((const uint8_t *)(src3p + x - 5), src_stride, input);
-                    s->compute_network0(s, input, weights0, tempu+x);
-                }
-                lcount[y] += s->process_line0(tempu + 32, width - 64, (uint8_t *)(dstp + 32), (const uint8_t *)(src3p + 32), src_stride, s->max_value, plane);
-                src3p += src_stride * 2;
-                dstp += dst_stride * 2;
-            }
-        } else if (s->pscrn > 1) { // new
-            for (y = ystart; y < ystop; y += 2) {
-                for (x = 32; x < width - 32; x += 4) {
-                    s->readpixels((const uint8_t *)(src3p + x - 6), src_stride, input);
-                    s->compute_network0(s, input, weights0, tempu + x);
-                }
-                lcount[y] += s->process_line0(tempu + 32, width - 64, (uint8_t *)(dstp + 32), (const uint8_t *)(src3p + 32), src_stride, s->max_value, plane);
-                src3p += src_stride * 2;
-                dstp += dst_stride * 2;
+    if (s->pscrn == 1) { // original
+        for (y = ystart; y < slice_end; y += 2) {
+            for (x = 32; x < width - 32; x++) {
+                s->readpixels((const uint8_t *)(src3p + x - 5), src_stride, input);
+                s->compute_network0(s, input, weights0, tempu+x);
             }
-        } else { // no prescreening
-            for (y = ystart; y < ystop; y += 2) {
-                memset(dstp + 32, 255, (width - 64) * sizeof(uint8_t));
-                lcount[y] += width - 64;
-                dstp += dst_stride * 2;
+            lcount[y] += s->process_line0(tempu + 32, width - 64, (uint8_t *)(dstp + 32), (const uint8_t *)(src3p + 32), src_stride, s->max_value, plane);
+            src3p += src_stride * 2;
+            dstp += dst_stride * 2;
+        }
+    } else if (s->pscrn > 1) { // new
+        for (y = ystart; y < slice_end; y += 2) {
+            for (x = 32; x < width - 32; x += 4) {
+                s->readpixels((const uint8_t *)(src3p + x - 6), src_stride, input);
+                s->compute_network0(s, input, weights0, tempu + x);
             }
+            lcount[y] += s->process_line0(tempu + 32, width - 64, (uint8_t *)(dstp + 32), (const uint8_t *)(src3p + 32), src_stride, s->max_value, plane);
+            src3p += src_stride * 2;
+            dstp += dst_stride * 2;
+        }
+    } else { // no prescreening
+        for (y = ystart; y < slice_end; y += 2) {
+            memset(dstp + 32, 255, (width - 64) * sizeof(uint8_t));
+            lcount[y] += width - 64;
+            dstp += dst_stride * 2;
         }
     }
 }
@@ -575,10 +607,11 @@ static void weighted_avg_elliott_mul5_m16(const float *w, const int n, float *ms
 }
 
 
-static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
+static void evalfunc_1(NNEDIContext *s, FrameData *frame_data, int plane,
+                       int slice_start, int slice_end, int jobnr)
 {
-    float *input = frame_data->input;
-    float *temp = frame_data->temp;
+    float *input = frame_data->input + jobnr * 512;
+    float *temp = (float *)((uint8_t *)frame_data->temp + jobnr * s->temp_size);
     float **weights1 = s->weights1;
     const int qual = s->qual;
     const int asize = s->asize;
@@ -587,49 +620,65 @@ static void evalfunc_1(NNEDIContext *s, FrameData *frame_data)
     const int xdiad2m1 = (xdia / 2) - 1;
     const int ydia = s->ydia;
     const float scale = 1.0f / (float)qual;
-    int plane, y, x, i;
+    const uint8_t *srcp = (const uint8_t *)frame_data->paddedp[plane];
+    const int src_stride = frame_data->padded_stride[plane] / sizeof(uint8_t);
 
-    for (plane = 0; plane < s->nb_planes; plane++) {
-        const uint8_t *srcp = (const uint8_t *)frame_data->paddedp[plane];
-        const int src_stride = frame_data->padded_stride[plane] / sizeof(uint8_t);
+    const int width = frame_data->padded_width[plane];
 
-        const int width = frame_data->padded_width[plane];
-        const int height = frame_data->padded_height[plane];
+    uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
+    const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
 
-        uint8_t *dstp = (uint8_t *)frame_data->dstp[plane];
-        const int dst_stride = frame_data->dst_stride[plane] / sizeof(uint8_t);
+    const int ystart = slice_start + ((slice_start ^ frame_data->field[plane]) & 1);
+    const uint8_t *srcpp;
+    int y, x, i;
 
-        const int ystart = frame_data->field[plane];
-        const int ystop = height - 12;
-        const uint8_t *srcpp;
+    srcp += (ystart + 6) * src_stride;
+    dstp += ystart * dst_stride - 32;
+    srcpp = srcp - (ydia - 1) * src_stride - xdiad2m1;
 
-        if (!(s->process_plane & (1 << plane)))
-            continue;
+    for (y = ystart; y < slice_end; y += 2) {
+        for (x = 32; x < width - 32; x++) {
+            float mstd[4];
 
-        srcp += (ystart + 6) * src_stride;
-        dstp += ystart * dst_stride - 32;
-        srcpp = srcp - (ydia - 1) * src_stride - xdiad2m1;
+            if (dstp[x] != 255)
+                continue;
 
-        for (y = ystart; y < ystop; y += 2) {
-            for (x = 32; x < width - 32; x++) {
-                float mstd[4];
+            s->extract((const uint8_t *)(srcpp + x), src_stride, xdia, ydia, mstd, input);
+            for (i = 0; i < qual; i++) {
+                s->dot_prod(s, input, weights1[i], temp, nns * 2, asize, mstd + 2);
+                s->expfunc(temp, nns);
+                s->wae5(temp, nns, mstd);
+            }
 
-                if (dstp[x] != 255)
-                    continue;
+            dstp[x] = FFMIN(FFMAX((int)(mstd[3] * scale + 0.5f), 0), s->max_value);
+        }
+        srcpp += src_stride * 2;
+        dstp += dst_stride * 2;
+    }
+}
 
-                s->extract((const uint8_t *)(srcpp + x), src_stride, xdia, ydia, mstd, input);
-                for (i = 0; i < qual; i++) {
-                    s->dot_prod(s, input, weights1[i], temp, nns * 2, asize, mstd + 2);
-                    s->expfunc(temp, nns);
-                    s->wae5(temp, nns, mstd);
-                }
+static int filter_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    NNEDIContext *s = ctx->priv;
+    FrameData *frame_data = arg;
+    int plane;
 
-                dstp[x] = FFMIN(FFMAX((int)(mstd[3] * scale + 0.5f), 0), s->max_value);
-            }
-            srcpp += src_stride * 2;
-            dstp += dst_stride * 2;
-        }
+    for (plane = 0; plane < s->nb_planes; plane++) {
+        const int slice_start = (s->planeheight[plane] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (s->planeheight[plane] * (jobnr + 1)) / nb_jobs;
+
+        if (!(s->process_plane & (1 << plane)))
+            continue;
+
+        // Handles prescreening and the cubic interpolation.
+        s->evalfunc_0(s, frame_data, plane, slice_start, slice_end, jobnr);
+
+        // The rest, on the lines the prescreener left for the predictor.
+        s->evalfunc_1(s, frame_data, plane, slice_start, slice_end, jobnr);
     }
+
+    emms_c();
+    return 0;
 }
 
 #define NUM_NSIZE 7
@@ -673,7 +722,11 @@ static void select_functions(NNEDIContext *s)
         s->dot_prod = dot_prods;
     } else { // use float dot products
         s->extract = extract_m8;
-        s->dot_prod = dot_prod;
+        // keep the simd scalarproduct when there is one
+        if (s->fdsp->scalarproduct_float == avpriv_scalarproduct_float_c)
+            s->dot_prod = dot_prod8;
+        else
+            s->dot_prod = dot_prod;
     }
 
     s->expfunc = e2_m16;
@@ -693,7 +746,6 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     AVFrame *src = s->src;
     FrameData *frame_data;
     int effective_field = s->field;
-    size_t temp_size;
     int field_n;
     int plane;
 
@@ -766,15 +818,12 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     }
 
     if (!frame_data->input) {
-        frame_data->input = av_malloc(512 * sizeof(float));
+        frame_data->input = av_malloc_array(s->nb_threads, 512 * sizeof(float));
         if (!frame_data->input)
             return AVERROR(ENOMEM);
     }
-    // evalfunc_0 requires at least padded_width[0] bytes.
-    // evalfunc_1 requires at least 512 floats.
     if (!frame_data->temp) {
-        temp_size = FFMAX(frame_data->padded_width[0], 512 * sizeof(float));
-        frame_data->temp = av_malloc(temp_size);
+        frame_data->temp = av_malloc_array(s->nb_threads, s->temp_size);
         if (!frame_data->temp)
             return AVERROR(ENOMEM);
     }
@@ -782,11 +831,8 @@ static int get_frame(AVFilterContext *ctx, int is_second)
     // Copy src to a padded "frame" in frame_data and mirror the edges.
     s->copy_pad(src, frame_data, s, field_n);
 
-    // Handles prescreening and the cubic interpolation.
-    s->evalfunc_0(s, frame_data);
-
-    // The rest.
-    s->evalfunc_1(s, frame_data);
+    ctx->internal->execute(ctx, filter_slice, frame_data, NULL,
+                           FFMIN(s->planeheight[1], s->nb_threads));
 
     return 0;
 }
@@ -922,6 +968,10 @@ static av_cold int init(AVFilterContext *ctx)
     int dims1offset = 0;
     int ret = 0, i, j, k;
 
+    s->fdsp = avpriv_float_dsp_alloc(0);
+    if (!s->fdsp)
+        return AVERROR(ENOMEM);
+
     weights_file = fopen(s->weights_file, "rb");
     if (!weights_file) {
         av_log(ctx, AV_LOG_ERROR, "No weights file provided, aborting!\n");
@@ -1077,6 +1127,7 @@ static av_cold int init(AVFilterContext *ctx)
         const int asize = xdia_table[s->nsize] * ydia_table[s->nsize];
         const int boff = nnst * 2 * asize;
         double *mean = (double *)av_calloc(asize + 1 + nnst * 2, sizeof(double));
+        float *w;
 
         if (!mean) {
             ret = AVERROR(ENOMEM);
@@ -1134,6 +1185,19 @@ static av_cold int init(AVFilterContext *ctx)
                 }
                 s->weights1[i][boff + j] = (float)(bdataT[boff + j] - (j < nnst ? mean[asize] : 0.0));
             }
+            // Interleave the weights of each group of 8 neurons for dot_prod8().
+            if (s->fdsp->scalarproduct_float == avpriv_scalarproduct_float_c) {
+                w = av_memdup(s->weights1[i], boff * sizeof(float));
+                if (!w) {
+                    av_free(mean);
+                    ret = AVERROR(ENOMEM);
+                    goto fail;
+                }
+                for (j = 0; j < nnst * 2; j++)
+                    for (k = 0; k < asize; k++)
+                        s->weights1[i][((j >> 3) * asize + k) * 8 + (j & 7)] = w[j * asize + k];
+                av_free(w);
+            }
         }
         av_free(mean);
     }
@@ -1147,10 +1211,6 @@ static av_cold int init(AVFilterContext *ctx)
 
     select_functions(s);
 
-    s->fdsp = avpriv_float_dsp_alloc(0);
-    if (!s->fdsp)
-        ret = AVERROR(ENOMEM);
-
 fail:
     av_free(bdata);
     return ret;
@@ -1207,5 +1267,5 @@ AVFilter ff_vf_nnedi = {
     .query_formats = query_formats,
     .inputs        = inputs,
     .outputs       = outputs,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL | AVFILTER_FLAG_SLICE_THREADS,
 };
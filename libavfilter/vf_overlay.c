@@ -37,12 +37,14 @@
 #include "libavutil/timestamp.h"
 #include "internal.h"
 #include "drawutils.h"
+#include "filters.h"
 #include "framesync.h"
 #include "video.h"
 #include "vf_overlay.h"
 
 typedef struct ThreadData {
-    AVFrame *dst, *src;
+    AVFrame *dst;
+    int y_start, y_end;         ///< rows of dst covered by the visible layers
 } ThreadData;
 
 static const char *const var_names[] = {
@@ -81,10 +83,18 @@ enum EvalMode {
 static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
+    int i;
 
     ff_framesync_uninit(&s->fs);
-    av_expr_free(s->x_pexpr); s->x_pexpr = NULL;
-    av_expr_free(s->y_pexpr); s->y_pexpr = NULL;
+    for (i = 0; i < s->nb_layers; i++) {
+        av_expr_free(s->layers[i].x_pexpr);
+        av_expr_free(s->layers[i].y_pexpr);
+    }
+    av_freep(&s->layers);
+    s->nb_layers = 0;
+
+    for (i = 0; i < ctx->nb_inputs; i++)
+        av_freep(&ctx->input_pads[i].name);
 }
 
 static inline int normalize_xy(double d, int chroma_sub)
@@ -94,36 +104,55 @@ static inline int normalize_xy(double d, int chroma_sub)
     return (int)d & ~((1 << chroma_sub) - 1);
 }
 
-static void eval_expr(AVFilterContext *ctx)
+/**
+ * Evaluate the position of the given layer; the overlay_w and overlay_h
+ * variables must already be set to its size.
+ */
+static void eval_expr(AVFilterContext *ctx, OverlayLayer *layer)
 {
     OverlayContext *s = ctx->priv;
 
-    s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, NULL);
-    s->var_values[VAR_Y] = av_expr_eval(s->y_pexpr, s->var_values, NULL);
+    s->var_values[VAR_X] = av_expr_eval(layer->x_pexpr, s->var_values, NULL);
+    s->var_values[VAR_Y] = av_expr_eval(layer->y_pexpr, s->var_values, NULL);
     /* It is necessary if x is expressed from y  */
-    s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, NULL);
-    s->x = normalize_xy(s->var_values[VAR_X], s->hsub);
-    s->y = normalize_xy(s->var_values[VAR_Y], s->vsub);
+    s->var_values[VAR_X] = av_expr_eval(layer->x_pexpr, s->var_values, NULL);
+    layer->x = normalize_xy(s->var_values[VAR_X], s->hsub);
+    layer->y = normalize_xy(s->var_values[VAR_Y], s->vsub);
 }
 
-static int set_expr(AVExpr **pexpr, const char *expr, const char *option, void *log_ctx)
+/**
+ * Parse the expression for the given layer. expr is a '|'-separated list
+ * with one entry per overlay input; the last entry is used for the
+ * layers beyond the end of the list.
+ */
+static int set_expr(AVExpr **pexpr, const char *expr, int layer,
+                    const char *option, void *log_ctx)
 {
     int ret;
     AVExpr *old = NULL;
+    char *item;
+
+    while (layer-- > 0 && strchr(expr, '|'))
+        expr = strchr(expr, '|') + 1;
+    item = av_strndup(expr, strcspn(expr, "|"));
+    if (!item)
+        return AVERROR(ENOMEM);
 
     if (*pexpr)
         old = *pexpr;
-    ret = av_expr_parse(pexpr, expr, var_names,
+    ret = av_expr_parse(pexpr, item, var_names,
                         NULL, NULL, NULL, NULL, 0, log_ctx);
     if (ret < 0) {
         av_log(log_ctx, AV_LOG_ERROR,
                "Error when evaluating the expression '%s' for %s\n",
-               expr, option);
+               item, option);
         *pexpr = old;
+        av_free(item);
         return ret;
     }
 
     av_expr_free(old);
+    av_free(item);
     return 0;
 }
 
@@ -131,23 +160,33 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
                            char *res, int res_len, int flags)
 {
     OverlayContext *s = ctx->priv;
-    int ret;
+    int i, ret = 0;
 
-    if      (!strcmp(cmd, "x"))
-        ret = set_expr(&s->x_pexpr, args, cmd, ctx);
-    else if (!strcmp(cmd, "y"))
-        ret = set_expr(&s->y_pexpr, args, cmd, ctx);
-    else
-        ret = AVERROR(ENOSYS);
+    for (i = 0; i < s->nb_layers && ret >= 0; i++) {
+        OverlayLayer *layer = &s->layers[i];
+
+        if      (!strcmp(cmd, "x"))
+            ret = set_expr(&layer->x_pexpr, args, i, cmd, ctx);
+        else if (!strcmp(cmd, "y"))
+            ret = set_expr(&layer->y_pexpr, args, i, cmd, ctx);
+        else
+            ret = AVERROR(ENOSYS);
+    }
 
     if (ret < 0)
         return ret;
 
     if (s->eval_mode == EVAL_MODE_INIT) {
-        eval_expr(ctx);
-        av_log(ctx, AV_LOG_VERBOSE, "x:%f xi:%d y:%f yi:%d\n",
-               s->var_values[VAR_X], s->x,
-               s->var_values[VAR_Y], s->y);
+        for (i = 0; i < s->nb_layers; i++) {
+            OverlayLayer *layer = &s->layers[i];
+
+            s->var_values[VAR_OVERLAY_W] = s->var_values[VAR_OW] = ctx->inputs[i + 1]->w;
+            s->var_values[VAR_OVERLAY_H] = s->var_values[VAR_OH] = ctx->inputs[i + 1]->h;
+            eval_expr(ctx, layer);
+            av_log(ctx, AV_LOG_VERBOSE, "layer:%d x:%f xi:%d y:%f yi:%d\n", i,
+                   s->var_values[VAR_X], layer->x,
+                   s->var_values[VAR_Y], layer->y);
+        }
     }
     return ret;
 }
@@ -260,10 +299,15 @@ static int query_formats(AVFilterContext *ctx)
         if (ret < 0)
             goto fail;
     } else {
+        int i;
+
         if ((ret = ff_formats_ref(main_formats   , &ctx->inputs[MAIN]->out_formats   )) < 0 ||
-            (ret = ff_formats_ref(overlay_formats, &ctx->inputs[OVERLAY]->out_formats)) < 0 ||
             (ret = ff_formats_ref(main_formats   , &ctx->outputs[MAIN]->in_formats   )) < 0)
                 goto fail;
+        /* all overlay inputs share one list and thus negotiate the same format */
+        for (i = OVERLAY; i < ctx->nb_inputs; i++)
+            if ((ret = ff_formats_ref(overlay_formats, &ctx->inputs[i]->out_formats)) < 0)
+                goto fail;
     }
 
     return 0;
@@ -281,6 +325,8 @@ static int config_input_overlay(AVFilterLink *inlink)
 {
     AVFilterContext *ctx  = inlink->dst;
     OverlayContext  *s = inlink->dst->priv;
+    int idx = FF_INLINK_IDX(inlink);
+    OverlayLayer *layer = &s->layers[idx - OVERLAY];
     int ret;
     const AVPixFmtDescriptor *pix_desc = av_pix_fmt_desc_get(inlink->format);
 
@@ -290,8 +336,8 @@ static int config_input_overlay(AVFilterLink *inlink)
        now when both inputs are configured. */
     s->var_values[VAR_MAIN_W   ] = s->var_values[VAR_MW] = ctx->inputs[MAIN   ]->w;
     s->var_values[VAR_MAIN_H   ] = s->var_values[VAR_MH] = ctx->inputs[MAIN   ]->h;
-    s->var_values[VAR_OVERLAY_W] = s->var_values[VAR_OW] = ctx->inputs[OVERLAY]->w;
-    s->var_values[VAR_OVERLAY_H] = s->var_values[VAR_OH] = ctx->inputs[OVERLAY]->h;
+    s->var_values[VAR_OVERLAY_W] = s->var_values[VAR_OW] = inlink->w;
+    s->var_values[VAR_OVERLAY_H] = s->var_values[VAR_OH] = inlink->h;
     s->var_values[VAR_HSUB]  = 1<<pix_desc->log2_chroma_w;
     s->var_values[VAR_VSUB]  = 1<<pix_desc->log2_chroma_h;
     s->var_values[VAR_X]     = NAN;
@@ -300,8 +346,8 @@ static int config_input_overlay(AVFilterLink *inlink)
     s->var_values[VAR_T]     = NAN;
     s->var_values[VAR_POS]   = NAN;
 
-    if ((ret = set_expr(&s->x_pexpr,      s->x_expr,      "x",      ctx)) < 0 ||
-        (ret = set_expr(&s->y_pexpr,      s->y_expr,      "y",      ctx)) < 0)
+    if ((ret = set_expr(&layer->x_pexpr, s->x_expr, idx - OVERLAY, "x", ctx)) < 0 ||
+        (ret = set_expr(&layer->y_pexpr, s->y_expr, idx - OVERLAY, "y", ctx)) < 0)
         return ret;
 
     s->overlay_is_packed_rgb =
@@ -309,18 +355,18 @@ static int config_input_overlay(AVFilterLink *inlink)
     s->overlay_has_alpha = ff_fmt_is_in(inlink->format, alpha_pix_fmts);
 
     if (s->eval_mode == EVAL_MODE_INIT) {
-        eval_expr(ctx);
+        eval_expr(ctx, layer);
         av_log(ctx, AV_LOG_VERBOSE, "x:%f xi:%d y:%f yi:%d\n",
-               s->var_values[VAR_X], s->x,
-               s->var_values[VAR_Y], s->y);
+               s->var_values[VAR_X], layer->x,
+               s->var_values[VAR_Y], layer->y);
     }
 
     av_log(ctx, AV_LOG_VERBOSE,
-           "main w:%d h:%d fmt:%s overlay w:%d h:%d fmt:%s\n",
+           "main w:%d h:%d fmt:%s %s w:%d h:%d fmt:%s\n",
            ctx->inputs[MAIN]->w, ctx->inputs[MAIN]->h,
            av_get_pix_fmt_name(ctx->inputs[MAIN]->format),
-           ctx->inputs[OVERLAY]->w, ctx->inputs[OVERLAY]->h,
-           av_get_pix_fmt_name(ctx->inputs[OVERLAY]->format));
+           ctx->input_pads[idx].name, inlink->w, inlink->h,
+           av_get_pix_fmt_name(inlink->format));
     return 0;
 }
 
@@ -328,10 +374,23 @@ static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     OverlayContext *s = ctx->priv;
-    int ret;
+    int i, ret;
 
-    if ((ret = ff_framesync_init_dualinput(&s->fs, ctx)) < 0)
-        return ret;
+    if (s->nb_inputs == 2) {
+        if ((ret = ff_framesync_init_dualinput(&s->fs, ctx)) < 0)
+            return ret;
+    } else {
+        if ((ret = ff_framesync_init(&s->fs, ctx, s->nb_inputs)) < 0)
+            return ret;
+        for (i = 0; i < s->nb_inputs; i++) {
+            FFFrameSyncIn *in = &s->fs.in[i];
+
+            in->time_base = ctx->inputs[i]->time_base;
+            in->sync      = i == MAIN ? 2 : 1;
+            in->before    = i == MAIN ? EXT_STOP : EXT_NULL;
+            in->after     = EXT_INFINITY;
+        }
+    }
 
     outlink->w = ctx->inputs[MAIN]->w;
     outlink->h = ctx->inputs[MAIN]->h;
@@ -351,20 +410,20 @@ static int config_output(AVFilterLink *outlink)
 #define UNPREMULTIPLY_ALPHA(x, y) ((((x) << 16) - ((x) << 9) + (x)) / ((((x) + (y)) << 8) - ((x) + (y)) - (y) * (x)))
 
 /**
- * Blend image in src to destination buffer dst at position (x, y).
+ * Blend image in src to destination buffer dst at position (x, y),
+ * restricted to the rows [slice_start, slice_end) of dst.
  */
 
 static av_always_inline void blend_slice_packed_rgb(AVFilterContext *ctx,
                                    AVFrame *dst, const AVFrame *src,
                                    int main_has_alpha, int x, int y,
-                                   int is_straight, int jobnr, int nb_jobs)
+                                   int is_straight, int slice_start, int slice_end)
 {
     OverlayContext *s = ctx->priv;
     int i, imax, j, jmax;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
-    const int dst_h = dst->height;
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     const int dr = s->main_rgba_map[R];
     const int dg = s->main_rgba_map[G];
@@ -376,19 +435,15 @@ static av_always_inline void blend_slice_packed_rgb(AVFilterContext *ctx,
     const int sb = s->overlay_rgba_map[B];
     const int sa = s->overlay_rgba_map[A];
     const int sstep = s->overlay_pix_step[0];
-    int slice_start, slice_end;
     uint8_t *S, *sp, *d, *dp;
 
-    i = FFMAX(-y, 0);
-    imax = FFMIN(-y + dst_h, src_h);
+    i = FFMAX(slice_start - y, 0);
+    imax = FFMIN(slice_end - y, src_h);
 
-    slice_start = (imax * jobnr) / nb_jobs;
-    slice_end = (imax * (jobnr+1)) / nb_jobs;
+    sp = src->data[0] + i       * src->linesize[0];
+    dp = dst->data[0] + (y + i) * dst->linesize[0];
 
-    sp = src->data[0] + (i + slice_start)     * src->linesize[0];
-    dp = dst->data[0] + (y + i + slice_start) * dst->linesize[0];
-
-    for (i = i + slice_start; i < slice_end; i++) {
+    for (; i < imax; i++) {
         j = FFMAX(-x, 0);
         S = sp + j     * sstep;
         d = dp + (x+j) * dstep;
@@ -444,7 +499,7 @@ static av_always_inline void blend_slice_packed_rgb(AVFilterContext *ctx,
 static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          AVFrame *dst, const AVFrame *src,
                                          int src_w, int src_h,
-                                         int dst_w, int dst_h,
+                                         int dst_w,
                                          int i, int hsub, int vsub,
                                          int x, int y,
                                          int main_has_alpha,
@@ -453,34 +508,29 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
                                          int dst_step,
                                          int straight,
                                          int yuv,
-                                         int jobnr,
-                                         int nb_jobs)
+                                         int slice_start,
+                                         int slice_end)
 {
     OverlayContext *octx = ctx->priv;
     int src_wp = AV_CEIL_RSHIFT(src_w, hsub);
     int src_hp = AV_CEIL_RSHIFT(src_h, vsub);
     int dst_wp = AV_CEIL_RSHIFT(dst_w, hsub);
-    int dst_hp = AV_CEIL_RSHIFT(dst_h, vsub);
     int yp = y>>vsub;
     int xp = x>>hsub;
     uint8_t *s, *sp, *d, *dp, *dap, *a, *da, *ap;
     int jmax, j, k, kmax;
-    int slice_start, slice_end;
-
-    j = FFMAX(-yp, 0);
-    jmax = FFMIN(-yp + dst_hp, src_hp);
 
-    slice_start = (jmax * jobnr) / nb_jobs;
-    slice_end = (jmax * (jobnr+1)) / nb_jobs;
+    j = FFMAX((slice_start >> vsub) - yp, 0);
+    jmax = FFMIN(AV_CEIL_RSHIFT(slice_end, vsub) - yp, src_hp);
 
-    sp = src->data[i] + slice_start * src->linesize[i];
+    sp = src->data[i] + j * src->linesize[i];
     dp = dst->data[dst_plane]
-                      + (yp + slice_start) * dst->linesize[dst_plane]
+                      + (yp + j) * dst->linesize[dst_plane]
                       + dst_offset;
-    ap = src->data[3] + (slice_start << vsub) * src->linesize[3];
-    dap = dst->data[3] + ((yp + slice_start) << vsub) * dst->linesize[3];
+    ap = src->data[3] + (j << vsub) * src->linesize[3];
+    dap = dst->data[3] + ((yp + j) << vsub) * dst->linesize[3];
 
-    for (j = j + slice_start; j < slice_end; j++) {
+    for (; j < jmax; j++) {
         k = FFMAX(-xp, 0);
         d = dp + (xp+k) * dst_step;
         s = sp + k;
@@ -552,24 +602,21 @@ static av_always_inline void blend_plane(AVFilterContext *ctx,
 
 static inline void alpha_composite(const AVFrame *src, const AVFrame *dst,
                                    int src_w, int src_h,
-                                   int dst_w, int dst_h,
+                                   int dst_w,
                                    int x, int y,
-                                   int jobnr, int nb_jobs)
+                                   int slice_start, int slice_end)
 {
     uint8_t alpha;          ///< the amount of overlay to blend on to main
     uint8_t *s, *sa, *d, *da;
     int i, imax, j, jmax;
-    int slice_start, slice_end;
 
-    imax = FFMIN(-y + dst_h, src_h);
-    slice_start = (imax * jobnr) / nb_jobs;
-    slice_end = ((imax * (jobnr+1)) / nb_jobs);
+    i = FFMAX(slice_start - y, 0);
+    imax = FFMIN(slice_end - y, src_h);
 
-    i = FFMAX(-y, 0);
-    sa = src->data[3] + (i + slice_start) * src->linesize[3];
-    da = dst->data[3] + (y + i + slice_start) * dst->linesize[3];
+    sa = src->data[3] + i       * src->linesize[3];
+    da = dst->data[3] + (y + i) * dst->linesize[3];
 
-    for (i = i + slice_start; i < slice_end; i++) {
+    for (; i < imax; i++) {
         j = FFMAX(-x, 0);
         s = sa + j;
         d = da + x+j;
@@ -604,26 +651,25 @@ static av_always_inline void blend_slice_yuv(AVFilterContext *ctx,
                                              int main_has_alpha,
                                              int x, int y,
                                              int is_straight,
-                                             int jobnr, int nb_jobs)
+                                             int slice_start, int slice_end)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
-    const int dst_h = dst->height;
 
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 0, 0,       0, x, y, main_has_alpha,
                 s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 1,
-                jobnr, nb_jobs);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
+                slice_start, slice_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 1, hsub, vsub, x, y, main_has_alpha,
                 s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 1,
-                jobnr, nb_jobs);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
+                slice_start, slice_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 2, hsub, vsub, x, y, main_has_alpha,
                 s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 1,
-                jobnr, nb_jobs);
+                slice_start, slice_end);
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, jobnr, nb_jobs);
+        alpha_composite(src, dst, src_w, src_h, dst_w, x, y, slice_start, slice_end);
 }
 
 static av_always_inline void blend_slice_planar_rgb(AVFilterContext *ctx,
@@ -632,187 +678,186 @@ static av_always_inline void blend_slice_planar_rgb(AVFilterContext *ctx,
                                                     int main_has_alpha,
                                                     int x, int y,
                                                     int is_straight,
-                                                    int jobnr,
-                                                    int nb_jobs)
+                                                    int slice_start,
+                                                    int slice_end)
 {
     OverlayContext *s = ctx->priv;
     const int src_w = src->width;
     const int src_h = src->height;
     const int dst_w = dst->width;
-    const int dst_h = dst->height;
 
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 0, 0,       0, x, y, main_has_alpha,
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 0, 0,       0, x, y, main_has_alpha,
                 s->main_desc->comp[1].plane, s->main_desc->comp[1].offset, s->main_desc->comp[1].step, is_straight, 0,
-                jobnr, nb_jobs);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 1, hsub, vsub, x, y, main_has_alpha,
+                slice_start, slice_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 1, hsub, vsub, x, y, main_has_alpha,
                 s->main_desc->comp[2].plane, s->main_desc->comp[2].offset, s->main_desc->comp[2].step, is_straight, 0,
-                jobnr, nb_jobs);
-    blend_plane(ctx, dst, src, src_w, src_h, dst_w, dst_h, 2, hsub, vsub, x, y, main_has_alpha,
+                slice_start, slice_end);
+    blend_plane(ctx, dst, src, src_w, src_h, dst_w, 2, hsub, vsub, x, y, main_has_alpha,
                 s->main_desc->comp[0].plane, s->main_desc->comp[0].offset, s->main_desc->comp[0].step, is_straight, 0,
-                jobnr, nb_jobs);
+                slice_start, slice_end);
 
     if (main_has_alpha)
-        alpha_composite(src, dst, src_w, src_h, dst_w, dst_h, x, y, jobnr, nb_jobs);
+        alpha_composite(src, dst, src_w, src_h, dst_w, x, y, slice_start, slice_end);
 }
 
-static int blend_slice_yuv420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, 0, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 1, 0, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuva420(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva420(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, 1, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 1, 1, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuv422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, 0, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 0, 0, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuva422(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva422(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, 1, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 0, 1, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuv444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 0, 0, 0, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuva444(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva444(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 0, 0, 1, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_gbrp(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_gbrp(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                             int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_planar_rgb(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_gbrap(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_gbrap(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                              int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_planar_rgb(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_yuv420_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                  int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, 0, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 1, 0, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_yuva420_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva420_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                   int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 1, 1, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 1, 1, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_yuv422_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                  int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, 0, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 0, 0, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_yuva422_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva422_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                   int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 1, 0, 1, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 1, 0, 1, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_yuv444_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuv444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                  int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 0, 0, 0, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_yuva444_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_yuva444_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                   int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_yuv(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_yuv(ctx, dst, src, 0, 0, 1, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_gbrp_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_gbrp_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_planar_rgb(ctx, td->dst, td->src, 0, 0, 0, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_planar_rgb(ctx, dst, src, 0, 0, 0, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_gbrap_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_gbrap_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                 int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_planar_rgb(ctx, td->dst, td->src, 0, 0, 1, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_planar_rgb(ctx, dst, src, 0, 0, 1, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_rgb(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_rgb(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                            int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_packed_rgb(ctx, td->dst, td->src, 0, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_packed_rgb(ctx, dst, src, 0, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_rgba(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_rgba(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                             int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_packed_rgb(ctx, td->dst, td->src, 1, s->x, s->y, 1, jobnr, nb_jobs);
-    return 0;
+    blend_slice_packed_rgb(ctx, dst, src, 1, x, y, 1, slice_start, slice_end);
 }
 
-static int blend_slice_rgb_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_rgb_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                               int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_packed_rgb(ctx, td->dst, td->src, 0, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_packed_rgb(ctx, dst, src, 0, x, y, 0, slice_start, slice_end);
 }
 
-static int blend_slice_rgba_pm(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+static void blend_slice_rgba_pm(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                                int x, int y, int slice_start, int slice_end)
 {
-    OverlayContext *s = ctx->priv;
-    ThreadData *td = arg;
-    blend_slice_packed_rgb(ctx, td->dst, td->src, 1, s->x, s->y, 0, jobnr, nb_jobs);
-    return 0;
+    blend_slice_packed_rgb(ctx, dst, src, 1, x, y, 0, slice_start, slice_end);
+}
+
+/* C versions of the blend_row functions, for straight alpha on a main
+ * picture without alpha; they leave the last pixel of the row to the
+ * generic code, which handles the right edge of the overlay. They skip the
+ * per pixel subsampling, edge and alpha mode checks of the generic loop;
+ * the SSE4 versions replace them when available. */
+static int blend_row_44_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    int x;
+
+    for (x = 0; x < w - 1; x++)
+        d[x] = FAST_DIV255(d[x] * (255 - a[x]) + s[x] * a[x]);
+    return FFMAX(w - 1, 0);
+}
+
+static int blend_row_20_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    int x;
+
+    for (x = 0; x < w - 1; x++) {
+        int alpha = (a[2 * x] + a[2 * x + alinesize] +
+                     a[2 * x + 1] + a[2 * x + alinesize + 1]) >> 2;
+        d[x] = FAST_DIV255(d[x] * (255 - alpha) + s[x] * alpha);
+    }
+    return FFMAX(w - 1, 0);
+}
+
+static int blend_row_22_c(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
+                          int w, ptrdiff_t alinesize)
+{
+    int x;
+
+    for (x = 0; x < w - 1; x++) {
+        int alpha = (a[2 * x] + ((a[2 * x] + a[2 * x + 1]) >> 1)) >> 1;
+        d[x] = FAST_DIV255(d[x] * (255 - alpha) + s[x] * alpha);
+    }
+    return FFMAX(w - 1, 0);
 }
 
 static int config_input_main(AVFilterLink *inlink)
@@ -920,6 +965,25 @@ static int config_input_main(AVFilterLink *inlink)
     }
 
 end:
+    if (!s->alpha_format && !s->main_has_alpha) {
+        switch (s->format) {
+        case OVERLAY_FORMAT_YUV444:
+        case OVERLAY_FORMAT_GBRP:
+            s->blend_row[0] = blend_row_44_c;
+            s->blend_row[1] = blend_row_44_c;
+            s->blend_row[2] = blend_row_44_c;
+            break;
+        case OVERLAY_FORMAT_YUV420:
+        case OVERLAY_FORMAT_YUV422:
+            if (pix_desc->comp[1].step != 1)
+                break;
+            s->blend_row[0] = blend_row_44_c;
+            s->blend_row[1] = s->vsub ? blend_row_20_c : blend_row_22_c;
+            s->blend_row[2] = s->vsub ? blend_row_20_c : blend_row_22_c;
+            break;
+        }
+    }
+
     if (ARCH_X86)
         ff_overlay_init_x86(s, s->format, inlink->format,
                             s->alpha_format, s->main_has_alpha);
@@ -927,19 +991,54 @@ end:
     return 0;
 }
 
+static int blend_slice_layers(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int h = td->y_end - td->y_start;
+    const int align = ~((1 << s->vsub) - 1);
+    const int slice_start = td->y_start + ((h *  jobnr     / nb_jobs) & align);
+    const int slice_end   = jobnr + 1 == nb_jobs ? td->y_end :
+                            td->y_start + ((h * (jobnr + 1) / nb_jobs) & align);
+    int i;
+
+    /* every job composites all the layers, in order, into its own band of
+     * rows, so no intermediate frame is needed and the result is the same
+     * as for a chain of two-input overlays */
+    for (i = 0; i < s->nb_layers; i++) {
+        OverlayLayer *layer = &s->layers[i];
+
+        if (layer->frame)
+            s->blend_slice(ctx, td->dst, layer->frame, layer->x, layer->y,
+                           slice_start, slice_end);
+    }
+    return 0;
+}
+
 static int do_blend(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
-    AVFrame *mainpic, *second;
+    AVFrame *mainpic;
     OverlayContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
-    int ret;
+    ThreadData td;
+    int i, ret;
 
-    ret = ff_framesync_dualinput_get_writable(fs, &mainpic, &second);
-    if (ret < 0)
+    if ((ret = ff_framesync_get_frame(fs, MAIN, &mainpic, 1)) < 0)
+        return ret;
+    for (i = 0; i < s->nb_layers; i++) {
+        if ((ret = ff_framesync_get_frame(fs, OVERLAY + i, &s->layers[i].frame, 0)) < 0) {
+            av_frame_free(&mainpic);
+            return ret;
+        }
+        if (ctx->is_disabled)
+            s->layers[i].frame = NULL;
+    }
+    mainpic->pts = av_rescale_q(fs->pts, fs->time_base, ctx->outputs[0]->time_base);
+    if ((ret = ff_inlink_make_frame_writable(inlink, &mainpic)) < 0) {
+        av_frame_free(&mainpic);
         return ret;
-    if (!second)
-        return ff_filter_frame(ctx->outputs[0], mainpic);
+    }
 
     if (s->eval_mode == EVAL_MODE_FRAME) {
         int64_t pos = mainpic->pkt_pos;
@@ -949,33 +1048,77 @@ static int do_blend(FFFrameSync *fs)
             NAN : mainpic->pts * av_q2d(inlink->time_base);
         s->var_values[VAR_POS] = pos == -1 ? NAN : pos;
 
-        s->var_values[VAR_OVERLAY_W] = s->var_values[VAR_OW] = second->width;
-        s->var_values[VAR_OVERLAY_H] = s->var_values[VAR_OH] = second->height;
         s->var_values[VAR_MAIN_W   ] = s->var_values[VAR_MW] = mainpic->width;
         s->var_values[VAR_MAIN_H   ] = s->var_values[VAR_MH] = mainpic->height;
-
-        eval_expr(ctx);
-        av_log(ctx, AV_LOG_DEBUG, "n:%f t:%f pos:%f x:%f xi:%d y:%f yi:%d\n",
-               s->var_values[VAR_N], s->var_values[VAR_T], s->var_values[VAR_POS],
-               s->var_values[VAR_X], s->x,
-               s->var_values[VAR_Y], s->y);
     }
 
-    if (s->x < mainpic->width  && s->x + second->width  >= 0 ||
-        s->y < mainpic->height && s->y + second->height >= 0) {
-        ThreadData td;
+    td.dst     = mainpic;
+    td.y_start = mainpic->height;
+    td.y_end   = 0;
+    for (i = 0; i < s->nb_layers; i++) {
+        OverlayLayer *layer = &s->layers[i];
+        const AVFrame *second = layer->frame;
+
+        if (!second)
+            continue;
+
+        if (s->eval_mode == EVAL_MODE_FRAME) {
+            s->var_values[VAR_OVERLAY_W] = s->var_values[VAR_OW] = second->width;
+            s->var_values[VAR_OVERLAY_H] = s->var_values[VAR_OH] = second->height;
+
+            eval_expr(ctx, layer);
+            av_log(ctx, AV_LOG_DEBUG, "layer:%d n:%f t:%f pos:%f x:%f xi:%d y:%f yi:%d\n", i,
+                   s->var_values[VAR_N], s->var_values[VAR_T], s->var_values[VAR_POS],
+                   s->var_values[VAR_X], layer->x,
+                   s->var_values[VAR_Y], layer->y);
+        }
 
-        td.dst = mainpic;
-        td.src = second;
-        ctx->internal->execute(ctx, s->blend_slice, &td, NULL, FFMIN(FFMIN(mainpic->height - s->y, second->height),
-                                                                     ff_filter_get_nb_threads(ctx)));
+        if (layer->x >= mainpic->width  || layer->x + second->width  <= 0 ||
+            layer->y >= mainpic->height || layer->y + second->height <= 0) {
+            layer->frame = NULL;
+            continue;
+        }
+        td.y_start = FFMIN(td.y_start, FFMAX(layer->y, 0));
+        td.y_end   = FFMAX(td.y_end,   FFMIN(layer->y + second->height, mainpic->height));
     }
+
+    if (td.y_start < td.y_end)
+        ctx->internal->execute(ctx, blend_slice_layers, &td, NULL,
+                               FFMIN(AV_CEIL_RSHIFT(td.y_end - td.y_start, s->vsub),
+                                     ff_filter_get_nb_threads(ctx)));
     return ff_filter_frame(ctx->outputs[0], mainpic);
 }
 
 static av_cold int init(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
+    int i, ret;
+
+    s->layers = av_calloc(s->nb_inputs - 1, sizeof(*s->layers));
+    if (!s->layers)
+        return AVERROR(ENOMEM);
+    s->nb_layers = s->nb_inputs - 1;
+
+    for (i = 0; i < s->nb_inputs; i++) {
+        AVFilterPad pad = { 0 };
+
+        pad.type = AVMEDIA_TYPE_VIDEO;
+        if (i == MAIN) {
+            pad.name         = av_strdup("main");
+            pad.config_props = config_input_main;
+        } else {
+            pad.name         = i == OVERLAY ? av_strdup("overlay") :
+                                              av_asprintf("overlay%d", i);
+            pad.config_props = config_input_overlay;
+        }
+        if (!pad.name)
+            return AVERROR(ENOMEM);
+
+        if ((ret = ff_insert_inpad(ctx, i, &pad)) < 0) {
+            av_freep(&pad.name);
+            return ret;
+        }
+    }
 
     s->fs.on_event = do_blend;
     return 0;
@@ -1014,25 +1157,12 @@ static const AVOption overlay_options[] = {
     { "alpha", "alpha format", OFFSET(alpha_format), AV_OPT_TYPE_INT, {.i64=0}, 0, 1, FLAGS, "alpha_format" },
         { "straight",      "", 0, AV_OPT_TYPE_CONST, {.i64=0}, .flags = FLAGS, .unit = "alpha_format" },
         { "premultiplied", "", 0, AV_OPT_TYPE_CONST, {.i64=1}, .flags = FLAGS, .unit = "alpha_format" },
+    { "inputs", "set number of inputs", OFFSET(nb_inputs), AV_OPT_TYPE_INT, {.i64=2}, 2, INT_MAX, .flags = FLAGS },
     { NULL }
 };
 
 FRAMESYNC_DEFINE_CLASS(overlay, OverlayContext, fs);
 
-static const AVFilterPad avfilter_vf_overlay_inputs[] = {
-    {
-        .name         = "main",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .config_props = config_input_main,
-    },
-    {
-        .name         = "overlay",
-        .type         = AVMEDIA_TYPE_VIDEO,
-        .config_props = config_input_overlay,
-    },
-    { NULL }
-};
-
 static const AVFilterPad avfilter_vf_overlay_outputs[] = {
     {
         .name          = "default",
@@ -1053,8 +1183,9 @@ AVFilter ff_vf_overlay = {
     .query_formats = query_formats,
     .activate      = activate,
     .process_command = process_command,
-    .inputs        = avfilter_vf_overlay_inputs,
+    .inputs        = NULL,
     .outputs       = avfilter_vf_overlay_outputs,
     .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
-                     AVFILTER_FLAG_SLICE_THREADS,
+                     AVFILTER_FLAG_SLICE_THREADS |
+                     AVFILTER_FLAG_DYNAMIC_INPUTS,
 };
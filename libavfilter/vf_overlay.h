@@ -49,9 +49,17 @@ enum OverlayFormat {
     OVERLAY_FORMAT_NB
 };
 
+typedef struct OverlayLayer {
+    int x, y;                   ///< position of overlaid picture
+    AVExpr *x_pexpr, *y_pexpr;
+    AVFrame *frame;             ///< picture to blend, NULL if not visible
+} OverlayLayer;
+
 typedef struct OverlayContext {
     const AVClass *class;
-    int x, y;                   ///< position of overlaid picture
+    int nb_inputs;
+    OverlayLayer *layers;       ///< one entry per overlay input
+    int nb_layers;
 
     uint8_t main_is_packed_rgb;
     uint8_t main_rgba_map[4];
@@ -73,11 +81,10 @@ typedef struct OverlayContext {
     double var_values[VAR_VARS_NB];
     char *x_expr, *y_expr;
 
-    AVExpr *x_pexpr, *y_pexpr;
-
     int (*blend_row[4])(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a, int w,
                         ptrdiff_t alinesize);
-    int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+    void (*blend_slice)(AVFilterContext *ctx, AVFrame *dst, const AVFrame *src,
+                        int x, int y, int slice_start, int slice_end);
 } OverlayContext;
 
 void ff_overlay_init_x86(OverlayContext *s, int format, int pix_format,
@@ -405,7 +405,7 @@ static inline unsigned color_hash(uint32_t color)
 /**
  * Locate the color in the hash table and increment its counter.
  */
-static int color_inc(struct hist_node *hist, uint32_t color)
+static int color_inc(struct hist_node *hist, uint32_t color, int n)
 {
     int i;
     const unsigned hash = color_hash(color);
@@ -415,7 +415,7 @@ static int color_inc(struct hist_node *hist, uint32_t color)
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color) {
-            e->count++;
+            e->count += n;
             return 0;
         }
     }
@@ -425,26 +425,32 @@ static int color_inc(struct hist_node *hist, uint32_t color)
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->count = 1;
+    e->count = n;
     return 1;
 }
 
 /**
  * Update histogram when pixels differ from previous frame.
+ * Runs of identical pixels are accounted for in a single lookup.
  */
 static int update_histogram_diff(struct hist_node *hist,
                                  const AVFrame *f1, const AVFrame *f2)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    int x, y, run, ret, nb_diff_colors = 0;
 
     for (y = 0; y < f1->height; y++) {
         const uint32_t *p = (const uint32_t *)(f1->data[0] + y*f1->linesize[0]);
         const uint32_t *q = (const uint32_t *)(f2->data[0] + y*f2->linesize[0]);
 
-        for (x = 0; x < f1->width; x++) {
-            if (p[x] == q[x])
+        for (x = 0; x < f1->width; x += run) {
+            const uint32_t color = p[x];
+
+            run = 1;
+            if (color == q[x])
                 continue;
-            ret = color_inc(hist, p[x]);
+            while (x + run < f1->width && p[x + run] == color && q[x + run] != color)
+                run++;
+            ret = color_inc(hist, color, run);
             if (ret < 0)
                 return ret;
             nb_diff_colors += ret;
@@ -455,16 +461,21 @@ static int update_histogram_diff(struct hist_node *hist,
 
 /**
  * Simple histogram of the frame.
+ * Runs of identical pixels are accounted for in a single lookup.
  */
 static int update_histogram_frame(struct hist_node *hist, const AVFrame *f)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    int x, y, run, ret, nb_diff_colors = 0;
 
     for (y = 0; y < f->height; y++) {
         const uint32_t *p = (const uint32_t *)(f->data[0] + y*f->linesize[0]);
 
-        for (x = 0; x < f->width; x++) {
-            ret = color_inc(hist, p[x]);
+        for (x = 0; x < f->width; x += run) {
+            const uint32_t color = p[x];
+
+            for (run = 1; x + run < f->width && p[x + run] == color; run++)
+                ;
+            ret = color_inc(hist, color, run);
             if (ret < 0)
                 return ret;
             nb_diff_colors += ret;
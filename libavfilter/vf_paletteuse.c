@@ -46,6 +46,7 @@ enum color_search_method {
     COLOR_SEARCH_NNS_ITERATIVE,
     COLOR_SEARCH_NNS_RECURSIVE,
     COLOR_SEARCH_BRUTEFORCE,
+    COLOR_SEARCH_LUT,
     NB_COLOR_SEARCHES
 };
 
@@ -75,15 +76,32 @@ struct cache_node {
     int nb_entries;
 };
 
+#define LUT_BITS 5
+#define LUT_CELLS (1<<(3*LUT_BITS))
+
+/* Every cell of the RGB cube lists the palette entries that can be the nearest
+ * color of at least one point of the cell. */
+struct color_lut {
+    int offsets[LUT_CELLS + 1];
+    uint8_t *entries;
+    unsigned entries_size;
+    uint16_t min_dist2[3][1<<LUT_BITS][AVPALETTE_COUNT];
+    uint16_t max_dist2[3][1<<LUT_BITS][AVPALETTE_COUNT];
+};
+
 struct PaletteUseContext;
 
-typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
+typedef int (*set_frame_func)(struct PaletteUseContext *s, struct cache_node *cache,
+                              AVFrame *out, AVFrame *in,
                               int x_start, int y_start, int width, int height);
 
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFFrameSync fs;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct cache_node *cache;               /* lookup cache, one per slice thread, NULL if unused */
+    int nb_jobs;
+    int *jobs_ret;
+    struct color_lut *lut;                  /* nearest color candidates for the lut search */
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
     uint32_t palette[AVPALETTE_COUNT];
     int transparency_index; /* index in the palette of transparency. -1 if there is no transparency in the palette. */
@@ -127,6 +145,7 @@ static const AVOption paletteuse_options[] = {
         { "nns_iterative", "iterative search",             0, AV_OPT_TYPE_CONST, {.i64=COLOR_SEARCH_NNS_ITERATIVE}, INT_MIN, INT_MAX, FLAGS, "search" },
         { "nns_recursive", "recursive search",             0, AV_OPT_TYPE_CONST, {.i64=COLOR_SEARCH_NNS_RECURSIVE}, INT_MIN, INT_MAX, FLAGS, "search" },
         { "bruteforce",    "brute-force into the palette", 0, AV_OPT_TYPE_CONST, {.i64=COLOR_SEARCH_BRUTEFORCE},    INT_MIN, INT_MAX, FLAGS, "search" },
+        { "lut",           "lookup table of candidates",   0, AV_OPT_TYPE_CONST, {.i64=COLOR_SEARCH_LUT},           INT_MIN, INT_MAX, FLAGS, "search" },
     { "mean_err", "compute and print mean error", OFFSET(calc_mean_err), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { "debug_accuracy", "test color search accuracy", OFFSET(debug_accuracy), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { NULL }
@@ -327,18 +346,50 @@ end:
     return root[best_node_id].palette_id;
 }
 
-#define COLORMAP_NEAREST(search, palette, root, target, trans_thresh)                                    \
+static av_always_inline uint8_t colormap_nearest_lut(const struct color_lut *lut, const uint32_t *palette,
+                                                     const uint8_t *target, const int trans_thresh)
+{
+    int i, pal_id = -1, min_dist = INT_MAX;
+    const int shift = 8 - LUT_BITS;
+    const int cell = (target[1] >> shift) << (2*LUT_BITS)
+                   | (target[2] >> shift) <<    LUT_BITS
+                   | (target[3] >> shift);
+
+    if (target[0] < trans_thresh)
+        return colormap_nearest_bruteforce(palette, target, trans_thresh);
+
+    /* candidates are in palette order, so ties are resolved like the
+     * brute-force search */
+    for (i = lut->offsets[cell]; i < lut->offsets[cell + 1]; i++) {
+        const int id = lut->entries[i];
+        const uint32_t c = palette[id];
+        const int dr = (int)(c >> 16 & 0xff) - target[1];
+        const int dg = (int)(c >>  8 & 0xff) - target[2];
+        const int db = (int)(c       & 0xff) - target[3];
+        const int d = dr*dr + dg*dg + db*db;
+        if (d < min_dist) {
+            pal_id = id;
+            min_dist = d;
+        }
+    }
+    return pal_id;
+}
+
+#define COLORMAP_NEAREST(search, palette, root, lut, target, trans_thresh)                               \
     search == COLOR_SEARCH_NNS_ITERATIVE ? colormap_nearest_iterative(root, target, trans_thresh) :      \
     search == COLOR_SEARCH_NNS_RECURSIVE ? colormap_nearest_recursive(root, target, trans_thresh) :      \
+    search == COLOR_SEARCH_LUT           ? colormap_nearest_lut(lut, palette, target, trans_thresh) :    \
                                            colormap_nearest_bruteforce(palette, target, trans_thresh)
 
 /**
  * Check if the requested color is in the cache already. If not, find it in the
- * color tree and cache it.
+ * color tree and cache it. The lookup table search is fast enough to bypass
+ * the cache.
  * Note: a, r, g, and b are the components of color, but are passed as well to avoid
  * recomputing them (they are generally computed by the caller for other uses).
  */
-static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
+static av_always_inline int color_get(PaletteUseContext *s, struct cache_node *cache,
+                                      uint32_t color,
                                       uint8_t a, uint8_t r, uint8_t g, uint8_t b,
                                       const enum color_search_method search_method)
 {
@@ -348,7 +399,7 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     const uint8_t ghash = g & ((1<<NBITS)-1);
     const uint8_t bhash = b & ((1<<NBITS)-1);
     const unsigned hash = rhash<<(NBITS*2) | ghash<<NBITS | bhash;
-    struct cache_node *node = &s->cache[hash];
+    struct cache_node *node = &cache[hash];
     struct cached_color *e;
 
     // first, check for transparency
@@ -356,6 +407,11 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
         return s->transparency_index;
     }
 
+    if (search_method == COLOR_SEARCH_LUT)
+        return colormap_nearest_lut(s->lut, s->palette, argb_elts, s->trans_thresh);
+    if (search_method == COLOR_SEARCH_BRUTEFORCE)
+        return colormap_nearest_bruteforce(s->palette, argb_elts, s->trans_thresh);
+
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color)
@@ -367,12 +423,12 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->pal_entry = COLORMAP_NEAREST(search_method, s->palette, s->map, argb_elts, s->trans_thresh);
+    e->pal_entry = COLORMAP_NEAREST(search_method, s->palette, s->map, s->lut, argb_elts, s->trans_thresh);
 
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(PaletteUseContext *s,
+static av_always_inline int get_dst_color_err(PaletteUseContext *s, struct cache_node *cache,
                                               uint32_t c, int *er, int *eg, int *eb,
                                               const enum color_search_method search_method)
 {
@@ -381,7 +437,7 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     const uint8_t g = c >>  8 & 0xff;
     const uint8_t b = c       & 0xff;
     uint32_t dstc;
-    const int dstx = color_get(s, c, a, r, g, b, search_method);
+    const int dstx = color_get(s, cache, c, a, r, g, b, search_method);
     if (dstx < 0)
         return dstx;
     dstc = s->palette[dstx];
@@ -391,7 +447,8 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     return dstx;
 }
 
-static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
+static av_always_inline int set_frame(PaletteUseContext *s, struct cache_node *cache,
+                                      AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
                                       enum dithering_mode dither,
                                       const enum color_search_method search_method)
@@ -418,7 +475,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = av_clip_uint8(r8 + d);
                 const uint8_t g = av_clip_uint8(g8 + d);
                 const uint8_t b = av_clip_uint8(b8 + d);
-                const int color = color_get(s, src[x], a8, r, g, b, search_method);
+                const int color = color_get(s, cache, src[x], a8, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -426,7 +483,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_HECKBERT) {
                 const int right = x < w - 1, down = y < h - 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -438,7 +495,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_FLOYD_STEINBERG) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -452,7 +509,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
             } else if (dither == DITHERING_SIERRA2) {
                 const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
                 const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -471,7 +528,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_SIERRA2_4A) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -486,7 +543,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = src[x] >> 16 & 0xff;
                 const uint8_t g = src[x] >>  8 & 0xff;
                 const uint8_t b = src[x]       & 0xff;
-                const int color = color_get(s, src[x], a, r, g, b, search_method);
+                const int color = color_get(s, cache, src[x], a, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -554,7 +611,8 @@ static int disp_tree(const struct color_node *node, const char *fname)
     return 0;
 }
 
-static int debug_accuracy(const struct color_node *node, const uint32_t *palette, const int trans_thresh,
+static int debug_accuracy(const struct color_node *node, const uint32_t *palette,
+                          const struct color_lut *lut, const int trans_thresh,
                           const enum color_search_method search_method)
 {
     int r, g, b, ret = 0;
@@ -563,7 +621,7 @@ static int debug_accuracy(const struct color_node *node, const uint32_t *palette
         for (g = 0; g < 256; g++) {
             for (b = 0; b < 256; b++) {
                 const uint8_t argb[] = {0xff, r, g, b};
-                const int r1 = COLORMAP_NEAREST(search_method, palette, node, argb, trans_thresh);
+                const int r1 = COLORMAP_NEAREST(search_method, palette, node, lut, argb, trans_thresh);
                 const int r2 = colormap_nearest_bruteforce(palette, argb, trans_thresh);
                 if (r1 != r2) {
                     const uint32_t c1 = palette[r1];
@@ -729,7 +787,73 @@ static int cmp_pal_entry(const void *a, const void *b)
     return c1 - c2;
 }
 
-static void load_colormap(PaletteUseContext *s)
+/**
+ * Build the candidates list of each cell: an entry is kept if its distance to
+ * the closest point of the cell is not larger than the smallest distance any
+ * entry has to the farthest point of the cell.
+ */
+static int load_lut(PaletteUseContext *s)
+{
+    struct color_lut *lut = s->lut;
+    const int cell_size = 1 << (8 - LUT_BITS);
+    int i, j, r, g, b, nb_ids = 0, nb_entries = 0;
+    uint8_t ids[AVPALETTE_COUNT];
+
+    for (i = 0; i < AVPALETTE_COUNT; i++) {
+        const uint32_t c = s->palette[i];
+
+        if (c >> 24 < s->trans_thresh)
+            continue;
+        // same color as the previous entry: it will never be selected
+        if (nb_ids && !((c ^ s->palette[ids[nb_ids - 1]]) & 0xffffff))
+            continue;
+        for (j = 0; j < 3; j++) {
+            const int v = c >> (16 - 8*j) & 0xff;
+            int k;
+
+            for (k = 0; k < 1<<LUT_BITS; k++) {
+                const int lo = k * cell_size, hi = lo + cell_size - 1;
+                const int dmin = v < lo ? lo - v : v > hi ? v - hi : 0;
+                const int dmax = FFMAX(v - lo, hi - v);
+                lut->min_dist2[j][k][nb_ids] = dmin * dmin;
+                lut->max_dist2[j][k][nb_ids] = dmax * dmax;
+            }
+        }
+        ids[nb_ids++] = i;
+    }
+
+    for (r = 0; r < 1<<LUT_BITS; r++) {
+        for (g = 0; g < 1<<LUT_BITS; g++) {
+            for (b = 0; b < 1<<LUT_BITS; b++) {
+                const int cell = r<<(2*LUT_BITS) | g<<LUT_BITS | b;
+                const uint16_t *minr = lut->min_dist2[0][r], *maxr = lut->max_dist2[0][r];
+                const uint16_t *ming = lut->min_dist2[1][g], *maxg = lut->max_dist2[1][g];
+                const uint16_t *minb = lut->min_dist2[2][b], *maxb = lut->max_dist2[2][b];
+                int max_dist = INT_MAX;
+
+                if (nb_entries + nb_ids > lut->entries_size) {
+                    uint8_t *entries = av_fast_realloc(lut->entries, &lut->entries_size,
+                                                       nb_entries + nb_ids);
+                    if (!entries)
+                        return AVERROR(ENOMEM);
+                    lut->entries = entries;
+                }
+
+                for (i = 0; i < nb_ids; i++)
+                    max_dist = FFMIN(max_dist, maxr[i] + maxg[i] + maxb[i]);
+
+                lut->offsets[cell] = nb_entries;
+                for (i = 0; i < nb_ids; i++)
+                    if (minr[i] + ming[i] + minb[i] <= max_dist)
+                        lut->entries[nb_entries++] = ids[i];
+            }
+        }
+    }
+    lut->offsets[LUT_CELLS] = nb_entries;
+    return 0;
+}
+
+static int load_colormap(PaletteUseContext *s)
 {
     int i, nb_used = 0;
     uint8_t color_used[AVPALETTE_COUNT] = {0};
@@ -766,13 +890,20 @@ static void load_colormap(PaletteUseContext *s)
 
     colormap_insert(s->map, color_used, &nb_used, s->palette, s->trans_thresh, &box);
 
+    if (s->color_search_method == COLOR_SEARCH_LUT) {
+        int ret = load_lut(s);
+        if (ret < 0)
+            return ret;
+    }
+
     if (s->dot_filename)
         disp_tree(s->map, s->dot_filename);
 
     if (s->debug_accuracy) {
-        if (!debug_accuracy(s->map, s->palette, s->trans_thresh, s->color_search_method))
+        if (!debug_accuracy(s->map, s->palette, s->lut, s->trans_thresh, s->color_search_method))
             av_log(NULL, AV_LOG_INFO, "Accuracy check passed\n");
     }
+    return 0;
 }
 
 static void debug_mean_error(PaletteUseContext *s, const AVFrame *in1,
@@ -894,11 +1025,28 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x, y, w, h;
+} ThreadData;
+
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = (td->h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (td->h * (jobnr + 1)) / nb_jobs;
+
+    return s->set_frame(s, s->cache ? s->cache + jobnr * CACHE_SIZE : NULL, td->out, td->in,
+                        td->x, td->y + slice_start, td->w, slice_end - slice_start);
+}
+
 static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
 {
-    int x, y, w, h, ret;
+    int i, x, y, w, h, ret, nb_jobs;
     AVFilterContext *ctx = inlink->dst;
     PaletteUseContext *s = ctx->priv;
+    ThreadData td;
     AVFilterLink *outlink = inlink->dst->outputs[0];
 
     AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
@@ -926,7 +1074,17 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    ret = s->set_frame(s, out, in, x, y, w, h);
+    /* error diffusion needs the rows to be processed in order */
+    nb_jobs = FFMIN(h, s->nb_jobs);
+    td.in  = in;
+    td.out = out;
+    td.x = x;
+    td.y = y;
+    td.w = w;
+    td.h = h;
+    ctx->internal->execute(ctx, set_frame_slice, &td, s->jobs_ret, nb_jobs);
+    for (ret = i = 0; i < nb_jobs && ret >= 0; i++)
+        ret = s->jobs_ret[i];
     if (ret < 0) {
         av_frame_free(&out);
         *outf = NULL;
@@ -940,9 +1098,21 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     return 0;
 }
 
+static void free_caches(PaletteUseContext *s)
+{
+    int i;
+
+    if (!s->cache)
+        return;
+    for (i = 0; i < s->nb_jobs * CACHE_SIZE; i++) {
+        av_freep(&s->cache[i].entries);
+        s->cache[i].nb_entries = 0;
+    }
+}
+
 static int config_output(AVFilterLink *outlink)
 {
-    int ret;
+    int ret, use_cache;
     AVFilterContext *ctx = outlink->src;
     PaletteUseContext *s = ctx->priv;
 
@@ -959,6 +1129,28 @@ static int config_output(AVFilterLink *outlink)
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_framesync_configure(&s->fs)) < 0)
         return ret;
+
+    free_caches(s);
+    av_freep(&s->cache);
+    av_freep(&s->jobs_ret);
+
+    /* only the kd-tree searches use the cache. It is keyed on the source
+     * color and keeps the first match, so with bayer dithering its output
+     * depends on the scan order, like error diffusion. */
+    use_cache = s->color_search_method == COLOR_SEARCH_NNS_ITERATIVE ||
+                s->color_search_method == COLOR_SEARCH_NNS_RECURSIVE;
+    if (s->dither == DITHERING_NONE || (s->dither == DITHERING_BAYER && !use_cache))
+        s->nb_jobs = ff_filter_get_nb_threads(ctx);
+    else
+        s->nb_jobs = 1;
+    s->jobs_ret = av_mallocz_array(s->nb_jobs, sizeof(*s->jobs_ret));
+    if (!s->jobs_ret)
+        return AVERROR(ENOMEM);
+    if (use_cache) {
+        s->cache = av_mallocz_array(s->nb_jobs, CACHE_SIZE * sizeof(*s->cache));
+        if (!s->cache)
+            return AVERROR(ENOMEM);
+    }
     return 0;
 }
 
@@ -977,9 +1169,9 @@ static int config_input_palette(AVFilterLink *inlink)
     return 0;
 }
 
-static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
+static int load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
 {
-    int i, x, y;
+    int i, x, y, ret;
     const uint32_t *p = (const uint32_t *)palette_frame->data[0];
     const int p_linesize = palette_frame->linesize[0] >> 2;
 
@@ -988,9 +1180,7 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
     if (s->new) {
         memset(s->palette, 0, sizeof(s->palette));
         memset(s->map, 0, sizeof(s->map));
-        for (i = 0; i < CACHE_SIZE; i++)
-            av_freep(&s->cache[i].entries);
-        memset(s->cache, 0, sizeof(s->cache));
+        free_caches(s);
     }
 
     i = 0;
@@ -1005,10 +1195,13 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
         p += p_linesize;
     }
 
-    load_colormap(s);
+    ret = load_colormap(s);
+    if (ret < 0)
+        return ret;
 
     if (!s->new)
         s->palette_loaded = 1;
+    return 0;
 }
 
 static int load_apply_palette(FFFrameSync *fs)
@@ -1028,7 +1221,9 @@ static int load_apply_palette(FFFrameSync *fs)
         goto error;
     }
     if (!s->palette_loaded) {
-        load_palette(s, second);
+        ret = load_palette(s, second);
+        if (ret < 0)
+            goto error;
     }
     ret = apply_palette(inlink, master, &out);
     if (ret < 0)
@@ -1041,10 +1236,12 @@ error:
 }
 
 #define DEFINE_SET_FRAME(color_search, name, value)                             \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
+static int set_frame_##name(PaletteUseContext *s, struct cache_node *cache,     \
+                            AVFrame *out, AVFrame *in,                          \
                             int x_start, int y_start, int w, int h)             \
 {                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value, color_search);  \
+    return set_frame(s, cache, out, in, x_start, y_start, w, h,                 \
+                     value, color_search);                                      \
 }
 
 #define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
@@ -1058,6 +1255,7 @@ static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,
 DEFINE_SET_FRAME_COLOR_SEARCH(nns_iterative, COLOR_SEARCH_NNS_ITERATIVE)
 DEFINE_SET_FRAME_COLOR_SEARCH(nns_recursive, COLOR_SEARCH_NNS_RECURSIVE)
 DEFINE_SET_FRAME_COLOR_SEARCH(bruteforce,    COLOR_SEARCH_BRUTEFORCE)
+DEFINE_SET_FRAME_COLOR_SEARCH(lut,           COLOR_SEARCH_LUT)
 
 #define DITHERING_ENTRIES(color_search) {       \
     set_frame_##color_search##_none,            \
@@ -1072,6 +1270,7 @@ static const set_frame_func set_frame_lut[NB_COLOR_SEARCHES][NB_DITHERING] = {
     DITHERING_ENTRIES(nns_iterative),
     DITHERING_ENTRIES(nns_recursive),
     DITHERING_ENTRIES(bruteforce),
+    DITHERING_ENTRIES(lut),
 };
 
 static int dither_value(int p)
@@ -1096,6 +1295,12 @@ static av_cold int init(AVFilterContext *ctx)
             s->ordered_dither[i] = (dither_value(i) >> s->bayer_scale) - delta;
     }
 
+    if (s->color_search_method == COLOR_SEARCH_LUT) {
+        s->lut = av_mallocz(sizeof(*s->lut));
+        if (!s->lut)
+            return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
@@ -1107,12 +1312,15 @@ static int activate(AVFilterContext *ctx)
 
 static av_cold void uninit(AVFilterContext *ctx)
 {
-    int i;
     PaletteUseContext *s = ctx->priv;
 
     ff_framesync_uninit(&s->fs);
-    for (i = 0; i < CACHE_SIZE; i++)
-        av_freep(&s->cache[i].entries);
+    free_caches(s);
+    av_freep(&s->cache);
+    av_freep(&s->jobs_ret);
+    if (s->lut)
+        av_freep(&s->lut->entries);
+    av_freep(&s->lut);
     av_frame_free(&s->last_in);
     av_frame_free(&s->last_out);
 }
@@ -1149,4 +1357,5 @@ AVFilter ff_vf_paletteuse = {
     .inputs        = paletteuse_inputs,
     .outputs       = paletteuse_outputs,
     .priv_class    = &paletteuse_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -52,29 +52,41 @@ typedef struct SSIMContext {
     char *stats_file_str;
     int nb_components;
     int max;
+    int frame_step;
+    int line_step;
     uint64_t nb_frames;
+    uint64_t frame_count;
     double ssim[4], ssim_total;
     char comps[4];
     float coefs[4];
     uint8_t rgba_map[4];
     int planewidth[4];
     int planeheight[4];
-    int *temp;
+    uint8_t *temp;
+    size_t temp_size;
+    float *score[4];
     int is_rgb;
-    float (*ssim_plane)(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max);
+    void (*ssim_plane)(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, void *temp, int max,
+                       int y_start, int y_end, int y_step,
+                       float *score);
     SSIMDSPContext dsp;
 } SSIMContext;
 
+typedef struct ThreadData {
+    AVFrame *master, *ref;
+} ThreadData;
+
 #define OFFSET(x) offsetof(SSIMContext, x)
 #define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
 
 static const AVOption ssim_options[] = {
     {"stats_file", "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
     {"f",          "Set file where to store per-frame difference information", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    {"frame_step", "Set the interval between measured frames",                  OFFSET(frame_step),     AV_OPT_TYPE_INT,    {.i64=1},    1, INT_MAX, FLAGS },
+    {"line_step",  "Set the interval between measured rows of 4x4 blocks",     OFFSET(line_step),      AV_OPT_TYPE_INT,    {.i64=1},    1, INT_MAX, FLAGS },
     { NULL }
 };
 
@@ -221,60 +233,88 @@ static float ssim_endn_8bit(const int (*sum0)[4], const int (*sum1)[4], int widt
 
 #define SUM_LEN(w) (((w) >> 2) + 3)
 
-static float ssim_plane_16bit(SSIMDSPContext *dsp,
-                              uint8_t *main, int main_stride,
-                              uint8_t *ref, int ref_stride,
-                              int width, int height, void *temp,
-                              int max)
+/*
+ * Each SSIM value of line y uses the sums of the 4x4 block lines y - 1
+ * and y. Only the lines y_start, y_start + y_step, ... below y_end are
+ * measured, and their values are stored in score[y].
+ */
+static void ssim_plane_16bit(SSIMDSPContext *dsp,
+                             uint8_t *main, int main_stride,
+                             uint8_t *ref, int ref_stride,
+                             int width, void *temp, int max,
+                             int y_start, int y_end, int y_step,
+                             float *score)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = y_start - 1, y;
     int64_t (*sum0)[4] = temp;
     int64_t (*sum1)[4] = sum0 + SUM_LEN(width);
 
     width >>= 2;
-    height >>= 2;
 
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
+    for (y = y_start; y < y_end; y += y_step) {
+        for (z = FFMAX(z, y - 1); z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             ssim_4x4xn_16bit(&main[4 * z * main_stride], main_stride,
                              &ref[4 * z * ref_stride], ref_stride,
                              sum0, width);
         }
 
-        ssim += ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
+        score[y] = ssim_endn_16bit((const int64_t (*)[4])sum0, (const int64_t (*)[4])sum1, width - 1, max);
     }
-
-    return ssim / ((height - 1) * (width - 1));
 }
 
-static float ssim_plane(SSIMDSPContext *dsp,
-                        uint8_t *main, int main_stride,
-                        uint8_t *ref, int ref_stride,
-                        int width, int height, void *temp,
-                        int max)
+static void ssim_plane(SSIMDSPContext *dsp,
+                       uint8_t *main, int main_stride,
+                       uint8_t *ref, int ref_stride,
+                       int width, void *temp, int max,
+                       int y_start, int y_end, int y_step,
+                       float *score)
 {
-    int z = 0, y;
-    float ssim = 0.0;
+    int z = y_start - 1, y;
     int (*sum0)[4] = temp;
     int (*sum1)[4] = sum0 + SUM_LEN(width);
 
     width >>= 2;
-    height >>= 2;
 
-    for (y = 1; y < height; y++) {
-        for (; z <= y; z++) {
+    for (y = y_start; y < y_end; y += y_step) {
+        for (z = FFMAX(z, y - 1); z <= y; z++) {
             FFSWAP(void*, sum0, sum1);
             dsp->ssim_4x4_line(&main[4 * z * main_stride], main_stride,
                                &ref[4 * z * ref_stride], ref_stride,
                                sum0, width);
         }
 
-        ssim += dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
+        score[y] = dsp->ssim_end_line((const int (*)[4])sum0, (const int (*)[4])sum1, width - 1);
     }
+}
+
+static int ssim_lines(SSIMContext *s, int plane)
+{
+    int height = s->planeheight[plane] >> 2;
 
-    return ssim / ((height - 1) * (width - 1));
+    return height > 1 ? (height - 2) / s->line_step + 1 : 0;
+}
+
+static int ssim_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    SSIMContext *s = ctx->priv;
+    ThreadData *td = arg;
+    void *temp = s->temp + jobnr * s->temp_size;
+    int i;
+
+    for (i = 0; i < s->nb_components; i++) {
+        int lines = ssim_lines(s, i);
+        int start = (lines *  jobnr     ) / nb_jobs;
+        int end   = (lines * (jobnr + 1)) / nb_jobs;
+
+        s->ssim_plane(&s->dsp, td->master->data[i], td->master->linesize[i],
+                      td->ref->data[i], td->ref->linesize[i],
+                      s->planewidth[i], temp, s->max,
+                      1 + start * s->line_step, 1 + end * s->line_step, s->line_step,
+                      s->score[i]);
+    }
+
+    return 0;
 }
 
 static double ssim_db(double ssim, double weight)
@@ -288,23 +328,34 @@ static int do_ssim(FFFrameSync *fs)
     SSIMContext *s = ctx->priv;
     AVFrame *master, *ref;
     AVDictionary **metadata;
+    ThreadData td;
     float c[4], ssimv = 0.0;
-    int ret, i;
+    int ret, i, y;
 
     ret = ff_framesync_dualinput_get(fs, &master, &ref);
     if (ret < 0)
         return ret;
     if (!ref)
         return ff_filter_frame(ctx->outputs[0], master);
+    if (s->frame_count++ % s->frame_step)
+        return ff_filter_frame(ctx->outputs[0], master);
     metadata = &master->metadata;
 
     s->nb_frames++;
 
+    td.master = master;
+    td.ref = ref;
+    ctx->internal->execute(ctx, ssim_slice, &td, NULL,
+                           FFMIN(FFMAX(ssim_lines(s, 0), 1), ff_filter_get_nb_threads(ctx)));
+
+    /* sum the lines in order, so the result does not depend on the threads */
     for (i = 0; i < s->nb_components; i++) {
-        c[i] = s->ssim_plane(&s->dsp, master->data[i], master->linesize[i],
-                             ref->data[i], ref->linesize[i],
-                             s->planewidth[i], s->planeheight[i], s->temp,
-                             s->max);
+        int lines = ssim_lines(s, i);
+        float ssim = 0.0;
+
+        for (y = 0; y < lines; y++)
+            ssim += s->score[i][1 + y * s->line_step];
+        c[i] = ssim / (lines * ((s->planewidth[i] >> 2) - 1));
         ssimv += s->coefs[i] * c[i];
         s->ssim[i] += c[i];
     }
@@ -318,7 +369,7 @@ static int do_ssim(FFFrameSync *fs)
     set_meta(metadata, "lavfi.ssim.dB", 0, ssim_db(ssimv, 1.0));
 
     if (s->stats_file) {
-        fprintf(s->stats_file, "n:%"PRId64" ", s->nb_frames);
+        fprintf(s->stats_file, "n:%"PRId64" ", s->frame_count);
 
         for (i = 0; i < s->nb_components; i++) {
             int cidx = s->is_rgb ? s->rgba_map[i] : i;
@@ -410,9 +461,17 @@ static int config_input_ref(AVFilterLink *inlink)
     for (i = 0; i < s->nb_components; i++)
         s->coefs[i] = (double) s->planeheight[i] * s->planewidth[i] / sum;
 
-    s->temp = av_mallocz_array(2 * SUM_LEN(inlink->w), (desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    s->temp_size = 2 * SUM_LEN(inlink->w) * ((desc->comp[0].depth > 8) ? sizeof(int64_t[4]) : sizeof(int[4]));
+    av_freep(&s->temp);
+    s->temp = av_mallocz_array(ff_filter_get_nb_threads(ctx), s->temp_size);
     if (!s->temp)
         return AVERROR(ENOMEM);
+    for (i = 0; i < s->nb_components; i++) {
+        av_freep(&s->score[i]);
+        s->score[i] = av_mallocz_array(FFMAX(s->planeheight[i] >> 2, 1), sizeof(*s->score[i]));
+        if (!s->score[i])
+            return AVERROR(ENOMEM);
+    }
     s->max = (1 << desc->comp[0].depth) - 1;
 
     s->ssim_plane = desc->comp[0].depth > 8 ? ssim_plane_16bit : ssim_plane;
@@ -455,10 +514,10 @@ static int activate(AVFilterContext *ctx)
 static av_cold void uninit(AVFilterContext *ctx)
 {
     SSIMContext *s = ctx->priv;
+    int i;
 
     if (s->nb_frames > 0) {
         char buf[256];
-        int i;
         buf[0] = 0;
         for (i = 0; i < s->nb_components; i++) {
             int c = s->is_rgb ? s->rgba_map[i] : i;
@@ -475,6 +534,8 @@ static av_cold void uninit(AVFilterContext *ctx)
         fclose(s->stats_file);
 
     av_freep(&s->temp);
+    for (i = 0; i < 4; i++)
+        av_freep(&s->score[i]);
 }
 
 static const AVFilterPad ssim_inputs[] = {
@@ -510,4 +571,5 @@ AVFilter ff_vf_ssim = {
     .priv_class    = &ssim_class,
     .inputs        = ssim_inputs,
     .outputs       = ssim_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -29,12 +29,23 @@
 #include "framesync.h"
 #include "video.h"
 
+#define MAX_PENDING 8
+
 typedef struct StackItem {
     int x[4], y[4];
     int linesize[4];
     int height[4];
 } StackItem;
 
+/**
+ * Output frame whose sub-rectangles have been handed out to the inputs
+ * as their buffers, so that upstream filters render in place.
+ */
+typedef struct StackPending {
+    AVFrame *frame;
+    uint8_t *taken;             ///< per input, a view has been handed out
+} StackPending;
+
 typedef struct StackContext {
     const AVClass *class;
     const AVPixFmtDescriptor *desc;
@@ -48,8 +59,16 @@ typedef struct StackContext {
     StackItem *items;
     AVFrame **frames;
     FFFrameSync fs;
+
+    int zero_copy;              ///< inputs do not overlap, views can be handed out
+    StackPending pending[MAX_PENDING];
+    int nb_pending;
 } StackContext;
 
+typedef struct ThreadData {
+    AVFrame **in, *out;
+} ThreadData;
+
 static int query_formats(AVFilterContext *ctx)
 {
     AVFilterFormats *pix_fmts = NULL;
@@ -67,6 +86,88 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, pix_fmts);
 }
 
+static void drop_pending(StackContext *s, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        av_frame_free(&s->pending[i].frame);
+        memset(s->pending[i].taken, 0, s->nb_inputs);
+    }
+    for (i = n; i < s->nb_pending; i++)
+        FFSWAP(StackPending, s->pending[i - n], s->pending[i]);
+    s->nb_pending -= n;
+}
+
+static AVFrame *get_video_buffer(AVFilterLink *inlink, int w, int h)
+{
+    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *outlink = ctx->outputs[0];
+    StackContext *s = ctx->priv;
+    const int idx = FF_INLINK_IDX(inlink);
+    const StackItem *item = &s->items[idx];
+    StackPending *pending = NULL;
+    AVFrame *frame;
+    int i, p;
+
+    if (!s->zero_copy || w != inlink->w || h != inlink->h)
+        return NULL;
+
+    /* hand out the oldest output frame this input has no view of yet */
+    for (i = 0; i < s->nb_pending; i++) {
+        if (!s->pending[i].taken[idx]) {
+            pending = &s->pending[i];
+            break;
+        }
+    }
+    if (!pending) {
+        if (s->nb_pending == MAX_PENDING)
+            return NULL;
+        pending = &s->pending[s->nb_pending];
+        pending->frame = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!pending->frame)
+            return NULL;
+        s->nb_pending++;
+    }
+
+    frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+    if (av_frame_ref(frame, pending->frame) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+    frame->width  = w;
+    frame->height = h;
+    for (p = 0; p < s->nb_planes; p++)
+        frame->data[p] += item->y[p] * frame->linesize[p] + item->x[p];
+    pending->taken[idx] = 1;
+
+    return frame;
+}
+
+/* return the index of the pending frame the input frame is a view of, or -1 */
+static int find_pending(StackContext *s, int idx, const AVFrame *in)
+{
+    const StackItem *item = &s->items[idx];
+    int i, p;
+
+    for (i = 0; i < s->nb_pending; i++) {
+        const AVFrame *frame = s->pending[i].frame;
+
+        if (!s->pending[i].taken[idx])
+            continue;
+        for (p = 0; p < s->nb_planes; p++) {
+            if (in->linesize[p] != frame->linesize[p] ||
+                in->data[p] != frame->data[p] + item->y[p] * frame->linesize[p] + item->x[p])
+                break;
+        }
+        if (p == s->nb_planes)
+            return i;
+    }
+    return -1;
+}
+
 static av_cold int init(AVFilterContext *ctx)
 {
     StackContext *s = ctx->priv;
@@ -82,9 +183,13 @@ static av_cold int init(AVFilterContext *ctx)
     if (!s->frames)
         return AVERROR(ENOMEM);
 
-    if (!strcmp(ctx->filter->name, "xstack")) {
-        s->items = av_calloc(s->nb_inputs, sizeof(*s->items));
-        if (!s->items)
+    s->items = av_calloc(s->nb_inputs, sizeof(*s->items));
+    if (!s->items)
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < MAX_PENDING; i++) {
+        s->pending[i].taken = av_calloc(s->nb_inputs, sizeof(*s->pending[i].taken));
+        if (!s->pending[i].taken)
             return AVERROR(ENOMEM);
     }
 
@@ -92,6 +197,7 @@ static av_cold int init(AVFilterContext *ctx)
         AVFilterPad pad = { 0 };
 
         pad.type = AVMEDIA_TYPE_VIDEO;
+        pad.get_video_buffer = get_video_buffer;
         pad.name = av_asprintf("input%d", i);
         if (!pad.name)
             return AVERROR(ENOMEM);
@@ -105,6 +211,37 @@ static av_cold int init(AVFilterContext *ctx)
     return 0;
 }
 
+static int copy_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    StackContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *out = td->out;
+    int i, p;
+
+    for (p = 0; p < s->nb_planes; p++) {
+        const int h = p == 1 || p == 2 ? AV_CEIL_RSHIFT(out->height, s->desc->log2_chroma_h) : out->height;
+        const int slice_start = (h *  jobnr   ) / nb_jobs;
+        const int slice_end   = (h * (jobnr+1)) / nb_jobs;
+
+        for (i = 0; i < s->nb_inputs; i++) {
+            const StackItem *item = &s->items[i];
+            const AVFrame *in = td->in[i];
+            const int y0 = FFMAX(slice_start, item->y[p]);
+            const int y1 = FFMIN(slice_end,   item->y[p] + item->height[p]);
+
+            if (y0 >= y1)
+                continue;
+            av_image_copy_plane(out->data[p] + y0 * out->linesize[p] + item->x[p],
+                                out->linesize[p],
+                                in->data[p] + (y0 - item->y[p]) * in->linesize[p],
+                                in->linesize[p],
+                                item->linesize[p], y1 - y0);
+        }
+    }
+
+    return 0;
+}
+
 static int process_frame(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -112,60 +249,45 @@ static int process_frame(FFFrameSync *fs)
     StackContext *s = fs->opaque;
     AVFrame **in = s->frames;
     AVFrame *out;
-    int i, p, ret, offset[4] = { 0 };
+    ThreadData td;
+    int i, ret, pending = -1, last = -1;
 
     for (i = 0; i < s->nb_inputs; i++) {
+        int n;
+
         if ((ret = ff_framesync_get_frame(&s->fs, i, &in[i], 0)) < 0)
             return ret;
-    }
-
-    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-    if (!out)
-        return AVERROR(ENOMEM);
-    out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
-    out->sample_aspect_ratio = outlink->sample_aspect_ratio;
 
-    for (i = 0; i < s->nb_inputs; i++) {
-        AVFilterLink *inlink = ctx->inputs[i];
-        int linesize[4];
-        int height[4];
-
-        if (s->is_horizontal || s->is_vertical) {
-            if ((ret = av_image_fill_linesizes(linesize, inlink->format, inlink->w)) < 0) {
-                av_frame_free(&out);
-                return ret;
-            }
+        n = s->zero_copy ? find_pending(s, i, in[i]) : -1;
+        if (!i)
+            pending = n;
+        else if (n != pending)
+            pending = -1;
+        last = FFMAX(last, n);
+    }
 
-            height[1] = height[2] = AV_CEIL_RSHIFT(inlink->h, s->desc->log2_chroma_h);
-            height[0] = height[3] = inlink->h;
-        }
+    if (pending >= 0) {
+        /* every input was rendered into the same output frame */
+        out = s->pending[pending].frame;
+        s->pending[pending].frame = NULL;
+    } else {
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out)
+            return AVERROR(ENOMEM);
 
-        for (p = 0; p < s->nb_planes; p++) {
-            if (s->is_vertical) {
-                av_image_copy_plane(out->data[p] + offset[p] * out->linesize[p],
-                                    out->linesize[p],
-                                    in[i]->data[p],
-                                    in[i]->linesize[p],
-                                    linesize[p], height[p]);
-                offset[p] += height[p];
-            } else if (s->is_horizontal) {
-                av_image_copy_plane(out->data[p] + offset[p],
-                                    out->linesize[p],
-                                    in[i]->data[p],
-                                    in[i]->linesize[p],
-                                    linesize[p], height[p]);
-                offset[p] += linesize[p];
-            } else {
-                StackItem *item = &s->items[i];
-
-                av_image_copy_plane(out->data[p] + out->linesize[p] * item->y[p] + item->x[p],
-                                    out->linesize[p],
-                                    in[i]->data[p],
-                                    in[i]->linesize[p],
-                                    item->linesize[p], item->height[p]);
-            }
-        }
+        td.in  = in;
+        td.out = out;
+        ctx->internal->execute(ctx, copy_slice, &td, NULL,
+                               FFMIN(outlink->h, ff_filter_get_nb_threads(ctx)));
     }
+    /* output frames up to the newest one in use are not needed anymore;
+     * inputs that fall behind get views of the later ones */
+    if (s->nb_pending == MAX_PENDING)
+        last = FFMAX(last, 0);
+    drop_pending(s, last + 1);
+
+    out->pts = av_rescale_q(s->fs.pts, s->fs.time_base, outlink->time_base);
+    out->sample_aspect_ratio = outlink->sample_aspect_ratio;
 
     return ff_filter_frame(outlink, out);
 }
@@ -186,21 +308,42 @@ static int config_output(AVFilterLink *outlink)
     if (!s->desc)
         return AVERROR_BUG;
 
-    if (s->is_vertical) {
-        for (i = 1; i < s->nb_inputs; i++) {
-            if (ctx->inputs[i]->w != width) {
+    if (s->is_vertical || s->is_horizontal) {
+        int offset[4] = { 0 };
+
+        for (i = 0; i < s->nb_inputs; i++) {
+            AVFilterLink *inlink = ctx->inputs[i];
+            StackItem *item = &s->items[i];
+            int p;
+
+            if (s->is_vertical && inlink->w != width) {
                 av_log(ctx, AV_LOG_ERROR, "Input %d width %d does not match input %d width %d.\n", i, ctx->inputs[i]->w, 0, width);
                 return AVERROR(EINVAL);
             }
-            height += ctx->inputs[i]->h;
-        }
-    } else if (s->is_horizontal) {
-        for (i = 1; i < s->nb_inputs; i++) {
-            if (ctx->inputs[i]->h != height) {
+            if (s->is_horizontal && inlink->h != height) {
                 av_log(ctx, AV_LOG_ERROR, "Input %d height %d does not match input %d height %d.\n", i, ctx->inputs[i]->h, 0, height);
                 return AVERROR(EINVAL);
             }
-            width += ctx->inputs[i]->w;
+            if (i && s->is_vertical)
+                height += inlink->h;
+            if (i && s->is_horizontal)
+                width += inlink->w;
+
+            if ((ret = av_image_fill_linesizes(item->linesize, inlink->format, inlink->w)) < 0)
+                return ret;
+
+            item->height[1] = item->height[2] = AV_CEIL_RSHIFT(inlink->h, s->desc->log2_chroma_h);
+            item->height[0] = item->height[3] = inlink->h;
+
+            for (p = 0; p < 4; p++) {
+                if (s->is_vertical) {
+                    item->y[p] = offset[p];
+                    offset[p] += item->height[p];
+                } else {
+                    item->x[p] = offset[p];
+                    offset[p] += item->linesize[p];
+                }
+            }
         }
     } else {
         char *arg, *p = s->layout, *saveptr = NULL;
@@ -279,6 +422,29 @@ static int config_output(AVFilterLink *outlink)
 
     s->nb_planes = av_pix_fmt_count_planes(outlink->format);
 
+    /* inputs can only render into the output frame if their areas are
+     * disjoint, otherwise the order of the inputs matters. They must also
+     * span the whole output width: producers may write past the width up
+     * to the linesize, which would overwrite the input to their right. */
+    s->zero_copy = 1;
+    for (i = 0; i < s->nb_inputs && s->zero_copy; i++) {
+        const StackItem *a = &s->items[i];
+        int j;
+
+        if (a->x[0] || ctx->inputs[i]->w != width) {
+            s->zero_copy = 0;
+            break;
+        }
+        for (j = i + 1; j < s->nb_inputs; j++) {
+            const StackItem *b = &s->items[j];
+
+            if (a->y[0] < b->y[0] + b->height[0] && b->y[0] < a->y[0] + a->height[0]) {
+                s->zero_copy = 0;
+                break;
+            }
+        }
+    }
+
     outlink->w          = width;
     outlink->h          = height;
     outlink->time_base  = time_base;
@@ -313,6 +479,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->frames);
     av_freep(&s->items);
 
+    for (i = 0; i < MAX_PENDING; i++) {
+        av_frame_free(&s->pending[i].frame);
+        av_freep(&s->pending[i].taken);
+    }
+
     for (i = 0; i < ctx->nb_inputs; i++)
         av_freep(&ctx->input_pads[i].name);
 }
@@ -355,7 +526,7 @@ AVFilter ff_vf_hstack = {
     .init          = init,
     .uninit        = uninit,
     .activate      = activate,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 
 #endif /* CONFIG_HSTACK_FILTER */
@@ -375,7 +546,7 @@ AVFilter ff_vf_vstack = {
     .init          = init,
     .uninit        = uninit,
     .activate      = activate,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 
 #endif /* CONFIG_VSTACK_FILTER */
@@ -401,7 +572,7 @@ AVFilter ff_vf_xstack = {
     .init          = init,
     .uninit        = uninit,
     .activate      = activate,
-    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
 };
 
 #endif /* CONFIG_XSTACK_FILTER */
@@ -71,6 +71,20 @@ typedef struct TonemapContext {
     const struct LumaCoefficients *coeffs;
 } TonemapContext;
 
+/* tone curve terms that only depend on the frame peak */
+typedef struct TonemapCurve {
+    double peak;
+    float hable_peak;
+    double gamma_exp;
+    double gamma_low;
+    float mobius_a, mobius_b, mobius_scale;
+} TonemapCurve;
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    TonemapCurve curve;
+} ThreadData;
+
 static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_GBRPF32,
     AV_PIX_FMT_GBRAPF32,
@@ -113,50 +127,72 @@ static float hable(float in)
     return (in * (in * a + b * c) + d * e) / (in * (in * a + b) + d * f) - e / f;
 }
 
-static float mobius(float in, float j, double peak)
+static float mobius(float in, float j, const TonemapCurve *c)
 {
-    float a, b;
-
     if (in <= j)
         return in;
 
-    a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
-    b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+    return c->mobius_scale * (in + c->mobius_a) / (in + c->mobius_b);
+}
+
+static void init_curve(TonemapContext *s, TonemapCurve *c, double peak)
+{
+    float j = s->param;
+    float a, b;
 
-    return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
+    c->peak = peak;
+
+    switch (s->tonemap) {
+    case TONEMAP_GAMMA:
+        c->gamma_exp = 1.0f / s->param;
+        c->gamma_low = pow(0.05f / peak, c->gamma_exp);
+        break;
+    case TONEMAP_HABLE:
+        c->hable_peak = hable(peak);
+        break;
+    case TONEMAP_MOBIUS:
+        a = -j * j * (peak - 1.0f) / (j * j - 2.0f * j + peak);
+        b = (j * j - 2.0f * j * peak + peak) / FFMAX(peak - 1.0f, 1e-6);
+        c->mobius_a = a;
+        c->mobius_b = b;
+        c->mobius_scale = (b * b + 2.0f * b * j + j * j) / (b - a);
+        break;
+    }
 }
 
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
-static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
-                    const AVPixFmtDescriptor *desc, int x, int y, double peak)
+#define TONEMAP_BLOCK 64
+
+/* tonemap up to TONEMAP_BLOCK pixels of one row, one stage at a time */
+static void tonemap(TonemapContext *s, float *r_out, float *b_out, float *g_out,
+                    const float *r_in, const float *b_in, const float *g_in,
+                    int w, const TonemapCurve *c)
 {
-    const float *r_in = (const float *)(in->data[0] + x * desc->comp[0].step + y * in->linesize[0]);
-    const float *b_in = (const float *)(in->data[1] + x * desc->comp[1].step + y * in->linesize[1]);
-    const float *g_in = (const float *)(in->data[2] + x * desc->comp[2].step + y * in->linesize[2]);
-    float *r_out = (float *)(out->data[0] + x * desc->comp[0].step + y * out->linesize[0]);
-    float *b_out = (float *)(out->data[1] + x * desc->comp[1].step + y * out->linesize[1]);
-    float *g_out = (float *)(out->data[2] + x * desc->comp[2].step + y * out->linesize[2]);
-    float sig, sig_orig;
-
-    /* load values */
-    *r_out = *r_in;
-    *b_out = *b_in;
-    *g_out = *g_in;
+    double peak = c->peak;
+    float sig[TONEMAP_BLOCK];
+    int x;
 
     /* desaturate to prevent unnatural colors */
     if (s->desat > 0) {
-        float luma = s->coeffs->cr * *r_in + s->coeffs->cg * *g_in + s->coeffs->cb * *b_in;
-        float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
-        *r_out = MIX(*r_in, luma, overbright);
-        *g_out = MIX(*g_in, luma, overbright);
-        *b_out = MIX(*b_in, luma, overbright);
+        for (x = 0; x < w; x++) {
+            float luma = s->coeffs->cr * r_in[x] + s->coeffs->cg * g_in[x] + s->coeffs->cb * b_in[x];
+            float overbright = FFMAX(luma - s->desat, 1e-6) / FFMAX(luma, 1e-6);
+            r_out[x] = MIX(r_in[x], luma, overbright);
+            g_out[x] = MIX(g_in[x], luma, overbright);
+            b_out[x] = MIX(b_in[x], luma, overbright);
+        }
+    } else {
+        /* load values */
+        memcpy(r_out, r_in, w * sizeof(*r_out));
+        memcpy(b_out, b_in, w * sizeof(*b_out));
+        memcpy(g_out, g_in, w * sizeof(*g_out));
     }
 
     /* pick the brightest component, reducing the value range as necessary
      * to keep the entire signal in range and preventing discoloration due to
      * out-of-bounds clipping */
-    sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
-    sig_orig = sig;
+    for (x = 0; x < w; x++)
+        sig[x] = FFMAX(FFMAX3(r_out[x], g_out[x], b_out[x]), 1e-6);
 
     switch(s->tonemap) {
     default:
@@ -164,37 +200,74 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
         // do nothing
         break;
     case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
+        for (x = 0; x < w; x++)
+            sig[x] = sig[x] * s->param / peak;
         break;
     case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
+        for (x = 0; x < w; x++)
+            sig[x] = sig[x] > 0.05f ? pow(sig[x] / peak, c->gamma_exp)
+                                    : sig[x] * c->gamma_low / 0.05f;
         break;
     case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
+        for (x = 0; x < w; x++)
+            sig[x] = av_clipf(sig[x] * s->param, 0, 1.0f);
         break;
     case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
+        for (x = 0; x < w; x++)
+            sig[x] = hable(sig[x]) / c->hable_peak;
         break;
     case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
+        for (x = 0; x < w; x++)
+            sig[x] = sig[x] / (sig[x] + s->param) * (peak + s->param) / peak;
         break;
     case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
+        for (x = 0; x < w; x++)
+            sig[x] = mobius(sig[x], s->param, c);
         break;
     }
 
     /* apply the computed scale factor to the color,
      * linearly to prevent discoloration */
-    *r_out *= sig / sig_orig;
-    *g_out *= sig / sig_orig;
-    *b_out *= sig / sig_orig;
+    for (x = 0; x < w; x++) {
+        float sig_orig = FFMAX(FFMAX3(r_out[x], g_out[x], b_out[x]), 1e-6);
+        r_out[x] *= sig[x] / sig_orig;
+        g_out[x] *= sig[x] / sig_orig;
+        b_out[x] *= sig[x] / sig_orig;
+    }
+}
+
+static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    TonemapContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *in = td->in;
+    AVFrame *out = td->out;
+    const int slice_start = (in->height * jobnr) / nb_jobs;
+    const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
+    int x, y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        const float *r_in = (const float *)(in->data[0] + y * in->linesize[0]);
+        const float *b_in = (const float *)(in->data[1] + y * in->linesize[1]);
+        const float *g_in = (const float *)(in->data[2] + y * in->linesize[2]);
+        float *r_out = (float *)(out->data[0] + y * out->linesize[0]);
+        float *b_out = (float *)(out->data[1] + y * out->linesize[1]);
+        float *g_out = (float *)(out->data[2] + y * out->linesize[2]);
+
+        for (x = 0; x < out->width; x += TONEMAP_BLOCK)
+            tonemap(s, r_out + x, b_out + x, g_out + x, r_in + x, b_in + x, g_in + x,
+                    FFMIN(TONEMAP_BLOCK, out->width - x), &td->curve);
+    }
+
+    return 0;
 }
 
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
-    TonemapContext *s = link->dst->priv;
-    AVFilterLink *outlink = link->dst->outputs[0];
+    AVFilterContext *ctx = link->dst;
+    TonemapContext *s = ctx->priv;
+    AVFilterLink *outlink = ctx->outputs[0];
+    ThreadData td;
     AVFrame *out;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     const AVPixFmtDescriptor *odesc = av_pix_fmt_desc_get(outlink->format);
@@ -245,9 +318,10 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
     }
 
     /* do the tone map */
-    for (y = 0; y < out->height; y++)
-        for (x = 0; x < out->width; x++)
-            tonemap(s, out, in, desc, x, y, peak);
+    td.out = out;
+    td.in = in;
+    init_curve(s, &td.curve, peak);
+    ctx->internal->execute(ctx, tonemap_slice, &td, NULL, FFMIN(in->height, ff_filter_get_nb_threads(ctx)));
 
     /* copy/generate alpha if needed */
     if (desc->flags & AV_PIX_FMT_FLAG_ALPHA && odesc->flags & AV_PIX_FMT_FLAG_ALPHA) {
@@ -321,4 +395,5 @@ AVFilter ff_vf_tonemap = {
     .priv_class      = &tonemap_class,
     .inputs          = tonemap_inputs,
     .outputs         = tonemap_outputs,
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
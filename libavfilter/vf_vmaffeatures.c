@@ -0,0 +1,861 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Calculate the elementary VMAF features (VIF, ADM and motion) natively.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/opt.h"
+#include "libavutil/pixdesc.h"
+#include "avfilter.h"
+#include "formats.h"
+#include "framesync.h"
+#include "internal.h"
+#include "vmaf_motion.h"
+#include "video.h"
+
+#define NB_SCALES 4
+
+/* pixel values are centered around 0 in an 8-bit range, like libvmaf does */
+#define PIXEL_OFFSET -128.0f
+
+#define VIF_MAX_FILTER 17
+#define VIF_SIGMA_NSQ 2.0f
+#define VIF_EPS 1.0e-10f
+#define VIF_GAIN_LIMIT 100.0f
+
+#define ADM_BORDER_FACTOR 0.1
+#define ADM_VIEW_DIST 3.0
+#define ADM_REF_DISPLAY_HEIGHT 1080
+
+enum ADMBand {
+    BAND_H,
+    BAND_V,
+    BAND_D,
+    BAND_A,
+    NB_BANDS,
+};
+
+/* numerators and denominators of the three ADM bands, or of VIF */
+#define NB_ROW_SUMS 6
+
+typedef struct VMAFFeaturesContext {
+    const AVClass *class;
+    FFFrameSync fs;
+    FILE *stats_file;
+    char *stats_file_str;
+
+    int width, height;
+    int depth;
+    uint64_t nb_frames;
+    int nb_threads;
+
+    VMAFMotionData motion;
+
+    /* VIF */
+    float vif_filter[NB_SCALES][VIF_MAX_FILTER];
+    int vif_filter_width[NB_SCALES];
+    int vif_w[NB_SCALES], vif_h[NB_SCALES];
+    float *vif_ref[NB_SCALES], *vif_dis[NB_SCALES];
+
+    /* ADM */
+    float adm_rfactor[NB_SCALES][3];
+    int adm_w[NB_SCALES], adm_h[NB_SCALES];
+    float *adm_ref[NB_SCALES][NB_BANDS], *adm_dis[NB_SCALES][NB_BANDS];
+    float *adm_r[3], *adm_csf[3];
+
+    float *temp;        ///< per-thread line buffers
+    int temp_size;
+    double *row_sums[NB_ROW_SUMS];
+
+    double vif_score[NB_SCALES], adm_score[NB_SCALES + 1], motion_score;
+    double vif_total[NB_SCALES], adm_total[NB_SCALES + 1], motion_total;
+} VMAFFeaturesContext;
+
+typedef struct ThreadData {
+    AVFrame *ref, *dis;
+    int scale;
+} ThreadData;
+
+#define OFFSET(x) offsetof(VMAFFeaturesContext, x)
+#define FLAGS AV_OPT_FLAG_FILTERING_PARAM|AV_OPT_FLAG_VIDEO_PARAM
+
+static const AVOption vmaffeatures_options[] = {
+    {"stats_file", "Set file where to store per-frame features", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    {"f",          "Set file where to store per-frame features", OFFSET(stats_file_str), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
+    { NULL }
+};
+
+FRAMESYNC_DEFINE_CLASS(vmaffeatures, VMAFFeaturesContext, fs);
+
+/* Daubechies 2 analysis filters */
+static const float db2_lo[4] = {  0.482962913144690, 0.836516303737469,  0.224143868041857, -0.129409522550921 };
+static const float db2_hi[4] = { -0.129409522550921, -0.224143868041857, 0.836516303737469, -0.482962913144690 };
+
+/* Watson et al., Visibility of Wavelet Quantization Noise, for the Y channel */
+static const struct {
+    float a, k, f0;
+    float g[4];
+} dwt_y_threshold = { 0.495, 0.466, 0.401, { 1.501, 1.0, 0.534, 1.0 } };
+
+static const float dwt_basis_amplitudes[6][4] = {
+    { 0.62171,  0.67234,  0.72709,  0.67234  },
+    { 0.34537,  0.41317,  0.49428,  0.41317  },
+    { 0.18004,  0.22727,  0.28688,  0.22727  },
+    { 0.091401, 0.11792,  0.15214,  0.11792  },
+    { 0.045943, 0.059758, 0.077727, 0.059758 },
+    { 0.023013, 0.030018, 0.039156, 0.030018 },
+};
+
+static float dwt_quant_step(int lambda, int theta)
+{
+    /* display visual resolution in pixels per degree of visual angle */
+    double r = ADM_VIEW_DIST * ADM_REF_DISPLAY_HEIGHT * M_PI / 180.0;
+    double temp = log10(pow(2.0, lambda + 1) * dwt_y_threshold.f0 * dwt_y_threshold.g[theta] / r);
+
+    return 2.0 * dwt_y_threshold.a * pow(10.0, dwt_y_threshold.k * temp * temp) /
+           dwt_basis_amplitudes[lambda][theta];
+}
+
+static av_always_inline int reflect(int i, int n)
+{
+    return i < 0 ? -i : i >= n ? 2 * n - i - 1 : i;
+}
+
+static void set_meta(AVDictionary **metadata, const char *key, int idx, double d)
+{
+    char value[128], key2[128];
+
+    snprintf(value, sizeof(value), "%f", d);
+    if (idx >= 0) {
+        snprintf(key2, sizeof(key2), "%s%d", key, idx);
+        av_dict_set(metadata, key2, value, 0);
+    } else {
+        av_dict_set(metadata, key, value, 0);
+    }
+}
+
+#define CONVERT_FUNC(name, type, scale)                                          \
+static void name(float *dst, const uint8_t *src8, int w)                        \
+{                                                                                \
+    const type *src = (const type *)src8;                                        \
+    int x;                                                                       \
+                                                                                 \
+    for (x = 0; x < w; x++)                                                      \
+        dst[x] = src[x] * scale + PIXEL_OFFSET;                                  \
+}
+
+CONVERT_FUNC(convert_line_8bit,  uint8_t,  1.0f)
+CONVERT_FUNC(convert_line_10bit, uint16_t, 0.25f)
+
+static int convert_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = (s->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (s->height * (jobnr + 1)) / nb_jobs;
+    int y;
+
+    for (y = slice_start; y < slice_end; y++) {
+        float *ref = s->vif_ref[0] + y * s->width;
+        float *dis = s->vif_dis[0] + y * s->width;
+        const uint8_t *ref_src = td->ref->data[0] + y * td->ref->linesize[0];
+        const uint8_t *dis_src = td->dis->data[0] + y * td->dis->linesize[0];
+
+        if (s->depth > 8) {
+            convert_line_10bit(ref, ref_src, s->width);
+            convert_line_10bit(dis, dis_src, s->width);
+        } else {
+            convert_line_8bit(ref, ref_src, s->width);
+            convert_line_8bit(dis, dis_src, s->width);
+        }
+    }
+
+    return 0;
+}
+
+static av_always_inline float filter_h(const float *filter, int fw, const float *src, int x, int w)
+{
+    float sum = 0.0f;
+    int k;
+
+    if (x >= fw / 2 && x + fw / 2 < w) {
+        src += x - fw / 2;
+        for (k = 0; k < fw; k++)
+            sum += filter[k] * src[k];
+    } else {
+        for (k = 0; k < fw; k++)
+            sum += filter[k] * src[reflect(x - fw / 2 + k, w)];
+    }
+
+    return sum;
+}
+
+/* blur and decimate the previous scale */
+static int vif_decimate_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int scale = td->scale;
+    const float *filter = s->vif_filter[scale];
+    const int fw = s->vif_filter_width[scale];
+    const int src_w = s->vif_w[scale - 1], src_h = s->vif_h[scale - 1];
+    const int w = s->vif_w[scale], h = s->vif_h[scale];
+    const int slice_start = (h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+    float *ref_line = s->temp + jobnr * s->temp_size;
+    float *dis_line = ref_line + src_w;
+    int x, y, k;
+
+    for (y = slice_start; y < slice_end; y++) {
+        float *ref = s->vif_ref[scale] + y * w;
+        float *dis = s->vif_dis[scale] + y * w;
+
+        for (x = 0; x < src_w; x++) {
+            float sum_ref = 0.0f, sum_dis = 0.0f;
+
+            for (k = 0; k < fw; k++) {
+                int yy = reflect(2 * y - fw / 2 + k, src_h);
+
+                sum_ref += filter[k] * s->vif_ref[scale - 1][yy * src_w + x];
+                sum_dis += filter[k] * s->vif_dis[scale - 1][yy * src_w + x];
+            }
+            ref_line[x] = sum_ref;
+            dis_line[x] = sum_dis;
+        }
+
+        for (x = 0; x < w; x++) {
+            ref[x] = filter_h(filter, fw, ref_line, 2 * x, src_w);
+            dis[x] = filter_h(filter, fw, dis_line, 2 * x, src_w);
+        }
+    }
+
+    return 0;
+}
+
+static int vif_statistic_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int scale = td->scale;
+    const float *filter = s->vif_filter[scale];
+    const int fw = s->vif_filter_width[scale];
+    const int w = s->vif_w[scale], h = s->vif_h[scale];
+    const float *ref = s->vif_ref[scale];
+    const float *dis = s->vif_dis[scale];
+    const int slice_start = (h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+    float *mu1 = s->temp + jobnr * s->temp_size;
+    float *mu2 = mu1 + w;
+    float *xx  = mu2 + w;
+    float *yy  = xx  + w;
+    float *xy  = yy  + w;
+    int x, y, k;
+
+    for (y = slice_start; y < slice_end; y++) {
+        double num = 0.0, den = 0.0;
+
+        for (x = 0; x < w; x++) {
+            float s_mu1 = 0.0f, s_mu2 = 0.0f, s_xx = 0.0f, s_yy = 0.0f, s_xy = 0.0f;
+
+            for (k = 0; k < fw; k++) {
+                int i = reflect(y - fw / 2 + k, h) * w + x;
+                float r = ref[i], d = dis[i];
+
+                s_mu1 += filter[k] * r;
+                s_mu2 += filter[k] * d;
+                s_xx  += filter[k] * r * r;
+                s_yy  += filter[k] * d * d;
+                s_xy  += filter[k] * r * d;
+            }
+            mu1[x] = s_mu1;
+            mu2[x] = s_mu2;
+            xx[x]  = s_xx;
+            yy[x]  = s_yy;
+            xy[x]  = s_xy;
+        }
+
+        for (x = 0; x < w; x++) {
+            float mu1_val = filter_h(filter, fw, mu1, x, w);
+            float mu2_val = filter_h(filter, fw, mu2, x, w);
+            float sigma1_sq = filter_h(filter, fw, xx, x, w) - mu1_val * mu1_val;
+            float sigma2_sq = filter_h(filter, fw, yy, x, w) - mu2_val * mu2_val;
+            float sigma12   = filter_h(filter, fw, xy, x, w) - mu1_val * mu2_val;
+            float g, sv_sq;
+
+            sigma1_sq = FFMAX(sigma1_sq, 0.0f);
+            sigma2_sq = FFMAX(sigma2_sq, 0.0f);
+
+            g     = sigma12 / (sigma1_sq + VIF_EPS);
+            sv_sq = sigma2_sq - g * sigma12;
+
+            if (sigma1_sq < VIF_EPS) {
+                g = 0.0f;
+                sv_sq = sigma2_sq;
+                sigma1_sq = 0.0f;
+            }
+            if (sigma2_sq < VIF_EPS) {
+                g = 0.0f;
+                sv_sq = 0.0f;
+            }
+            if (g < 0.0f) {
+                sv_sq = sigma2_sq;
+                g = 0.0f;
+            }
+            sv_sq = FFMAX(sv_sq, VIF_EPS);
+            g = FFMIN(g, VIF_GAIN_LIMIT);
+
+            num += log2f(1.0f + (g * g * sigma1_sq) / (sv_sq + VIF_SIGMA_NSQ));
+            den += log2f(1.0f + sigma1_sq / VIF_SIGMA_NSQ);
+        }
+
+        s->row_sums[0][y] = num;
+        s->row_sums[1][y] = den;
+    }
+
+    return 0;
+}
+
+/* one level of the 2D DWT, both images, producing the four bands */
+static int adm_dwt_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int scale = td->scale;
+    const int src_w = scale ? s->adm_w[scale - 1] : s->width;
+    const int src_h = scale ? s->adm_h[scale - 1] : s->height;
+    const int w = s->adm_w[scale], h = s->adm_h[scale];
+    const int slice_start = (h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+    float *tmplo = s->temp + jobnr * s->temp_size;
+    float *tmphi = tmplo + src_w;
+    int img, x, y, k;
+
+    for (img = 0; img < 2; img++) {
+        const float *src = scale ? (img ? s->adm_dis : s->adm_ref)[scale - 1][BAND_A]
+                                 : (img ? s->vif_dis : s->vif_ref)[0];
+        float **dst = (img ? s->adm_dis : s->adm_ref)[scale];
+
+        for (y = slice_start; y < slice_end; y++) {
+            const float *rows[4];
+
+            for (k = 0; k < 4; k++)
+                rows[k] = src + reflect(2 * y - 1 + k, src_h) * src_w;
+
+            for (x = 0; x < src_w; x++) {
+                tmplo[x] = db2_lo[0] * rows[0][x] + db2_lo[1] * rows[1][x] +
+                           db2_lo[2] * rows[2][x] + db2_lo[3] * rows[3][x];
+                tmphi[x] = db2_hi[0] * rows[0][x] + db2_hi[1] * rows[1][x] +
+                           db2_hi[2] * rows[2][x] + db2_hi[3] * rows[3][x];
+            }
+
+            for (x = 0; x < w; x++) {
+                int x0 = reflect(2 * x - 1, src_w), x1 = 2 * x;
+                int x2 = reflect(2 * x + 1, src_w), x3 = reflect(2 * x + 2, src_w);
+                int i = y * w + x;
+
+                dst[BAND_A][i] = db2_lo[0] * tmplo[x0] + db2_lo[1] * tmplo[x1] +
+                                 db2_lo[2] * tmplo[x2] + db2_lo[3] * tmplo[x3];
+                dst[BAND_V][i] = db2_hi[0] * tmplo[x0] + db2_hi[1] * tmplo[x1] +
+                                 db2_hi[2] * tmplo[x2] + db2_hi[3] * tmplo[x3];
+                dst[BAND_H][i] = db2_lo[0] * tmphi[x0] + db2_lo[1] * tmphi[x1] +
+                                 db2_lo[2] * tmphi[x2] + db2_lo[3] * tmphi[x3];
+                dst[BAND_D][i] = db2_hi[0] * tmphi[x0] + db2_hi[1] * tmphi[x1] +
+                                 db2_hi[2] * tmphi[x2] + db2_hi[3] * tmphi[x3];
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void adm_border(int w, int h, int *left, int *top, int *right, int *bottom)
+{
+    *left   = w * ADM_BORDER_FACTOR - 0.5;
+    *top    = h * ADM_BORDER_FACTOR - 0.5;
+    *right  = w - *left;
+    *bottom = h - *top;
+}
+
+/*
+ * Split the distorted bands into the restored part (the reference attenuated
+ * or amplified in the same direction) and the additive impairment, weight
+ * the latter with the contrast sensitivity function, and sum the CSF
+ * weighted reference for the denominator.
+ */
+static int adm_decouple_csf_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int scale = td->scale;
+    const float *rfactor = s->adm_rfactor[scale];
+    const float cos_1deg_sq = cos(M_PI / 180.0) * cos(M_PI / 180.0);
+    const float eps = 1e-30f;
+    const int w = s->adm_w[scale], h = s->adm_h[scale];
+    const int slice_start = (h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+    float **ref = s->adm_ref[scale];
+    float **dis = s->adm_dis[scale];
+    int left, top, right, bottom;
+    int x, y, b;
+
+    adm_border(w, h, &left, &top, &right, &bottom);
+
+    for (y = slice_start; y < slice_end; y++) {
+        double den[3] = { 0.0 };
+
+        for (x = 0; x < w; x++) {
+            int i = y * w + x;
+            float oh = ref[BAND_H][i], ov = ref[BAND_V][i], od = ref[BAND_D][i];
+            float th = dis[BAND_H][i], tv = dis[BAND_V][i], td_ = dis[BAND_D][i];
+            float kh = av_clipf(th / (oh + eps), 0.0f, 1.0f);
+            float kv = av_clipf(tv / (ov + eps), 0.0f, 1.0f);
+            float kd = av_clipf(td_ / (od + eps), 0.0f, 1.0f);
+            float rh = kh * oh, rv = kv * ov, rd = kd * od;
+            float ot_dp = oh * th + ov * tv;
+            float o_mag_sq = oh * oh + ov * ov;
+            float t_mag_sq = th * th + tv * tv;
+
+            /* keep the distorted bands if the angle changed by less than one degree */
+            if (ot_dp >= 0.0f && ot_dp * ot_dp >= cos_1deg_sq * o_mag_sq * t_mag_sq) {
+                rh = th;
+                rv = tv;
+                rd = td_;
+            }
+
+            s->adm_r[BAND_H][i] = rh;
+            s->adm_r[BAND_V][i] = rv;
+            s->adm_r[BAND_D][i] = rd;
+            s->adm_csf[BAND_H][i] = fabsf(rfactor[BAND_H] * (th  - rh)) / 30.0f;
+            s->adm_csf[BAND_V][i] = fabsf(rfactor[BAND_V] * (tv  - rv)) / 30.0f;
+            s->adm_csf[BAND_D][i] = fabsf(rfactor[BAND_D] * (td_ - rd)) / 30.0f;
+
+            if (y >= top && y < bottom && x >= left && x < right) {
+                for (b = 0; b < 3; b++) {
+                    float val = fabsf(rfactor[b] * ref[b][i]);
+                    den[b] += val * val * val;
+                }
+            }
+        }
+
+        for (b = 0; b < 3; b++)
+            s->row_sums[3 + b][y] = den[b];
+    }
+
+    return 0;
+}
+
+/* contrast masking of the restored bands by the impairment */
+static int adm_cm_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int scale = td->scale;
+    const float *rfactor = s->adm_rfactor[scale];
+    const int w = s->adm_w[scale], h = s->adm_h[scale];
+    const int slice_start = (h *  jobnr     ) / nb_jobs;
+    const int slice_end   = (h * (jobnr + 1)) / nb_jobs;
+    int left, top, right, bottom;
+    int x, y, b, i, j;
+
+    adm_border(w, h, &left, &top, &right, &bottom);
+
+    for (y = slice_start; y < slice_end; y++) {
+        double num[3] = { 0.0 };
+
+        if (y >= top && y < bottom) {
+            for (x = left; x < right; x++) {
+                float thr = 0.0f;
+
+                /* 3x3 mask with a doubled center */
+                for (b = 0; b < 3; b++) {
+                    const float *csf = s->adm_csf[b];
+
+                    for (i = -1; i <= 1; i++) {
+                        const float *line = csf + reflect(y + i, h) * w;
+
+                        for (j = -1; j <= 1; j++)
+                            thr += line[reflect(x + j, w)];
+                    }
+                    thr += csf[y * w + x];
+                }
+
+                for (b = 0; b < 3; b++) {
+                    float val = fabsf(rfactor[b] * s->adm_r[b][y * w + x]) - thr;
+
+                    if (val > 0.0f)
+                        num[b] += val * val * val;
+                }
+            }
+        }
+
+        for (b = 0; b < 3; b++)
+            s->row_sums[b][y] = num[b];
+    }
+
+    return 0;
+}
+
+/* sum the per-row results in order, so they do not depend on the threads */
+static double sum_rows(const double *rows, int h)
+{
+    double sum = 0.0;
+    int y;
+
+    for (y = 0; y < h; y++)
+        sum += rows[y];
+
+    return sum;
+}
+
+static int nb_jobs(VMAFFeaturesContext *s, int h)
+{
+    return FFMIN(h, s->nb_threads);
+}
+
+static void compute_vif(AVFilterContext *ctx, ThreadData *td)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    int scale;
+
+    for (scale = 0; scale < NB_SCALES; scale++) {
+        int h = s->vif_h[scale];
+        double num, den;
+
+        td->scale = scale;
+        if (scale)
+            ctx->internal->execute(ctx, vif_decimate_slice, td, NULL, nb_jobs(s, h));
+        ctx->internal->execute(ctx, vif_statistic_slice, td, NULL, nb_jobs(s, h));
+
+        num = sum_rows(s->row_sums[0], h);
+        den = sum_rows(s->row_sums[1], h);
+        s->vif_score[scale] = den > 0.0 ? num / den : 1.0;
+    }
+}
+
+static void compute_adm(AVFilterContext *ctx, ThreadData *td)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    double numden_limit = 1e-10 * s->width * s->height / (1920.0 * 1080.0);
+    double num = 0.0, den = 0.0;
+    int scale, b;
+
+    for (scale = 0; scale < NB_SCALES; scale++) {
+        int w = s->adm_w[scale], h = s->adm_h[scale];
+        int left, top, right, bottom;
+        double num_scale = 0.0, den_scale = 0.0, border;
+
+        td->scale = scale;
+        ctx->internal->execute(ctx, adm_dwt_slice, td, NULL, nb_jobs(s, h));
+        ctx->internal->execute(ctx, adm_decouple_csf_slice, td, NULL, nb_jobs(s, h));
+        ctx->internal->execute(ctx, adm_cm_slice, td, NULL, nb_jobs(s, h));
+
+        adm_border(w, h, &left, &top, &right, &bottom);
+        border = pow((bottom - top) * (right - left) / 32.0, 1.0 / 3.0);
+        for (b = 0; b < 3; b++) {
+            num_scale += pow(sum_rows(s->row_sums[b],     h), 1.0 / 3.0) + border;
+            den_scale += pow(sum_rows(s->row_sums[3 + b], h), 1.0 / 3.0) + border;
+        }
+
+        s->adm_score[scale + 1] = den_scale < numden_limit ? 1.0 :
+                                  (num_scale < numden_limit ? 0.0 : num_scale) / den_scale;
+        num += num_scale;
+        den += den_scale;
+    }
+
+    num = num < numden_limit ? 0.0 : num;
+    den = den < numden_limit ? 0.0 : den;
+    s->adm_score[0] = den == 0.0 ? 1.0 : num / den;
+}
+
+static int do_vmaffeatures(FFFrameSync *fs)
+{
+    AVFilterContext *ctx = fs->parent;
+    VMAFFeaturesContext *s = ctx->priv;
+    AVFrame *master, *ref;
+    AVDictionary **metadata;
+    ThreadData td;
+    int ret, i;
+
+    ret = ff_framesync_dualinput_get(fs, &master, &ref);
+    if (ret < 0)
+        return ret;
+    if (!ref)
+        return ff_filter_frame(ctx->outputs[0], master);
+    metadata = &master->metadata;
+
+    td.ref = ref;
+    td.dis = master;
+    ctx->internal->execute(ctx, convert_slice, &td, NULL, nb_jobs(s, s->height));
+
+    compute_vif(ctx, &td);
+    compute_adm(ctx, &td);
+    s->motion_score = ff_vmafmotion_process(&s->motion, ref);
+
+    s->nb_frames++;
+    for (i = 0; i < NB_SCALES; i++) {
+        s->vif_total[i] += s->vif_score[i];
+        set_meta(metadata, "lavfi.vmaffeatures.vif_scale", i, s->vif_score[i]);
+    }
+    for (i = 0; i <= NB_SCALES; i++)
+        s->adm_total[i] += s->adm_score[i];
+    set_meta(metadata, "lavfi.vmaffeatures.adm2", -1, s->adm_score[0]);
+    for (i = 0; i < NB_SCALES; i++)
+        set_meta(metadata, "lavfi.vmaffeatures.adm_scale", i, s->adm_score[i + 1]);
+    s->motion_total += s->motion_score;
+    set_meta(metadata, "lavfi.vmaffeatures.motion", -1, s->motion_score);
+
+    if (s->stats_file) {
+        fprintf(s->stats_file, "n:%"PRId64" adm2:%f", s->nb_frames, s->adm_score[0]);
+        for (i = 0; i < NB_SCALES; i++)
+            fprintf(s->stats_file, " adm_scale%d:%f", i, s->adm_score[i + 1]);
+        for (i = 0; i < NB_SCALES; i++)
+            fprintf(s->stats_file, " vif_scale%d:%f", i, s->vif_score[i]);
+        fprintf(s->stats_file, " motion:%f\n", s->motion_score);
+    }
+
+    return ff_filter_frame(ctx->outputs[0], master);
+}
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+
+    if (s->stats_file_str) {
+        if (!strcmp(s->stats_file_str, "-")) {
+            s->stats_file = stdout;
+        } else {
+            s->stats_file = fopen(s->stats_file_str, "w");
+            if (!s->stats_file) {
+                int err = AVERROR(errno);
+                char buf[128];
+                av_strerror(err, buf, sizeof(buf));
+                av_log(ctx, AV_LOG_ERROR, "Could not open stats file %s: %s\n",
+                       s->stats_file_str, buf);
+                return err;
+            }
+        }
+    }
+
+    s->fs.on_event = do_vmaffeatures;
+    return 0;
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    static const enum AVPixelFormat pix_fmts[] = {
+        AV_PIX_FMT_GRAY8, AV_PIX_FMT_GRAY10,
+        AV_PIX_FMT_YUV444P, AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV420P,
+        AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_YUVJ422P, AV_PIX_FMT_YUVJ420P,
+        AV_PIX_FMT_YUV444P10, AV_PIX_FMT_YUV422P10, AV_PIX_FMT_YUV420P10,
+        AV_PIX_FMT_NONE
+    };
+
+    AVFilterFormats *fmts_list = ff_make_format_list(pix_fmts);
+    if (!fmts_list)
+        return AVERROR(ENOMEM);
+    return ff_set_common_formats(ctx, fmts_list);
+}
+
+static int config_input_ref(AVFilterLink *inlink)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
+    AVFilterContext *ctx  = inlink->dst;
+    VMAFFeaturesContext *s = ctx->priv;
+    int w = inlink->w, h = inlink->h;
+    int i, k, b, ret;
+
+    if (ctx->inputs[0]->w != ctx->inputs[1]->w ||
+        ctx->inputs[0]->h != ctx->inputs[1]->h) {
+        av_log(ctx, AV_LOG_ERROR, "Width and height of input videos must be same.\n");
+        return AVERROR(EINVAL);
+    }
+    if (ctx->inputs[0]->format != ctx->inputs[1]->format) {
+        av_log(ctx, AV_LOG_ERROR, "Inputs must be of same pixel format.\n");
+        return AVERROR(EINVAL);
+    }
+    if (w < 32 || h < 32) {
+        av_log(ctx, AV_LOG_ERROR, "Input must be at least 32x32.\n");
+        return AVERROR(EINVAL);
+    }
+
+    s->width  = w;
+    s->height = h;
+    s->depth  = desc->comp[0].depth;
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
+
+    for (i = 0; i < NB_SCALES; i++) {
+        int fw = (VIF_MAX_FILTER >> i) | 1;
+        double sigma = fw / 5.0, sum = 0.0;
+
+        s->vif_filter_width[i] = fw;
+        for (k = 0; k < fw; k++)
+            sum += exp(-(k - fw / 2) * (k - fw / 2) / (2.0 * sigma * sigma));
+        for (k = 0; k < fw; k++)
+            s->vif_filter[i][k] = exp(-(k - fw / 2) * (k - fw / 2) / (2.0 * sigma * sigma)) / sum;
+
+        s->vif_w[i] = i ? s->vif_w[i - 1] / 2 : w;
+        s->vif_h[i] = i ? s->vif_h[i - 1] / 2 : h;
+        s->vif_ref[i] = av_malloc_array(s->vif_w[i] * s->vif_h[i], sizeof(float));
+        s->vif_dis[i] = av_malloc_array(s->vif_w[i] * s->vif_h[i], sizeof(float));
+        if (!s->vif_ref[i] || !s->vif_dis[i])
+            return AVERROR(ENOMEM);
+
+        s->adm_rfactor[i][BAND_H] = 1.0f / dwt_quant_step(i, 1);
+        s->adm_rfactor[i][BAND_V] = 1.0f / dwt_quant_step(i, 1);
+        s->adm_rfactor[i][BAND_D] = 1.0f / dwt_quant_step(i, 2);
+
+        s->adm_w[i] = ((i ? s->adm_w[i - 1] : w) + 1) / 2;
+        s->adm_h[i] = ((i ? s->adm_h[i - 1] : h) + 1) / 2;
+        for (b = 0; b < NB_BANDS; b++) {
+            s->adm_ref[i][b] = av_malloc_array(s->adm_w[i] * s->adm_h[i], sizeof(float));
+            s->adm_dis[i][b] = av_malloc_array(s->adm_w[i] * s->adm_h[i], sizeof(float));
+            if (!s->adm_ref[i][b] || !s->adm_dis[i][b])
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    for (b = 0; b < 3; b++) {
+        s->adm_r[b]   = av_malloc_array(s->adm_w[0] * s->adm_h[0], sizeof(float));
+        s->adm_csf[b] = av_malloc_array(s->adm_w[0] * s->adm_h[0], sizeof(float));
+        if (!s->adm_r[b] || !s->adm_csf[b])
+            return AVERROR(ENOMEM);
+    }
+
+    s->temp_size = 5 * w;
+    s->temp = av_malloc_array(s->nb_threads, s->temp_size * sizeof(*s->temp));
+    if (!s->temp)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < NB_ROW_SUMS; i++) {
+        s->row_sums[i] = av_malloc_array(h, sizeof(*s->row_sums[i]));
+        if (!s->row_sums[i])
+            return AVERROR(ENOMEM);
+    }
+
+    if ((ret = ff_vmafmotion_init(&s->motion, w, h, inlink->format)) < 0)
+        return ret;
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    VMAFFeaturesContext *s = ctx->priv;
+    AVFilterLink *mainlink = ctx->inputs[0];
+    int ret;
+
+    ret = ff_framesync_init_dualinput(&s->fs, ctx);
+    if (ret < 0)
+        return ret;
+    outlink->w = mainlink->w;
+    outlink->h = mainlink->h;
+    outlink->time_base = mainlink->time_base;
+    outlink->sample_aspect_ratio = mainlink->sample_aspect_ratio;
+    outlink->frame_rate = mainlink->frame_rate;
+
+    if ((ret = ff_framesync_configure(&s->fs)) < 0)
+        return ret;
+
+    return 0;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    return ff_framesync_activate(&s->fs);
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    VMAFFeaturesContext *s = ctx->priv;
+    int i, b;
+
+    if (s->nb_frames > 0) {
+        char buf[512];
+
+        snprintf(buf, sizeof(buf), "adm2:%f", s->adm_total[0] / s->nb_frames);
+        for (i = 0; i < NB_SCALES; i++)
+            av_strlcatf(buf, sizeof(buf), " adm_scale%d:%f", i, s->adm_total[i + 1] / s->nb_frames);
+        for (i = 0; i < NB_SCALES; i++)
+            av_strlcatf(buf, sizeof(buf), " vif_scale%d:%f", i, s->vif_total[i] / s->nb_frames);
+        av_log(ctx, AV_LOG_INFO, "VMAF features average %s motion:%f\n",
+               buf, s->motion_total / s->nb_frames);
+    }
+
+    ff_framesync_uninit(&s->fs);
+
+    if (s->stats_file && s->stats_file != stdout)
+        fclose(s->stats_file);
+
+    ff_vmafmotion_uninit(&s->motion);
+
+    for (i = 0; i < NB_SCALES; i++) {
+        av_freep(&s->vif_ref[i]);
+        av_freep(&s->vif_dis[i]);
+        for (b = 0; b < NB_BANDS; b++) {
+            av_freep(&s->adm_ref[i][b]);
+            av_freep(&s->adm_dis[i][b]);
+        }
+    }
+    for (b = 0; b < 3; b++) {
+        av_freep(&s->adm_r[b]);
+        av_freep(&s->adm_csf[b]);
+    }
+    av_freep(&s->temp);
+    for (i = 0; i < NB_ROW_SUMS; i++)
+        av_freep(&s->row_sums[i]);
+}
+
+static const AVFilterPad vmaffeatures_inputs[] = {
+    {
+        .name         = "main",
+        .type         = AVMEDIA_TYPE_VIDEO,
+    },{
+        .name         = "reference",
+        .type         = AVMEDIA_TYPE_VIDEO,
+        .config_props = config_input_ref,
+    },
+    { NULL }
+};
+
+static const AVFilterPad vmaffeatures_outputs[] = {
+    {
+        .name          = "default",
+        .type          = AVMEDIA_TYPE_VIDEO,
+        .config_props  = config_output,
+    },
+    { NULL }
+};
+
+AVFilter ff_vf_vmaffeatures = {
+    .name          = "vmaffeatures",
+    .description   = NULL_IF_CONFIG_SMALL("Calculate the VMAF elementary features between two video streams."),
+    .preinit       = vmaffeatures_framesync_preinit,
+    .init          = init,
+    .uninit        = uninit,
+    .query_formats = query_formats,
+    .activate      = activate,
+    .priv_size     = sizeof(VMAFFeaturesContext),
+    .priv_class    = &vmaffeatures_class,
+    .inputs        = vmaffeatures_inputs,
+    .outputs       = vmaffeatures_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
+};
@@ -676,6 +676,62 @@ static int verify_expr(AVExpr *e)
     }
 }
 
+static void expr_count(AVExpr *e, unsigned *counter, int size)
+{
+    int i;
+
+    if (!e)
+        return;
+
+    if (e->type == e_const && e->a.const_index < size)
+        counter[e->a.const_index]++;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(e->param); i++)
+        expr_count(e->param[i], counter, size);
+}
+
+int av_expr_count_vars(AVExpr *e, unsigned *counter, int size)
+{
+    if (!e || !counter || size <= 0)
+        return AVERROR(EINVAL);
+
+    expr_count(e, counter, size);
+    return 0;
+}
+
+int av_expr_is_stateful(AVExpr *e)
+{
+    int i;
+
+    if (!e)
+        return 0;
+
+    switch (e->type) {
+    case e_func0:
+        if (e->a.func0 == etime)
+            return 1;
+        break;
+    case e_func1:
+    case e_func2:
+    case e_ld:
+    case e_st:
+    case e_while:
+    case e_taylor:
+    case e_root:
+    case e_random:
+    case e_print:
+        return 1;
+    default:
+        break;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(e->param); i++)
+        if (av_expr_is_stateful(e->param[i]))
+            return 1;
+
+    return 0;
+}
+
 int av_expr_parse(AVExpr **expr, const char *s,
                   const char * const *const_names,
                   const char * const *func1_names, double (* const *funcs1)(void *, double),
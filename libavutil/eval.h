@@ -86,6 +86,26 @@ int av_expr_parse(AVExpr **expr, const char *s,
  */
 double av_expr_eval(AVExpr *e, const double *const_values, void *opaque);
 
+/**
+ * Track the presence of variables and their number of occurrences in a parsed expression.
+ *
+ * @param counter a zero-initialized array where the count of each variable will be stored
+ * @param size size of the array, variables with a higher index are ignored
+ * @return 0 on success, a negative value corresponding to an AVERROR code on
+ * invalid arguments
+ */
+int av_expr_count_vars(AVExpr *e, unsigned *counter, int size);
+
+/**
+ * Check if the result of a parsed expression may change between evaluations
+ * with the same variable values, because it uses functions with internal state
+ * or side effects (ld(), st(), random(), print(), time(), ...) or functions
+ * supplied to av_expr_parse().
+ *
+ * @return 1 if it may change, 0 otherwise
+ */
+int av_expr_is_stateful(AVExpr *e);
+
 /**
  * Free a parsed expression previously created with av_expr_parse().
  */
@@ -0,0 +1,220 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/lfg.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/mem.h"
+#include "libavutil/time.h"
+#include "libavutil/tx.h"
+
+static const int lengths[] = {
+    1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 15, 16, 18, 20, 24, 25, 27, 30, 32, 36,
+    45, 60, 64, 75, 100, 120, 125, 128, 240, 256, 360, 480, 512, 960, 1024,
+    1920,
+};
+
+static void dft_ref(AVComplexFloat *out, const AVComplexFloat *in, int n, int inv)
+{
+    int i, j;
+
+    for (i = 0; i < n; i++) {
+        double re = 0, im = 0;
+        for (j = 0; j < n; j++) {
+            const double alpha = 2 * M_PI * (((int64_t)i * j) % n) / n;
+            const double c = cos(alpha), s = inv ? sin(alpha) : -sin(alpha);
+            re += in[j].re * c - in[j].im * s;
+            im += in[j].re * s + in[j].im * c;
+        }
+        out[i].re = re;
+        out[i].im = im;
+    }
+}
+
+static void mdct_ref(float *out, const float *in, int len, double scale)
+{
+    int i, k;
+
+    for (k = 0; k < len; k++) {
+        double sum = 0;
+        for (i = 0; i < 2*len; i++)
+            sum += in[i] * cos(M_PI / len * (i + 0.5 + len / 2.0) * (k + 0.5));
+        out[k] = sum * scale;
+    }
+}
+
+/* middle half of the inverse MDCT window */
+static void imdct_ref(float *out, const float *in, int len, double scale)
+{
+    int i, k;
+
+    for (i = 0; i < len; i++) {
+        const int n = i + len / 2;
+        double sum = 0;
+        for (k = 0; k < len; k++)
+            sum += in[k] * cos(M_PI / len * (n + 0.5 + len / 2.0) * (k + 0.5));
+        out[i] = -sum * scale;
+    }
+}
+
+static int check(const char *name, int len, const float *ref, const float *out, int n)
+{
+    double max = 1, err = 0;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        max = FFMAX(max, fabs(ref[i]));
+        err = FFMAX(err, fabs(ref[i] - out[i]));
+    }
+    if (err / max > 1e-5) {
+        printf("%s %d: error %g (max %g)\n", name, len, err, max);
+        return 1;
+    }
+    return 0;
+}
+
+static void speed(const char *name, int len, av_tx_fn tx, AVTXContext *s,
+                  void *out, void *in, ptrdiff_t stride)
+{
+    int64_t start, duration;
+    int it, nb_its = 1;
+
+    for (;;) {
+        start = av_gettime_relative();
+        for (it = 0; it < nb_its; it++)
+            tx(s, out, in, stride);
+        duration = av_gettime_relative() - start;
+        if (duration >= 200000)
+            break;
+        nb_its *= 2;
+    }
+    printf("%-5s %5d: %8.2f us/transform\n", name, len, (double)duration / nb_its);
+}
+
+int main(int argc, char **argv)
+{
+    const int do_speed = argc > 1 && !strcmp(argv[1], "-s");
+    const int max_len = 2048;
+    const float scale = 0.5f;
+    AVComplexFloat *in, *out, *ref;
+    AVTXContext *s;
+    av_tx_fn tx;
+    AVLFG prng;
+    int i, l, inv, ret = 0, err = 0;
+
+    av_lfg_init(&prng, 1);
+
+    in  = av_malloc_array(2 * max_len + 1, sizeof(*in));
+    out = av_malloc_array(2 * max_len + 1, sizeof(*out));
+    ref = av_malloc_array(2 * max_len + 1, sizeof(*ref));
+    if (!in || !out || !ref) {
+        ret = 1;
+        goto end;
+    }
+    for (i = 0; i < 2 * max_len + 1; i++) {
+        in[i].re = av_lfg_get(&prng) / (double)UINT32_MAX - 0.5;
+        in[i].im = av_lfg_get(&prng) / (double)UINT32_MAX - 0.5;
+    }
+
+    if (av_tx_init(&s, &tx, AV_TX_FLOAT_FFT, 0, 7, NULL, 0) != AVERROR(EINVAL) ||
+        av_tx_init(&s, &tx, AV_TX_FLOAT_MDCT, 0, 15, NULL, 0) != AVERROR(EINVAL)) {
+        printf("unsupported lengths accepted\n");
+        err++;
+    }
+
+    for (l = 0; l < FF_ARRAY_ELEMS(lengths); l++) {
+        const int len = lengths[l];
+
+        for (inv = 0; inv < 2; inv++) {
+            /* FFT, out of place and in place */
+            if ((ret = av_tx_init(&s, &tx, AV_TX_FLOAT_FFT, inv, len, NULL, 0)) < 0)
+                goto end;
+            dft_ref(ref, in, len, inv);
+            tx(s, out, in, sizeof(*out));
+            err += check(inv ? "ifft" : "fft", len, &ref->re, &out->re, 2 * len);
+            memcpy(out, in, len * sizeof(*out));
+            tx(s, out, out, sizeof(*out));
+            err += check(inv ? "ifft" : "fft", len, &ref->re, &out->re, 2 * len);
+            if (do_speed)
+                speed(inv ? "ifft" : "fft", len, tx, s, out, in, sizeof(*out));
+            av_tx_uninit(&s);
+
+            if (len & 1)
+                continue;
+
+            /* RDFT */
+            if ((ret = av_tx_init(&s, &tx, AV_TX_FLOAT_RDFT, inv, len, NULL, 0)) < 0)
+                goto end;
+            if (!inv) {
+                for (i = 0; i < len; i++) {
+                    ref[max_len + i].re = (&in->re)[i];
+                    ref[max_len + i].im = 0;
+                }
+                dft_ref(ref, ref + max_len, len, 0);
+                tx(s, out, in, sizeof(*out));
+                err += check("rdft", len, &ref->re, &out->re, len + 2);
+            } else {
+                /* hermitian spectrum from the first len/2+1 values */
+                for (i = 0; i <= len / 2; i++) {
+                    ref[max_len + i] = in[i];
+                    if (!i || i == len / 2)
+                        ref[max_len + i].im = 0;
+                    if (i && i < len / 2) {
+                        ref[max_len + len - i].re =  in[i].re;
+                        ref[max_len + len - i].im = -in[i].im;
+                    }
+                }
+                dft_ref(ref, ref + max_len, len, 1);
+                for (i = 0; i < len; i++)
+                    (&ref->re)[i] = ref[i].re;
+                tx(s, out, ref + max_len, sizeof(*out));
+                err += check("irdft", len, &ref->re, &out->re, len);
+            }
+            if (do_speed)
+                speed(inv ? "irdft" : "rdft", len, tx, s, out, inv ? ref + max_len : in, sizeof(*out));
+            av_tx_uninit(&s);
+
+            /* MDCT */
+            if ((ret = av_tx_init(&s, &tx, AV_TX_FLOAT_MDCT, inv, len, &scale, 0)) < 0)
+                goto end;
+            if (!inv) {
+                mdct_ref(&ref->re, &in->re, len, scale);
+                tx(s, out, in, sizeof(float));
+                err += check("mdct", len, &ref->re, &out->re, len);
+            } else {
+                imdct_ref(&ref->re, &in->re, len, scale);
+                tx(s, out, in, sizeof(float));
+                err += check("imdct", len, &ref->re, &out->re, len);
+            }
+            if (do_speed)
+                speed(inv ? "imdct" : "mdct", len, tx, s, out, in, sizeof(float));
+            av_tx_uninit(&s);
+        }
+    }
+
+end:
+    av_tx_uninit(&s);
+    av_free(in);
+    av_free(out);
+    av_free(ref);
+    if (ret < 0)
+        printf("init failed: %d\n", ret);
+    return ret < 0 || err;
+}
@@ -0,0 +1,486 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Mixed-radix (2, 3, 4, 5) decimation in time FFT, with the RDFT and MDCT
+ * built on top of it.
+ */
+
+#include <string.h>
+
+#include "attributes.h"
+#include "common.h"
+#include "error.h"
+#include "mathematics.h"
+#include "mem.h"
+#include "tx.h"
+
+#define MAX_PASSES 32
+
+typedef void (*fft_pass_fn)(AVComplexFloat *z, const AVComplexFloat *tw,
+                            int n, int m, int inv);
+
+struct AVTXContext {
+    int n;                          ///< length of the complex FFT
+    int inv;
+    int nb_passes;
+    int radix[MAX_PASSES];          ///< radix of each pass, innermost first
+    fft_pass_fn pass[MAX_PASSES];
+    AVComplexFloat *tw[MAX_PASSES]; ///< twiddles of each pass, points into twiddles
+    AVComplexFloat *twiddles;
+    int *revtab;                    ///< input index of each FFT position
+    int *revtab_inv;                ///< FFT position of each input index
+    AVComplexFloat *exptab;         ///< pre/post rotation of the RDFT and MDCT
+    AVComplexFloat *tmp;
+};
+
+static av_always_inline AVComplexFloat cmul(AVComplexFloat a, AVComplexFloat b)
+{
+    AVComplexFloat r = {
+        a.re * b.re - a.im * b.im,
+        a.re * b.im + a.im * b.re,
+    };
+    return r;
+}
+
+/**
+ * Combine radix DFTs of length m into DFTs of length radix*m.
+ * The inverse transforms only differ by the sign of the imaginary part of
+ * the constants, which swaps outputs k and radix-k.
+ */
+static void fft_pass2(AVComplexFloat *z, const AVComplexFloat *tw,
+                      int n, int m, int inv)
+{
+    int i, j;
+
+    for (j = 0; j < m; j++, tw++) {
+        for (i = j; i < n; i += 2*m) {
+            AVComplexFloat *x = z + i;
+            const AVComplexFloat a0 = x[0];
+            const AVComplexFloat a1 = cmul(x[m], tw[0]);
+
+            x[0].re = a0.re + a1.re;
+            x[0].im = a0.im + a1.im;
+            x[m].re = a0.re - a1.re;
+            x[m].im = a0.im - a1.im;
+        }
+    }
+}
+
+static void fft_pass3(AVComplexFloat *z, const AVComplexFloat *tw,
+                      int n, int m, int inv)
+{
+    const float s = inv ? -0.86602540378443864676f : 0.86602540378443864676f;
+    int i, j;
+
+    for (j = 0; j < m; j++, tw += 2) {
+        for (i = j; i < n; i += 3*m) {
+            AVComplexFloat *x = z + i;
+            const AVComplexFloat a0 = x[0];
+            const AVComplexFloat a1 = cmul(x[  m], tw[0]);
+            const AVComplexFloat a2 = cmul(x[2*m], tw[1]);
+            const float sr = a1.re + a2.re, si = a1.im + a2.im;
+            const float dr = a1.re - a2.re, di = a1.im - a2.im;
+            const float tr = a0.re - 0.5f * sr, ti = a0.im - 0.5f * si;
+
+            x[0  ].re = a0.re + sr;
+            x[0  ].im = a0.im + si;
+            x[  m].re = tr + s * di;
+            x[  m].im = ti - s * dr;
+            x[2*m].re = tr - s * di;
+            x[2*m].im = ti + s * dr;
+        }
+    }
+}
+
+static void fft_pass4(AVComplexFloat *z, const AVComplexFloat *tw,
+                      int n, int m, int inv)
+{
+    const float s = inv ? -1.0f : 1.0f;
+    int i, j;
+
+    for (j = 0; j < m; j++, tw += 3) {
+        for (i = j; i < n; i += 4*m) {
+            AVComplexFloat *x = z + i;
+            const AVComplexFloat a0 = x[0];
+            const AVComplexFloat a1 = cmul(x[  m], tw[0]);
+            const AVComplexFloat a2 = cmul(x[2*m], tw[1]);
+            const AVComplexFloat a3 = cmul(x[3*m], tw[2]);
+            const float t0r = a0.re + a2.re, t0i = a0.im + a2.im;
+            const float t1r = a0.re - a2.re, t1i = a0.im - a2.im;
+            const float t2r = a1.re + a3.re, t2i = a1.im + a3.im;
+            const float t3r = s * (a1.re - a3.re), t3i = s * (a1.im - a3.im);
+
+            x[0  ].re = t0r + t2r;
+            x[0  ].im = t0i + t2i;
+            x[  m].re = t1r + t3i;
+            x[  m].im = t1i - t3r;
+            x[2*m].re = t0r - t2r;
+            x[2*m].im = t0i - t2i;
+            x[3*m].re = t1r - t3i;
+            x[3*m].im = t1i + t3r;
+        }
+    }
+}
+
+static void fft_pass5(AVComplexFloat *z, const AVComplexFloat *tw,
+                      int n, int m, int inv)
+{
+    const float c1 = 0.30901699437494742410f;  // cos(2*pi/5)
+    const float c2 = -0.80901699437494742410f; // cos(4*pi/5)
+    const float s1 = inv ? -0.95105651629515357212f : 0.95105651629515357212f;
+    const float s2 = inv ? -0.58778525229247312917f : 0.58778525229247312917f;
+    int i, j;
+
+    for (j = 0; j < m; j++, tw += 4) {
+        for (i = j; i < n; i += 5*m) {
+            AVComplexFloat *x = z + i;
+            const AVComplexFloat a0 = x[0];
+            const AVComplexFloat a1 = cmul(x[  m], tw[0]);
+            const AVComplexFloat a2 = cmul(x[2*m], tw[1]);
+            const AVComplexFloat a3 = cmul(x[3*m], tw[2]);
+            const AVComplexFloat a4 = cmul(x[4*m], tw[3]);
+            const float b1r = a1.re + a4.re, b1i = a1.im + a4.im;
+            const float b2r = a2.re + a3.re, b2i = a2.im + a3.im;
+            const float d1r = a1.re - a4.re, d1i = a1.im - a4.im;
+            const float d2r = a2.re - a3.re, d2i = a2.im - a3.im;
+            const float e1r = a0.re + c1 * b1r + c2 * b2r;
+            const float e1i = a0.im + c1 * b1i + c2 * b2i;
+            const float e2r = a0.re + c2 * b1r + c1 * b2r;
+            const float e2i = a0.im + c2 * b1i + c1 * b2i;
+            const float f1r = s1 * d1r + s2 * d2r, f1i = s1 * d1i + s2 * d2i;
+            const float f2r = s2 * d1r - s1 * d2r, f2i = s2 * d1i - s1 * d2i;
+
+            x[0  ].re = a0.re + b1r + b2r;
+            x[0  ].im = a0.im + b1i + b2i;
+            x[  m].re = e1r + f1i;
+            x[  m].im = e1i - f1r;
+            x[2*m].re = e2r + f2i;
+            x[2*m].im = e2i - f2r;
+            x[3*m].re = e2r - f2i;
+            x[3*m].im = e2i + f2r;
+            x[4*m].re = e1r - f1i;
+            x[4*m].im = e1i + f1r;
+        }
+    }
+}
+
+static void fft_calc(AVTXContext *s, AVComplexFloat *z)
+{
+    int i, m = 1;
+
+    for (i = 0; i < s->nb_passes; i++) {
+        s->pass[i](z, s->tw[i], s->n, m, s->inv);
+        m *= s->radix[i];
+    }
+}
+
+static void fft(AVTXContext *s, void *_out, void *_in, ptrdiff_t stride)
+{
+    const AVComplexFloat *in = _in;
+    AVComplexFloat *out = _out;
+    int i;
+
+    if (in == out) {
+        memcpy(s->tmp, in, s->n * sizeof(*s->tmp));
+        in = s->tmp;
+    }
+    for (i = 0; i < s->n; i++)
+        out[i] = in[s->revtab[i]];
+    fft_calc(s, out);
+}
+
+static void rdft(AVTXContext *s, void *_out, void *_in, ptrdiff_t stride)
+{
+    const AVComplexFloat *in = _in;
+    AVComplexFloat *out = _out, *z = s->tmp;
+    const int n = s->n;
+    int i, k;
+
+    for (i = 0; i < n; i++)
+        z[i] = in[s->revtab[i]];
+    fft_calc(s, z);
+
+    out[0].re = z[0].re + z[0].im;
+    out[0].im = 0.0f;
+    out[n].re = z[0].re - z[0].im;
+    out[n].im = 0.0f;
+    for (k = 1; k < n; k++) {
+        const AVComplexFloat a = z[k], b = z[n - k];
+        const AVComplexFloat e = { 0.5f * (a.re + b.re), 0.5f * (a.im - b.im) };
+        const AVComplexFloat o = { 0.5f * (a.im + b.im), 0.5f * (b.re - a.re) };
+        const AVComplexFloat t = cmul(o, s->exptab[k]);
+
+        out[k].re = e.re + t.re;
+        out[k].im = e.im + t.im;
+    }
+}
+
+static void irdft(AVTXContext *s, void *_out, void *_in, ptrdiff_t stride)
+{
+    const AVComplexFloat *in = _in;
+    AVComplexFloat *out = _out, *z = s->tmp;
+    const int n = s->n;
+    int i, k;
+
+    for (k = 0; k < n; k++) {
+        const AVComplexFloat a = in[k], b = in[n - k];
+        const AVComplexFloat o = { a.re - b.re, a.im + b.im };
+        const AVComplexFloat t = cmul(o, s->exptab[k]);
+
+        z[k].re = a.re + b.re - t.im;
+        z[k].im = a.im - b.im + t.re;
+    }
+    for (i = 0; i < n; i++)
+        out[i] = z[s->revtab[i]];
+    fft_calc(s, out);
+}
+
+static void mdct(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    const float *src = _src;
+    float *dst = _dst;
+    const AVComplexFloat *exp = s->exptab;
+    AVComplexFloat *z = s->tmp;
+    const int n4 = s->n, n2 = 2*n4, n3 = 3*n4, n = 4*n4;
+    int k;
+
+    stride /= sizeof(*dst);
+
+    /* pre rotation, reading the window as if it was antiperiodic */
+    for (k = 0; k < n4; k++) {
+        const int k2 = 2*k;
+        AVComplexFloat tmp, t = { -exp[k].re, exp[k].im };
+
+        if (k2 < n4) {
+            tmp.re = -src[n3 + k2] - src[n3 - 1 - k2];
+            tmp.im = -src[n4 + k2] + src[n4 - 1 - k2];
+        } else {
+            tmp.re =  src[k2 - n4] - src[n3 - 1 - k2];
+            tmp.im = -src[n4 + k2] - src[n + n4 - 1 - k2];
+        }
+        z[s->revtab_inv[k]] = cmul(tmp, t);
+    }
+
+    fft_calc(s, z);
+
+    /* post rotation */
+    for (k = 0; k < n4; k++) {
+        const AVComplexFloat t = { -exp[k].im, -exp[k].re };
+        const AVComplexFloat tmp = cmul(z[k], t);
+
+        dst[(2*k)          * stride] = tmp.im;
+        dst[(n2 - 1 - 2*k) * stride] = tmp.re;
+    }
+}
+
+static void imdct(AVTXContext *s, void *_dst, void *_src, ptrdiff_t stride)
+{
+    const float *src = _src;
+    float *dst = _dst;
+    const AVComplexFloat *exp = s->exptab;
+    AVComplexFloat *z = s->tmp;
+    const int n4 = s->n, n2 = 2*n4;
+    int k;
+
+    stride /= sizeof(*src);
+
+    /* pre rotation */
+    for (k = 0; k < n4; k++) {
+        const AVComplexFloat tmp = { src[(n2 - 1 - 2*k) * stride], src[(2*k) * stride] };
+        z[s->revtab_inv[k]] = cmul(tmp, exp[k]);
+    }
+
+    fft_calc(s, z);
+
+    /* post rotation */
+    for (k = 0; k < n4; k++) {
+        const AVComplexFloat tmp = { z[k].im, z[k].re };
+        const AVComplexFloat t = { exp[k].im, exp[k].re };
+        const AVComplexFloat r = cmul(tmp, t);
+
+        dst[2*k]          = r.re;
+        dst[n2 - 1 - 2*k] = r.im;
+    }
+}
+
+static void gen_revtab(int *revtab, const int *radix, int nb_radix, int n,
+                       int in_off, int in_stride, int out_off)
+{
+    int k, m;
+
+    if (!nb_radix) {
+        revtab[out_off] = in_off;
+        return;
+    }
+    /* the last pass combines the DFTs of the inputs decimated by its radix */
+    m = n / radix[nb_radix - 1];
+    for (k = 0; k < radix[nb_radix - 1]; k++)
+        gen_revtab(revtab, radix, nb_radix - 1, m, in_off + k*in_stride,
+                   in_stride * radix[nb_radix - 1], out_off + k*m);
+}
+
+static int fft_init(AVTXContext *s, int n, int inv)
+{
+    static const fft_pass_fn passes[] = {
+        NULL, NULL, fft_pass2, fft_pass3, fft_pass4, fft_pass5,
+    };
+    int i, j, k, m, left = n, nb_tw = 0;
+
+    s->n   = n;
+    s->inv = inv;
+
+    /* Radix-5 and radix-3 passes first, then radix-4 with at most one
+     * radix-2 before them. */
+    while (left % 5 == 0)  { s->radix[s->nb_passes++] = 5; left /= 5; }
+    while (left % 3 == 0)  { s->radix[s->nb_passes++] = 3; left /= 3; }
+    if (av_log2(left) & 1) { s->radix[s->nb_passes++] = 2; left /= 2; }
+    while (left % 4 == 0)  { s->radix[s->nb_passes++] = 4; left /= 4; }
+    if (left != 1)
+        return AVERROR(EINVAL);
+
+    s->revtab     = av_malloc_array(n, sizeof(*s->revtab));
+    s->revtab_inv = av_malloc_array(n, sizeof(*s->revtab_inv));
+    s->tmp        = av_malloc_array(n, sizeof(*s->tmp));
+    for (i = 0, m = 1; i < s->nb_passes; m *= s->radix[i++])
+        nb_tw += m * (s->radix[i] - 1);
+    s->twiddles   = av_malloc_array(FFMAX(nb_tw, 1), sizeof(*s->twiddles));
+    if (!s->revtab || !s->revtab_inv || !s->tmp || !s->twiddles)
+        return AVERROR(ENOMEM);
+
+    gen_revtab(s->revtab, s->radix, s->nb_passes, n, 0, 1, 0);
+    for (i = 0; i < n; i++)
+        s->revtab_inv[s->revtab[i]] = i;
+
+    nb_tw = 0;
+    for (i = 0, m = 1; i < s->nb_passes; m *= s->radix[i++]) {
+        const int p = s->radix[i];
+
+        s->pass[i] = passes[p];
+        s->tw[i]   = s->twiddles + nb_tw;
+        for (j = 0; j < m; j++) {
+            for (k = 1; k < p; k++) {
+                const double alpha = 2 * M_PI * j * k / (m * p);
+                s->twiddles[nb_tw].re = cos(alpha);
+                s->twiddles[nb_tw].im = inv ? sin(alpha) : -sin(alpha);
+                nb_tw++;
+            }
+        }
+    }
+    return 0;
+}
+
+static int rdft_init(AVTXContext *s, int len, int inv)
+{
+    const int n = len / 2;
+    int i, ret;
+
+    if (len & 1 || len < 2)
+        return AVERROR(EINVAL);
+    if ((ret = fft_init(s, n, inv)) < 0)
+        return ret;
+
+    s->exptab = av_malloc_array(n, sizeof(*s->exptab));
+    if (!s->exptab)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < n; i++) {
+        const double alpha = 2 * M_PI * i / len;
+        s->exptab[i].re = cos(alpha);
+        s->exptab[i].im = inv ? sin(alpha) : -sin(alpha);
+    }
+    return 0;
+}
+
+static int mdct_init(AVTXContext *s, int len, int inv, float scale)
+{
+    const int n4 = len / 2, n = 2*len;
+    const double theta = 1.0 / 8.0 + (scale < 0 ? n4 : 0);
+    const double sc = sqrt(fabs(scale));
+    int i, ret;
+
+    if (len & 1 || len < 2)
+        return AVERROR(EINVAL);
+    if ((ret = fft_init(s, n4, inv)) < 0)
+        return ret;
+
+    s->exptab = av_malloc_array(n4, sizeof(*s->exptab));
+    if (!s->exptab)
+        return AVERROR(ENOMEM);
+    for (i = 0; i < n4; i++) {
+        const double alpha = 2 * M_PI * (i + theta) / n;
+        s->exptab[i].re = -cos(alpha) * sc;
+        s->exptab[i].im = -sin(alpha) * sc;
+    }
+    return 0;
+}
+
+av_cold void av_tx_uninit(AVTXContext **ctx)
+{
+    AVTXContext *s;
+
+    if (!ctx || !*ctx)
+        return;
+    s = *ctx;
+    av_free(s->revtab);
+    av_free(s->revtab_inv);
+    av_free(s->twiddles);
+    av_free(s->exptab);
+    av_free(s->tmp);
+    av_freep(ctx);
+}
+
+av_cold int av_tx_init(AVTXContext **ctx, av_tx_fn *tx, enum AVTXType type,
+                       int inv, int len, const void *scale, uint64_t flags)
+{
+    AVTXContext *s;
+    int ret;
+
+    *ctx = NULL;
+    if (len < 1)
+        return AVERROR(EINVAL);
+
+    s = av_mallocz(sizeof(*s));
+    if (!s)
+        return AVERROR(ENOMEM);
+
+    switch (type) {
+    case AV_TX_FLOAT_FFT:
+        ret = fft_init(s, len, inv);
+        *tx = fft;
+        break;
+    case AV_TX_FLOAT_MDCT:
+        ret = mdct_init(s, len, inv, scale ? *(const float *)scale : 1.0f);
+        *tx = inv ? imdct : mdct;
+        break;
+    case AV_TX_FLOAT_RDFT:
+        ret = rdft_init(s, len, inv);
+        *tx = inv ? irdft : rdft;
+        break;
+    default:
+        ret = AVERROR(EINVAL);
+        break;
+    }
+
+    if (ret < 0) {
+        av_tx_uninit(&s);
+        return ret;
+    }
+    *ctx = s;
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_TX_H
+#define AVUTIL_TX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @file
+ * @ingroup lavu_tx
+ * Mixed-radix discrete transforms.
+ */
+
+/**
+ * @defgroup lavu_tx Transforms
+ * @ingroup lavu_math
+ *
+ * FFT, RDFT and MDCT of any length that is a product of powers of 2, 3 and 5.
+ * @{
+ */
+
+typedef struct AVTXContext AVTXContext;
+
+typedef struct AVComplexFloat {
+    float re, im;
+} AVComplexFloat;
+
+enum AVTXType {
+    /**
+     * Standard complex to complex FFT with sample data type AVComplexFloat.
+     * The transform is not normalized, an FFT followed by an inverse FFT
+     * multiplies the data by the length.
+     * Scaling is currently unsupported, the stride is ignored.
+     */
+    AV_TX_FLOAT_FFT = 0,
+    /**
+     * Standard MDCT with sample data type of float and a scale type of
+     * float. Length is the frame size, not the window size (which is 2x
+     * frame) and must be even.
+     * The forward transform reads 2*len samples and writes len
+     * coefficients. The inverse transform reads len coefficients and
+     * writes the len samples of the middle half of the window, the other
+     * half can be derived from them by symmetry.
+     */
+    AV_TX_FLOAT_MDCT = 1,
+    /**
+     * Real to complex FFT with sample data type float. Length is the number
+     * of real samples and must be even.
+     * The forward transform reads len floats and writes len/2+1
+     * AVComplexFloat, the inverse transform does the opposite. Like the FFT,
+     * it is not normalized, scaling is currently unsupported and the stride
+     * is ignored.
+     */
+    AV_TX_FLOAT_RDFT = 2,
+};
+
+/**
+ * Function pointer to a function to perform the transform.
+ *
+ * @note Using a different context than the one allocated during av_tx_init()
+ * is not allowed.
+ *
+ * @param s the transform context
+ * @param out the output array
+ * @param in the input array
+ * @param stride the input or output stride in bytes (depending on whether
+ *        the transform is inverse or forward), only used by the MDCT where it
+ *        is the distance between two coefficients
+ *
+ * The input and output arrays may be the same for the FFT, they must not
+ * overlap for the other transforms.
+ */
+typedef void (*av_tx_fn)(AVTXContext *s, void *out, void *in, ptrdiff_t stride);
+
+/**
+ * Initialize a transform context with the given configuration.
+ *
+ * @param ctx the context to allocate, will be NULL on error
+ * @param tx pointer to the transform function pointer to set
+ * @param type type the type of transform
+ * @param inv whether to do an inverse or a forward transform
+ * @param len the size of the transform in samples, it must be a product
+ *        of powers of 2, 3 and 5 (of the half length for the MDCT and RDFT)
+ * @param scale pointer to the value to scale the output if supported by type
+ * @param flags currently unused
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int av_tx_init(AVTXContext **ctx, av_tx_fn *tx, enum AVTXType type,
+               int inv, int len, const void *scale, uint64_t flags);
+
+/**
+ * Frees a context and sets ctx to NULL, does nothing when ctx == NULL
+ */
+void av_tx_uninit(AVTXContext **ctx);
+
+/**
+ * @}
+ */
+
+#endif /* AVUTIL_TX_H */
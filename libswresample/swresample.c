@@ -281,7 +281,6 @@ av_cold int swr_init(struct SwrContext *s){
         goto fail;
     }
 
-#define RSC 1 //FIXME finetune
     if(!s-> in.ch_count)
         s-> in.ch_count= av_get_channel_layout_nb_channels(s-> in_ch_layout);
     if(!s->used_ch_count)
@@ -318,7 +317,13 @@ av_cold int swr_init(struct SwrContext *s){
 
 av_assert0(s->used_ch_count);
 av_assert0(s->out.ch_count);
-    s->resample_first= RSC*s->out.ch_count/s->used_ch_count - RSC < s->out_sample_rate/(float)s-> in_sample_rate - 1.0;
+    /* Resampling costs a whole filter per output sample and channel while
+     * rematrixing costs one multiply per channel pair, so resample on the side
+     * with fewer channels. With equal channel counts rematrix at the lower rate. */
+    if (s->used_ch_count != s->out.ch_count)
+        s->resample_first = s->used_ch_count < s->out.ch_count;
+    else
+        s->resample_first = s->out_sample_rate < s->in_sample_rate;
 
     s->in_buffer= s->in;
     s->silence  = s->in;
@@ -169,6 +169,9 @@ static const struct {
 #if CONFIG_SWSCALE
     { "sw_rgb", checkasm_check_sw_rgb },
 #endif
+#if CONFIG_SWRESAMPLE
+    { "swr_resample", checkasm_check_swr_resample },
+#endif
 #if CONFIG_AVUTIL
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
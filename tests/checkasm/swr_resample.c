@@ -0,0 +1,170 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "libswresample/resample.h"
+
+#include "checkasm.h"
+
+#define SRC_SIZE 4096
+#define DST_SIZE 1024
+
+static const struct {
+    int in_rate, out_rate;
+} rates[] = {
+    { 44100, 48000 }, { 48000, 44100 }, { 22050, 48000 }, { 48000, 32000 },
+};
+
+static const int filter_sizes[] = { 8, 16, 32, 64 };
+
+static void randomize_src(enum AVSampleFormat fmt, uint8_t *src, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        switch (fmt) {
+        case AV_SAMPLE_FMT_S16P: AV_WN16A(src + 2 * i, rnd());                         break;
+        case AV_SAMPLE_FMT_S32P: AV_WN32A(src + 4 * i, rnd());                         break;
+        case AV_SAMPLE_FMT_FLTP: ((float  *)src)[i] = (int32_t)rnd() / (float) INT32_MAX; break;
+        case AV_SAMPLE_FMT_DBLP: ((double *)src)[i] = (int32_t)rnd() / (double)INT32_MAX; break;
+        }
+    }
+}
+
+static int compare_dst(enum AVSampleFormat fmt, const uint8_t *dst0, const uint8_t *dst1,
+                       int len, int linear)
+{
+    int i;
+
+    switch (fmt) {
+    case AV_SAMPLE_FMT_S16P:
+        /* the interpolation may be rounded differently by the simd versions */
+        for (i = 0; i < len; i++)
+            if (FFABS(((const int16_t *)dst0)[i] - ((const int16_t *)dst1)[i]) > linear)
+                return 0;
+        return 1;
+    case AV_SAMPLE_FMT_S32P:
+        for (i = 0; i < len; i++)
+            if (FFABS((int64_t)((const int32_t *)dst0)[i] - ((const int32_t *)dst1)[i]) > linear)
+                return 0;
+        return 1;
+    case AV_SAMPLE_FMT_FLTP:
+        return float_near_abs_eps_array((const float *)dst0, (const float *)dst1, 1e-5, len);
+    case AV_SAMPLE_FMT_DBLP:
+        return double_near_abs_eps_array((const double *)dst0, (const double *)dst1, 1e-12, len);
+    }
+    return 0;
+}
+
+static ResampleContext *init_resample(enum AVSampleFormat fmt, int in_rate, int out_rate,
+                                      int filter_size, int linear)
+{
+    return swri_resampler.init(NULL, out_rate, in_rate, filter_size, 10, linear, 0.97,
+                               fmt, SWR_FILTER_TYPE_KAISER, 9, 20, 0, 0);
+}
+
+static void check_resample(enum AVSampleFormat fmt, const char *name, int linear)
+{
+    LOCAL_ALIGNED_32(uint8_t, src,  [SRC_SIZE * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst0, [DST_SIZE * 8]);
+    LOCAL_ALIGNED_32(uint8_t, dst1, [DST_SIZE * 8]);
+    int bps = av_get_bytes_per_sample(fmt);
+    ResampleContext *c, *t, c0, c1;
+    int r, f, ret0, ret1;
+
+    declare_func_emms(AV_CPU_FLAG_MMX, int, ResampleContext *c, void *dst,
+                      const void *src, int n, int update_ctx);
+
+    /* the functions only depend on the format, benchmark a common case */
+    c = init_resample(fmt, 44100, 48000, 32, linear);
+    if (!c) {
+        fail();
+        return;
+    }
+
+    if (check_func(linear ? c->dsp.resample_linear : c->dsp.resample_common,
+                   "resample_%s_%s", linear ? "linear" : "common", name)) {
+        randomize_src(fmt, src, SRC_SIZE);
+
+        for (r = 0; r < FF_ARRAY_ELEMS(rates); r++) {
+            for (f = 0; f < FF_ARRAY_ELEMS(filter_sizes); f++) {
+                t = init_resample(fmt, rates[r].in_rate, rates[r].out_rate,
+                                  filter_sizes[f], linear);
+                if (!t) {
+                    fail();
+                    continue;
+                }
+                /* the last phase of the linear filter bank is the first one
+                 * shifted by one tap; the simd versions read whole vectors
+                 * past filter_length and would pick up that tap, which the
+                 * c version leaves out */
+                if (linear)
+                    memset((uint8_t *)t->filter_bank +
+                           (t->filter_alloc * t->phase_count + t->filter_length) * bps,
+                           0, (t->filter_alloc - t->filter_length) * bps);
+                memset(dst0, 0, DST_SIZE * bps);
+                memset(dst1, 0, DST_SIZE * bps);
+
+                t->index = rnd() % t->phase_count;
+                t->frac  = rnd() % t->src_incr;
+                c0 = c1 = *t;
+
+                ret0 = call_ref(&c0, dst0, src, DST_SIZE, 1);
+                ret1 = call_new(&c1, dst1, src, DST_SIZE, 1);
+                if (ret0 != ret1 || c0.index != c1.index || c0.frac != c1.frac ||
+                    !compare_dst(fmt, dst0, dst1, DST_SIZE, linear))
+                    fail();
+
+                swri_resampler.free(&t);
+            }
+        }
+
+        c->index = 0;
+        c->frac  = c->src_incr / 3;
+        bench_new(c, dst1, src, DST_SIZE, 0);
+    }
+
+    swri_resampler.free(&c);
+}
+
+void checkasm_check_swr_resample(void)
+{
+    static const struct {
+        enum AVSampleFormat fmt;
+        const char *name;
+    } fmts[] = {
+        { AV_SAMPLE_FMT_S16P, "int16"  },
+        { AV_SAMPLE_FMT_S32P, "int32"  },
+        { AV_SAMPLE_FMT_FLTP, "float"  },
+        { AV_SAMPLE_FMT_DBLP, "double" },
+    };
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(fmts); i++)
+        check_resample(fmts[i].fmt, fmts[i].name, 0);
+    report("resample_common");
+
+    for (i = 0; i < FF_ARRAY_ELEMS(fmts); i++)
+        check_resample(fmts[i].fmt, fmts[i].name, 1);
+    report("resample_linear");
+}
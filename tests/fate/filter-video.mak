@@ -793,6 +793,12 @@ fate-filter-refcmp-ssim-rgb: CMD = refcmp_metadata ssim rgb24 0.015
 FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) SSIM_FILTER) += fate-filter-refcmp-ssim-yuv
 fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) VMAFFEATURES_FILTER) += fate-filter-refcmp-vmaffeatures-yuv
+fate-filter-refcmp-vmaffeatures-yuv: CMD = refcmp_metadata vmaffeatures yuv420p 0.001
+
+FATE_FILTER_SAMPLES-$(call ALLYES, $(REFCMP_DEPS) VMAFFEATURES_FILTER) += fate-filter-refcmp-vmaffeatures-yuv10
+fate-filter-refcmp-vmaffeatures-yuv10: CMD = refcmp_metadata vmaffeatures yuv422p10 0.001
+
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
@@ -0,0 +1,189 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the resampling throughput of libswresample for the planar sample
+ * formats across a set of sample rate pairs and filter sizes:
+ * make tools/swr_bench && tools/swr_bench -l
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "libavutil/channel_layout.h"
+#include "libavutil/lfg.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
+#include "libswresample/swresample.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h> /* for getopt */
+#endif
+#if !HAVE_GETOPT
+#include "compat/getopt.c"
+#endif
+
+#define CHUNK_SIZE 1024
+
+static const enum AVSampleFormat formats[] = {
+    AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP,
+};
+
+static const struct {
+    int in_rate, out_rate;
+} rates[] = {
+    { 44100, 48000 }, { 48000, 44100 }, { 48000, 96000 }, { 96000, 48000 },
+    { 22050, 48000 }, { 48000,  8000 },
+};
+
+static const int filter_sizes[] = { 16, 32, 64 };
+
+static void fill_input(uint8_t **data, enum AVSampleFormat fmt, int channels, int nb_samples)
+{
+    AVLFG lfg;
+    int ch, i;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    for (ch = 0; ch < channels; ch++) {
+        for (i = 0; i < nb_samples; i++) {
+            double v = 0.5 * sin(2 * M_PI * 1000.0 * i / 44100.0) +
+                       0.25 * ((double)av_lfg_get(&lfg) / UINT32_MAX - 0.5);
+            switch (fmt) {
+            case AV_SAMPLE_FMT_S16P: ((int16_t *)data[ch])[i] = lrint(v * INT16_MAX); break;
+            case AV_SAMPLE_FMT_S32P: ((int32_t *)data[ch])[i] = lrint(v * INT32_MAX); break;
+            case AV_SAMPLE_FMT_FLTP: ((float   *)data[ch])[i] = v;                    break;
+            case AV_SAMPLE_FMT_DBLP: ((double  *)data[ch])[i] = v;                    break;
+            }
+        }
+    }
+}
+
+/* returns the number of input samples per channel resampled per second */
+static double run(enum AVSampleFormat fmt, int in_rate, int out_rate, int filter_size,
+                  int linear, int channels, double duration)
+{
+    int64_t layout = av_get_default_channel_layout(channels);
+    int nb_chunks = FFMAX(lrint(duration * in_rate / CHUNK_SIZE), 1);
+    int max_out = av_rescale_rnd(CHUNK_SIZE, out_rate, in_rate, AV_ROUND_UP) + 256;
+    uint8_t **in = NULL, **out = NULL;
+    SwrContext *swr = swr_alloc();
+    int64_t start, elapsed;
+    double ret = -1;
+    int i;
+
+    if (!swr)
+        return -1;
+
+    av_opt_set_int(swr, "in_channel_layout",   layout,      0);
+    av_opt_set_int(swr, "out_channel_layout",  layout,      0);
+    av_opt_set_int(swr, "in_sample_rate",      in_rate,     0);
+    av_opt_set_int(swr, "out_sample_rate",     out_rate,    0);
+    av_opt_set_int(swr, "filter_size",         filter_size, 0);
+    av_opt_set_int(swr, "linear_interp",       linear,      0);
+    av_opt_set_sample_fmt(swr, "in_sample_fmt",       fmt, 0);
+    av_opt_set_sample_fmt(swr, "out_sample_fmt",      fmt, 0);
+    av_opt_set_sample_fmt(swr, "internal_sample_fmt", fmt, 0);
+    if (swr_init(swr) < 0)
+        goto end;
+
+    if (av_samples_alloc_array_and_samples(&in,  NULL, channels, CHUNK_SIZE, fmt, 0) < 0 ||
+        av_samples_alloc_array_and_samples(&out, NULL, channels, max_out,    fmt, 0) < 0)
+        goto end;
+    fill_input(in, fmt, channels, CHUNK_SIZE);
+
+    start = av_gettime_relative();
+    for (i = 0; i < nb_chunks; i++)
+        if (swr_convert(swr, out, max_out, (const uint8_t **)in, CHUNK_SIZE) < 0)
+            goto end;
+    elapsed = av_gettime_relative() - start;
+    ret = (double)nb_chunks * CHUNK_SIZE / FFMAX(elapsed, 1) * 1000000;
+
+end:
+    if (in)
+        av_freep(&in[0]);
+    av_freep(&in);
+    if (out)
+        av_freep(&out[0]);
+    av_freep(&out);
+    swr_free(&swr);
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    printf("Usage: %s [-c channels] [-d seconds] [-l]\n"
+           "  -c  number of channels (default 2)\n"
+           "  -d  duration of input audio per configuration in seconds (default 10)\n"
+           "  -l  also measure linear interpolation of the filter coefficients\n",
+           name);
+}
+
+int main(int argc, char **argv)
+{
+    int channels = 2, linear_max = 0;
+    double duration = 10;
+    int f, r, s, linear, opt;
+
+    while ((opt = getopt(argc, argv, "c:d:lh")) != -1) {
+        switch (opt) {
+        case 'c':
+            channels = atoi(optarg);
+            break;
+        case 'd':
+            duration = atof(optarg);
+            break;
+        case 'l':
+            linear_max = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt != 'h';
+        }
+    }
+    if (channels < 1 || channels > 8 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-5s %6s %6s %6s %6s %14s %10s\n",
+           "fmt", "in", "out", "filter", "linear", "samples/s", "realtime");
+    for (f = 0; f < FF_ARRAY_ELEMS(formats); f++) {
+        for (r = 0; r < FF_ARRAY_ELEMS(rates); r++) {
+            for (s = 0; s < FF_ARRAY_ELEMS(filter_sizes); s++) {
+                for (linear = 0; linear <= linear_max; linear++) {
+                    double speed = run(formats[f], rates[r].in_rate, rates[r].out_rate,
+                                       filter_sizes[s], linear, channels, duration);
+                    if (speed < 0) {
+                        fprintf(stderr, "resampling failed\n");
+                        return 1;
+                    }
+                    printf("%-5s %6d %6d %6d %6d %14.0f %9.1fx\n",
+                           av_get_sample_fmt_name(formats[f]), rates[r].in_rate,
+                           rates[r].out_rate, filter_sizes[s], linear, speed,
+                           speed / rates[r].in_rate);
+                }
+            }
+        }
+    }
+
+    return 0;
+}